@@ -0,0 +1,502 @@
+// BenchmarkMain.cpp
+
+#include "BenchmarkRig.h"
+#include "SolveRecorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <algorithm>
+
+// Every heap allocation in the process goes through these, so the number
+// of allocations made while solving can be reported per move.
+static std::atomic< long long > allocationCount( 0 );
+static std::atomic< long long > allocationBytes( 0 );
+
+static void* CountedAllocate( size_t size )
+{
+	allocationCount++;
+	allocationBytes += ( long long )size;
+
+	void* memory = malloc( size > 0 ? size : 1 );
+	if( !memory )
+		throw std::bad_alloc();
+
+	return memory;
+}
+
+void* operator new( size_t size ) { return CountedAllocate( size ); }
+void* operator new[]( size_t size ) { return CountedAllocate( size ); }
+void operator delete( void* memory ) noexcept { free( memory ); }
+void operator delete[]( void* memory ) noexcept { free( memory ); }
+void operator delete( void* memory, size_t ) noexcept { free( memory ); }
+void operator delete[]( void* memory, size_t ) noexcept { free( memory ); }
+
+struct BenchmarkOptions
+{
+	std::vector< BenchmarkRig::RigType > rigTypeArray;
+	std::vector< KinematicGraph::SolverType > solverTypeArray;
+	std::vector< KinematicGraph::AccelerationType > accelerationTypeArray;
+	int size;
+	int stationaryCount;
+	int moveCount;
+	int warmupCount;
+	unsigned int seed;
+	int threadCount;
+	bool treeReaching;
+	double dragRadius;
+	std::string jsonPath;
+	std::string label;
+	std::string recordPath;
+	std::string replayPath;
+	int repeatCount;
+};
+
+struct BenchmarkResult
+{
+	const char* rigName;
+	const char* solverName;
+	const char* solvedByName;		// The solver that ran: the one chosen, "tree" for reaching, or "mixed".
+	const char* accelerationName;
+	int vertexCount;
+	int edgeCount;
+	double buildMilliseconds;
+	double latencyMean;				// Latencies are in microseconds.
+	double latencyP50;
+	double latencyP90;
+	double latencyP99;
+	double latencyMax;
+	double iterationsMean;
+	int iterationsMax;
+	double vertexMovesMean;
+	double residualMean;
+	double residualMax;
+	double convergenceRateMean;
+	double relaxationMean;
+	double restartsMean;
+	int statusCount[3];				// Indexed by KinematicGraph::SolveStatus.
+	int reachedCount;				// Timed moves solved by reaching a tree.
+	double allocationsPerMove;
+	double bytesPerMove;
+};
+
+static const char* solverNameArray[] = { "propagate", "gauss_seidel", "jacobi", "gauss_newton", "parallel", "worklist" };
+static const int solverCount = sizeof( solverNameArray ) / sizeof( solverNameArray[0] );
+
+static const char* accelerationNameArray[] = { "none", "sor", "chebyshev", "anderson" };
+static const int accelerationCount = sizeof( accelerationNameArray ) / sizeof( accelerationNameArray[0] );
+
+// The solvers that sweep, and so can be accelerated.
+static bool IsAccelerated( KinematicGraph::SolverType solverType )
+{
+	return solverType == KinematicGraph::SOLVER_GAUSS_SEIDEL || solverType == KinematicGraph::SOLVER_JACOBI || solverType == KinematicGraph::SOLVER_PARALLEL;
+}
+
+static void PrintUsage( void )
+{
+	printf( "usage: KinematicGraphBenchmark [options]\n" );
+	printf( "  --rig <name|all>        chain, grid, truss, random_geometric, linkage (default all)\n" );
+	printf( "  --solver <name|all>     propagate, gauss_seidel, jacobi, gauss_newton, parallel, worklist (default all)\n" );
+	printf( "  --accel <name|all>      none, sor, chebyshev, anderson, for the sweeping solvers (default none)\n" );
+	printf( "  --size <n>              approximate vertex count of each rig (default 1000)\n" );
+	printf( "  --stationary <n>        number of stationary vertices (default 2)\n" );
+	printf( "  --moves <n>             timed drag moves per run (default 200)\n" );
+	printf( "  --warmup <n>            untimed drag moves before timing (default 10)\n" );
+	printf( "  --radius <r>            radius of the drag circle (default 2)\n" );
+	printf( "  --seed <n>              seed for the random rigs (default 1)\n" );
+	printf( "  --threads <n>           threads for the parallel solver, 0 for one per core (default 0)\n" );
+	printf( "  --trees <on|off>        solve trees by reaching, whatever the solver (default on)\n" );
+	printf( "  --json <path>           also write the results as JSON\n" );
+	printf( "  --label <text>          label stored in the JSON, e.g. a commit id\n" );
+	printf( "  --record <path>         record the run, which must be of one rig and solver (timings include the recording)\n" );
+	printf( "  --replay <path>         instead of running rigs, replay a recording, check it and time it\n" );
+	printf( "  --repeat <n>            timed replays of the recording (default 10)\n" );
+}
+
+static bool ParseOptions( int argc, char** argv, BenchmarkOptions& options )
+{
+	std::string rigName = "all";
+	std::string solverName = "all";
+	std::string accelerationName = "none";
+	std::string treeReachingName = "on";
+
+	options.size = 1000;
+	options.stationaryCount = 2;
+	options.moveCount = 200;
+	options.warmupCount = 10;
+	options.seed = 1;
+	options.threadCount = 0;
+	options.dragRadius = 2.0;
+	options.repeatCount = 10;
+
+	for( int i = 1; i < argc; i++ )
+	{
+		std::string option = argv[i];
+		if( option == "--help" || option == "-h" )
+			return false;
+
+		if( i + 1 >= argc )
+		{
+			fprintf( stderr, "missing value for %s\n", option.c_str() );
+			return false;
+		}
+
+		const char* value = argv[ ++i ];
+		if( option == "--rig" )
+			rigName = value;
+		else if( option == "--solver" )
+			solverName = value;
+		else if( option == "--accel" )
+			accelerationName = value;
+		else if( option == "--size" )
+			options.size = atoi( value );
+		else if( option == "--stationary" )
+			options.stationaryCount = atoi( value );
+		else if( option == "--moves" )
+			options.moveCount = atoi( value );
+		else if( option == "--warmup" )
+			options.warmupCount = atoi( value );
+		else if( option == "--radius" )
+			options.dragRadius = atof( value );
+		else if( option == "--seed" )
+			options.seed = ( unsigned int )strtoul( value, nullptr, 10 );
+		else if( option == "--threads" )
+			options.threadCount = atoi( value );
+		else if( option == "--trees" )
+			treeReachingName = value;
+		else if( option == "--json" )
+			options.jsonPath = value;
+		else if( option == "--label" )
+			options.label = value;
+		else if( option == "--record" )
+			options.recordPath = value;
+		else if( option == "--replay" )
+			options.replayPath = value;
+		else if( option == "--repeat" )
+			options.repeatCount = atoi( value );
+		else
+		{
+			fprintf( stderr, "unknown option %s\n", option.c_str() );
+			return false;
+		}
+	}
+
+	if( options.moveCount < 1 )
+		options.moveCount = 1;
+
+	for( int i = 0; i < BenchmarkRig::RIG_COUNT; i++ )
+		if( rigName == "all" || rigName == BenchmarkRig::GetRigTypeName( BenchmarkRig::RigType(i) ) )
+			options.rigTypeArray.push_back( BenchmarkRig::RigType(i) );
+
+	for( int i = 0; i < solverCount; i++ )
+		if( solverName == "all" || solverName == solverNameArray[i] )
+			options.solverTypeArray.push_back( KinematicGraph::SolverType(i) );
+
+	for( int i = 0; i < accelerationCount; i++ )
+		if( accelerationName == "all" || accelerationName == accelerationNameArray[i] )
+			options.accelerationTypeArray.push_back( KinematicGraph::AccelerationType(i) );
+
+	if( options.rigTypeArray.size() == 0 )
+	{
+		fprintf( stderr, "unknown rig %s\n", rigName.c_str() );
+		return false;
+	}
+
+	if( options.solverTypeArray.size() == 0 )
+	{
+		fprintf( stderr, "unknown solver %s\n", solverName.c_str() );
+		return false;
+	}
+
+	if( options.accelerationTypeArray.size() == 0 )
+	{
+		fprintf( stderr, "unknown acceleration %s\n", accelerationName.c_str() );
+		return false;
+	}
+
+	if( treeReachingName != "on" && treeReachingName != "off" )
+	{
+		fprintf( stderr, "--trees must be on or off\n" );
+		return false;
+	}
+
+	options.treeReaching = ( treeReachingName == "on" );
+
+	if( options.recordPath.size() > 0 && options.rigTypeArray.size() * options.solverTypeArray.size() * options.accelerationTypeArray.size() != 1 )
+	{
+		fprintf( stderr, "--record needs a single rig, solver and acceleration\n" );
+		return false;
+	}
+
+	if( options.repeatCount < 1 )
+		options.repeatCount = 1;
+
+	return true;
+}
+
+// Nearest-rank percentile of sorted samples.
+static double CalcPercentile( const std::vector< double >& sortedArray, double percent )
+{
+	int rank = int( ceil( percent / 100.0 * double( sortedArray.size() ) ) );
+	rank = std::max( 1, std::min( rank, ( int )sortedArray.size() ) );
+	return sortedArray[ rank - 1 ];
+}
+
+static BenchmarkResult RunBenchmark( const BenchmarkOptions& options, BenchmarkRig::RigType rigType, KinematicGraph::SolverType solverType, KinematicGraph::AccelerationType accelerationType )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	BenchmarkResult result;
+	memset( &result, 0, sizeof( result ) );
+	result.rigName = BenchmarkRig::GetRigTypeName( rigType );
+	result.solverName = solverNameArray[ solverType ];
+	result.accelerationName = accelerationNameArray[ accelerationType ];
+
+	BenchmarkRig::Settings rigSettings;
+	rigSettings.rigType = rigType;
+	rigSettings.size = options.size;
+	rigSettings.stationaryCount = options.stationaryCount;
+	rigSettings.seed = options.seed;
+	rigSettings.dragRadius = options.dragRadius;
+
+	KinematicGraph kinematicGraph;
+	KinematicGraph::SolverSettings solverSettings = kinematicGraph.GetSolverSettings();
+	solverSettings.solverType = solverType;
+	solverSettings.threadCount = options.threadCount;
+	solverSettings.accelerationType = accelerationType;
+	solverSettings.treeReaching = options.treeReaching;
+	kinematicGraph.SetSolverSettings( solverSettings );
+
+	BenchmarkRig rig( rigSettings );
+	Clock::time_point buildStart = Clock::now();
+	rig.Build( kinematicGraph );
+	result.buildMilliseconds = std::chrono::duration< double, std::milli >( Clock::now() - buildStart ).count();
+	result.vertexCount = rig.GetVertexCount();
+	result.edgeCount = rig.GetEdgeCount();
+
+	// The recording starts from the built rig and has room for the whole run.
+	SolveRecorder recorder( SIZE_MAX );
+	if( options.recordPath.size() > 0 )
+		kinematicGraph.SetRecorder( &recorder );
+
+	// Warming up builds the lazily computed structures and grows the scratch
+	// buffers; the timed drag then starts wherever the warm-up left the rig.
+	for( int i = 0; i < options.warmupCount; i++ )
+		kinematicGraph.MoveVertex( rig.GetDragId(), rig.CalcDragDelta( i % options.moveCount, options.moveCount ) );
+
+	std::vector< double > latencyArray;
+	latencyArray.reserve( options.moveCount );
+
+	long long startAllocationCount = allocationCount;
+	long long startAllocationBytes = allocationBytes;
+
+	for( int i = 0; i < options.moveCount; i++ )
+	{
+		c3ga::vectorE3GA delta = rig.CalcDragDelta( i, options.moveCount );
+
+		Clock::time_point moveStart = Clock::now();
+		KinematicGraph::SolveResult solveResult = kinematicGraph.MoveVertex( rig.GetDragId(), delta );
+		double latency = std::chrono::duration< double, std::micro >( Clock::now() - moveStart ).count();
+
+		latencyArray.push_back( latency );
+		result.latencyMean += latency;
+		result.iterationsMean += solveResult.iterations;
+		result.iterationsMax = std::max( result.iterationsMax, solveResult.iterations );
+		result.vertexMovesMean += solveResult.moveCount;
+		result.residualMean += solveResult.residual;
+		result.residualMax = std::max( result.residualMax, double( solveResult.residual ) );
+		result.convergenceRateMean += solveResult.convergenceRate;
+		result.relaxationMean += solveResult.relaxation;
+		result.restartsMean += solveResult.restartCount;
+		result.statusCount[ solveResult.status ]++;
+		if( solveResult.reachedTree )
+			result.reachedCount++;
+	}
+
+	// Reaching stands in for the chosen solver on trees, so the timings of
+	// a tree rig are reaching's, whichever solver the row names.
+	if( result.reachedCount == options.moveCount )
+		result.solvedByName = "tree";
+	else if( result.reachedCount > 0 )
+		result.solvedByName = "mixed";
+	else
+		result.solvedByName = result.solverName;
+
+	// The latency array was reserved up front, so nothing of the benchmark's
+	// own is allocated inside the loop.
+	result.allocationsPerMove = double( allocationCount - startAllocationCount ) / options.moveCount;
+	result.bytesPerMove = double( allocationBytes - startAllocationBytes ) / options.moveCount;
+
+	result.latencyMean /= options.moveCount;
+	result.iterationsMean /= options.moveCount;
+	result.vertexMovesMean /= options.moveCount;
+	result.residualMean /= options.moveCount;
+	result.convergenceRateMean /= options.moveCount;
+	result.relaxationMean /= options.moveCount;
+	result.restartsMean /= options.moveCount;
+
+	std::sort( latencyArray.begin(), latencyArray.end() );
+	result.latencyP50 = CalcPercentile( latencyArray, 50.0 );
+	result.latencyP90 = CalcPercentile( latencyArray, 90.0 );
+	result.latencyP99 = CalcPercentile( latencyArray, 99.0 );
+	result.latencyMax = latencyArray.back();
+
+	if( options.recordPath.size() > 0 )
+	{
+		kinematicGraph.SetRecorder( nullptr );
+		if( !recorder.Write( options.recordPath.c_str() ) )
+			fprintf( stderr, "failed to write %s\n", options.recordPath.c_str() );
+	}
+
+	return result;
+}
+
+// Replay a recording once to check that this build reproduces it exactly,
+// then as often as asked, timing each replay.
+static int RunReplay( const BenchmarkOptions& options )
+{
+	typedef std::chrono::steady_clock Clock;
+
+	SolveRecorder recorder;
+	if( !recorder.Read( options.replayPath.c_str() ) )
+	{
+		fprintf( stderr, "failed to read %s\n", options.replayPath.c_str() );
+		return 1;
+	}
+
+	KinematicGraph kinematicGraph;
+	int frameCount = 0;
+	if( !recorder.Replay( kinematicGraph, frameCount ) )
+	{
+		fprintf( stderr, "replay diverged after %d of %d frames\n", frameCount, recorder.GetFrameCount() );
+		return 1;
+	}
+
+	std::vector< double > timeArray;
+	for( int i = 0; i < options.repeatCount; i++ )
+	{
+		Clock::time_point replayStart = Clock::now();
+		recorder.Replay( kinematicGraph, frameCount );
+		timeArray.push_back( std::chrono::duration< double, std::milli >( Clock::now() - replayStart ).count() );
+	}
+
+	std::sort( timeArray.begin(), timeArray.end() );
+	printf( "%d segments, %d frames, %.1f MB: exact; replay p50 %.3f ms, max %.3f ms\n",
+		recorder.GetSegmentCount(), frameCount, double( recorder.GetByteCount() ) / ( 1 << 20 ),
+		CalcPercentile( timeArray, 50.0 ), timeArray.back() );
+
+	return 0;
+}
+
+static void PrintResult( const BenchmarkResult& result )
+{
+	printf( "%-17s %-13s %-13s %-10s %7d %7d %9.1f %9.1f %9.1f %9.1f %7.1f %6.3f %5.2f %10.3g %7.3g %9.1f  %d/%d/%d\n",
+		result.rigName, result.solverName, result.solvedByName, result.accelerationName, result.vertexCount, result.edgeCount,
+		result.latencyP50, result.latencyP90, result.latencyP99, result.latencyMax,
+		result.iterationsMean, result.convergenceRateMean, result.relaxationMean,
+		result.residualMax, result.allocationsPerMove, result.bytesPerMove,
+		result.statusCount[ KinematicGraph::SOLVE_CONVERGED ],
+		result.statusCount[ KinematicGraph::SOLVE_STALLED ],
+		result.statusCount[ KinematicGraph::SOLVE_DIVERGED ] );
+}
+
+static void WriteJsonString( FILE* file, const std::string& text )
+{
+	fputc( '"', file );
+	for( int i = 0; i < ( int )text.size(); i++ )
+	{
+		unsigned char c = ( unsigned char )text[i];
+		if( c == '"' || c == '\\' )
+			fprintf( file, "\\%c", c );
+		else if( c < 0x20 )
+			fprintf( file, "\\u%04x", c );
+		else
+			fputc( c, file );
+	}
+	fputc( '"', file );
+}
+
+static bool WriteJson( const BenchmarkOptions& options, const std::vector< BenchmarkResult >& resultArray )
+{
+	FILE* file = fopen( options.jsonPath.c_str(), "w" );
+	if( !file )
+		return false;
+
+	fprintf( file, "{\n\t\"format\": 3,\n\t\"label\": " );
+	WriteJsonString( file, options.label );
+	fprintf( file, ",\n\t\"settings\": { \"size\": %d, \"stationary\": %d, \"moves\": %d, \"warmup\": %d, \"radius\": %.17g, \"seed\": %u, \"threads\": %d, \"tree_reaching\": %s },\n",
+		options.size, options.stationaryCount, options.moveCount, options.warmupCount, options.dragRadius, options.seed, options.threadCount, options.treeReaching ? "true" : "false" );
+	fprintf( file, "\t\"results\": [\n" );
+
+	for( int i = 0; i < ( int )resultArray.size(); i++ )
+	{
+		const BenchmarkResult& result = resultArray[i];
+		fprintf( file, "\t\t{ \"rig\": \"%s\", \"solver\": \"%s\", \"solved_by\": \"%s\", \"tree_moves\": %d, \"acceleration\": \"%s\", \"vertices\": %d, \"edges\": %d, \"build_ms\": %.6g,\n",
+			result.rigName, result.solverName, result.solvedByName, result.reachedCount, result.accelerationName, result.vertexCount, result.edgeCount, result.buildMilliseconds );
+		fprintf( file, "\t\t  \"latency_us\": { \"mean\": %.6g, \"p50\": %.6g, \"p90\": %.6g, \"p99\": %.6g, \"max\": %.6g },\n",
+			result.latencyMean, result.latencyP50, result.latencyP90, result.latencyP99, result.latencyMax );
+		fprintf( file, "\t\t  \"iterations\": { \"mean\": %.6g, \"max\": %d }, \"vertex_moves_mean\": %.6g,\n",
+			result.iterationsMean, result.iterationsMax, result.vertexMovesMean );
+		fprintf( file, "\t\t  \"residual\": { \"mean\": %.6g, \"max\": %.6g },\n", result.residualMean, result.residualMax );
+		fprintf( file, "\t\t  \"convergence\": { \"rate_mean\": %.6g, \"relaxation_mean\": %.6g, \"restarts_mean\": %.6g },\n",
+			result.convergenceRateMean, result.relaxationMean, result.restartsMean );
+		fprintf( file, "\t\t  \"status\": { \"converged\": %d, \"stalled\": %d, \"diverged\": %d },\n",
+			result.statusCount[ KinematicGraph::SOLVE_CONVERGED ],
+			result.statusCount[ KinematicGraph::SOLVE_STALLED ],
+			result.statusCount[ KinematicGraph::SOLVE_DIVERGED ] );
+		fprintf( file, "\t\t  \"allocations_per_move\": %.6g, \"bytes_per_move\": %.6g }%s\n",
+			result.allocationsPerMove, result.bytesPerMove, ( i + 1 < ( int )resultArray.size() ) ? "," : "" );
+	}
+
+	fprintf( file, "\t]\n}\n" );
+	return fclose( file ) == 0;
+}
+
+int main( int argc, char** argv )
+{
+	BenchmarkOptions options;
+	if( !ParseOptions( argc, argv, options ) )
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if( options.replayPath.size() > 0 )
+		return RunReplay( options );
+
+	printf( "%-17s %-13s %-13s %-10s %7s %7s %9s %9s %9s %9s %7s %6s %5s %10s %7s %9s  %s\n",
+		"rig", "solver", "solved by", "accel", "verts", "edges", "p50 us", "p90 us", "p99 us", "max us", "iters", "rate", "omega", "residual", "alloc", "bytes", "conv/stall/div" );
+
+	std::vector< BenchmarkResult > resultArray;
+	for( int i = 0; i < ( int )options.rigTypeArray.size(); i++ )
+	{
+		for( int j = 0; j < ( int )options.solverTypeArray.size(); j++ )
+		{
+			// The other solvers are run once, without acceleration.
+			KinematicGraph::SolverType solverType = options.solverTypeArray[j];
+			int runCount = IsAccelerated( solverType ) ? ( int )options.accelerationTypeArray.size() : 1;
+			for( int k = 0; k < runCount; k++ )
+			{
+				KinematicGraph::AccelerationType accelerationType = IsAccelerated( solverType ) ? options.accelerationTypeArray[k] : KinematicGraph::ACCELERATION_NONE;
+				BenchmarkResult result = RunBenchmark( options, options.rigTypeArray[i], solverType, accelerationType );
+				PrintResult( result );
+				fflush( stdout );
+				resultArray.push_back( result );
+			}
+		}
+	}
+
+	if( options.jsonPath.size() > 0 && !WriteJson( options, resultArray ) )
+	{
+		fprintf( stderr, "failed to write %s\n", options.jsonPath.c_str() );
+		return 1;
+	}
+
+	return 0;
+}
+
+// BenchmarkMain.cpp
@@ -0,0 +1,270 @@
+// BenchmarkRig.cpp
+
+#include "BenchmarkRig.h"
+#include <math.h>
+#include <random>
+#include <algorithm>
+
+BenchmarkRig::BenchmarkRig( const Settings& settings )
+{
+	this->settings = settings;
+	edgeCount = 0;
+	dragVertex = -1;
+	dragId = 0;
+}
+
+BenchmarkRig::~BenchmarkRig( void )
+{
+}
+
+/*static*/ const char* BenchmarkRig::GetRigTypeName( RigType rigType )
+{
+	switch( rigType )
+	{
+		case RIG_CHAIN:				return "chain";
+		case RIG_GRID:				return "grid";
+		case RIG_TRUSS:				return "truss";
+		case RIG_RANDOM_GEOMETRIC:	return "random_geometric";
+		case RIG_LINKAGE:			return "linkage";
+		default:					return "unknown";
+	}
+}
+
+/*static*/ bool BenchmarkRig::FindRigType( const std::string& name, RigType& rigType )
+{
+	for( int i = 0; i < RIG_COUNT; i++ )
+	{
+		if( name == GetRigTypeName( RigType(i) ) )
+		{
+			rigType = RigType(i);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void BenchmarkRig::Build( KinematicGraph& kinematicGraph )
+{
+	kinematicGraph.Clear();
+	idArray.clear();
+	edgeCount = 0;
+	dragVertex = -1;
+
+	switch( settings.rigType )
+	{
+		case RIG_CHAIN:				BuildChain( kinematicGraph ); break;
+		case RIG_GRID:				BuildGrid( kinematicGraph ); break;
+		case RIG_TRUSS:				BuildTruss( kinematicGraph ); break;
+		case RIG_RANDOM_GEOMETRIC:	BuildRandomGeometric( kinematicGraph ); break;
+		case RIG_LINKAGE:			BuildLinkage( kinematicGraph ); break;
+		default:					break;
+	}
+
+	dragId = ( dragVertex >= 0 ) ? idArray[ dragVertex ] : 0;
+}
+
+c3ga::vectorE3GA BenchmarkRig::CalcDragDelta( int step, int stepCount ) const
+{
+	double angleA = 2.0 * M_PI * double( step ) / double( stepCount );
+	double angleB = 2.0 * M_PI * double( step + 1 ) / double( stepCount );
+
+	double radius = settings.dragRadius;
+	return c3ga::vectorE3GA( c3ga::vectorE3GA::coord_e1_e2_e3,
+		radius * ( cos( angleB ) - cos( angleA ) ),
+		radius * ( sin( angleB ) - sin( angleA ) ),
+		0.0 );
+}
+
+int BenchmarkRig::AddVertex( KinematicGraph& kinematicGraph, double x, double y )
+{
+	idArray.push_back( kinematicGraph.InsertVertex( c3ga::vectorE3GA( c3ga::vectorE3GA::coord_e1_e2_e3, x, y, 0.0 ) ) );
+	return ( int )idArray.size() - 1;
+}
+
+void BenchmarkRig::AddEdge( KinematicGraph& kinematicGraph, int vertexA, int vertexB )
+{
+	if( kinematicGraph.ConnectVertices( idArray[ vertexA ], idArray[ vertexB ] ) )
+		edgeCount++;
+}
+
+// Pin vertices spread evenly through the candidate list, starting with
+// its first entry.  The dragged vertex is never pinned.
+void BenchmarkRig::PinVertices( KinematicGraph& kinematicGraph, const std::vector< int >& candidateArray )
+{
+	std::vector< int > pinArray;
+	for( int i = 0; i < ( int )candidateArray.size(); i++ )
+		if( candidateArray[i] != dragVertex )
+			pinArray.push_back( candidateArray[i] );
+
+	int pinCount = std::min( settings.stationaryCount, ( int )pinArray.size() );
+	for( int i = 0; i < pinCount; i++ )
+		kinematicGraph.SetVertexStationary( idArray[ pinArray[ i * ( int )pinArray.size() / pinCount ] ], true );
+}
+
+void BenchmarkRig::BuildChain( KinematicGraph& kinematicGraph )
+{
+	int count = std::max( settings.size, 2 );
+
+	std::vector< int > candidateArray;
+	for( int i = 0; i < count; i++ )
+	{
+		AddVertex( kinematicGraph, double(i), 0.0 );
+		if( i > 0 )
+			AddEdge( kinematicGraph, i - 1, i );
+		candidateArray.push_back(i);
+	}
+
+	dragVertex = count - 1;
+	PinVertices( kinematicGraph, candidateArray );
+}
+
+void BenchmarkRig::BuildGrid( KinematicGraph& kinematicGraph )
+{
+	int side = std::max( int( sqrt( double( settings.size ) ) + 0.5 ), 2 );
+
+	std::vector< int > candidateArray;
+	for( int y = 0; y < side; y++ )
+	{
+		for( int x = 0; x < side; x++ )
+		{
+			int vertex = AddVertex( kinematicGraph, double(x), double(y) );
+			if( x > 0 )
+				AddEdge( kinematicGraph, vertex - 1, vertex );
+			if( y > 0 )
+				AddEdge( kinematicGraph, vertex - side, vertex );
+			if( y == 0 )
+				candidateArray.push_back( vertex );
+		}
+	}
+
+	dragVertex = side * side - 1;
+	PinVertices( kinematicGraph, candidateArray );
+}
+
+// A Warren truss: a bottom and a top chord joined by alternating diagonals.
+void BenchmarkRig::BuildTruss( KinematicGraph& kinematicGraph )
+{
+	int columnCount = std::max( settings.size / 2, 2 );
+	double height = sqrt( 3.0 ) / 2.0;
+
+	std::vector< int > candidateArray;
+	for( int i = 0; i < columnCount; i++ )
+	{
+		int bottom = AddVertex( kinematicGraph, double(i), 0.0 );
+		int top = AddVertex( kinematicGraph, double(i) + 0.5, height );
+
+		AddEdge( kinematicGraph, bottom, top );
+		if( i > 0 )
+		{
+			AddEdge( kinematicGraph, bottom - 2, bottom );
+			AddEdge( kinematicGraph, top - 2, top );
+			AddEdge( kinematicGraph, top - 2, bottom );
+		}
+
+		candidateArray.push_back( bottom );
+	}
+
+	dragVertex = 2 * columnCount - 1;
+	PinVertices( kinematicGraph, candidateArray );
+}
+
+// Scatter the points over a square sized so that each has about seven
+// neighbors within the connection radius, and bucket them by cell so that
+// only nearby pairs are tested.  The vertex nearest the middle is dragged,
+// which puts it in the largest component with high probability.
+void BenchmarkRig::BuildRandomGeometric( KinematicGraph& kinematicGraph )
+{
+	int count = std::max( settings.size, 2 );
+	double radius = 1.5;
+	double side = sqrt( double( count ) );
+
+	std::mt19937 random( settings.seed );
+	std::uniform_real_distribution< double > distribution( 0.0, side );
+
+	std::vector< double > xArray( count ), yArray( count );
+	for( int i = 0; i < count; i++ )
+	{
+		xArray[i] = distribution( random );
+		yArray[i] = distribution( random );
+		AddVertex( kinematicGraph, xArray[i], yArray[i] );
+	}
+
+	int cellCount = std::max( int( side / radius ), 1 );
+	std::vector< std::vector< int > > cellArray( cellCount * cellCount );
+	for( int i = 0; i < count; i++ )
+	{
+		int cellX = std::min( int( xArray[i] / side * cellCount ), cellCount - 1 );
+		int cellY = std::min( int( yArray[i] / side * cellCount ), cellCount - 1 );
+		cellArray[ cellY * cellCount + cellX ].push_back(i);
+	}
+
+	for( int i = 0; i < count; i++ )
+	{
+		int cellX = std::min( int( xArray[i] / side * cellCount ), cellCount - 1 );
+		int cellY = std::min( int( yArray[i] / side * cellCount ), cellCount - 1 );
+
+		for( int y = std::max( cellY - 1, 0 ); y <= std::min( cellY + 1, cellCount - 1 ); y++ )
+		{
+			for( int x = std::max( cellX - 1, 0 ); x <= std::min( cellX + 1, cellCount - 1 ); x++ )
+			{
+				const std::vector< int >& cell = cellArray[ y * cellCount + x ];
+				for( int j = 0; j < ( int )cell.size(); j++ )
+				{
+					int other = cell[j];
+					double dx = xArray[ other ] - xArray[i];
+					double dy = yArray[ other ] - yArray[i];
+					if( other > i && dx * dx + dy * dy < radius * radius )
+						AddEdge( kinematicGraph, i, other );
+				}
+			}
+		}
+	}
+
+	double bestDistance = HUGE_VAL;
+	for( int i = 0; i < count; i++ )
+	{
+		double dx = xArray[i] - side / 2.0;
+		double dy = yArray[i] - side / 2.0;
+		if( dx * dx + dy * dy < bestDistance )
+		{
+			bestDistance = dx * dx + dy * dy;
+			dragVertex = i;
+		}
+	}
+
+	std::vector< int > candidateArray( count );
+	for( int i = 0; i < count; i++ )
+		candidateArray[i] = i;
+	std::shuffle( candidateArray.begin(), candidateArray.end(), random );
+
+	PinVertices( kinematicGraph, candidateArray );
+}
+
+// A ladder whose every bay is an unbraced four-bar linkage, pinned along
+// its bottom rail.  Long and thin, so corrections travel a long way.
+void BenchmarkRig::BuildLinkage( KinematicGraph& kinematicGraph )
+{
+	int columnCount = std::max( settings.size / 2, 2 );
+
+	std::vector< int > candidateArray;
+	for( int i = 0; i < columnCount; i++ )
+	{
+		int bottom = AddVertex( kinematicGraph, double(i), 0.0 );
+		int top = AddVertex( kinematicGraph, double(i), 1.0 );
+
+		AddEdge( kinematicGraph, bottom, top );
+		if( i > 0 )
+		{
+			AddEdge( kinematicGraph, bottom - 2, bottom );
+			AddEdge( kinematicGraph, top - 2, top );
+		}
+
+		candidateArray.push_back( bottom );
+	}
+
+	dragVertex = 2 * columnCount - 1;
+	PinVertices( kinematicGraph, candidateArray );
+}
+
+// BenchmarkRig.cpp
@@ -0,0 +1,71 @@
+// BenchmarkRig.h
+
+#pragma once
+
+#include "KinematicGraph.h"
+#include <vector>
+#include <string>
+
+// Generates a parameterized synthetic rig in a kinematic graph, along with
+// the vertex to drag and a scripted drag trajectory for it.  Rigs are laid
+// out in the plane with unit edge lengths (where the rig has regular edges)
+// and are fully determined by their settings, including the random seed.
+class BenchmarkRig
+{
+public:
+
+	enum RigType
+	{
+		RIG_CHAIN,				// A single open chain.
+		RIG_GRID,				// A square grid of unbraced squares.
+		RIG_TRUSS,				// A braced strip of triangles; rigid apart from its supports.
+		RIG_RANDOM_GEOMETRIC,	// Random points joined when closer than a fixed radius.
+		RIG_LINKAGE,			// A ladder of four-bar linkages.
+		RIG_COUNT,
+	};
+
+	struct Settings
+	{
+		RigType rigType;
+		int size;				// Roughly the number of vertices.
+		int stationaryCount;	// Vertices pinned to their stations.
+		unsigned int seed;
+		double dragRadius;		// Radius of the circle traced by the dragged vertex.
+	};
+
+	BenchmarkRig( const Settings& settings );
+	~BenchmarkRig( void );
+
+	void Build( KinematicGraph& kinematicGraph );
+
+	// The move to apply at a given step of a drag that traces a circle
+	// through the starting point of the dragged vertex in stepCount steps.
+	c3ga::vectorE3GA CalcDragDelta( int step, int stepCount ) const;
+
+	int GetDragId( void ) const { return dragId; }
+	int GetVertexCount( void ) const { return ( int )idArray.size(); }
+	int GetEdgeCount( void ) const { return edgeCount; }
+
+	static const char* GetRigTypeName( RigType rigType );
+	static bool FindRigType( const std::string& name, RigType& rigType );
+
+private:
+
+	int AddVertex( KinematicGraph& kinematicGraph, double x, double y );
+	void AddEdge( KinematicGraph& kinematicGraph, int vertexA, int vertexB );
+	void PinVertices( KinematicGraph& kinematicGraph, const std::vector< int >& candidateArray );
+
+	void BuildChain( KinematicGraph& kinematicGraph );
+	void BuildGrid( KinematicGraph& kinematicGraph );
+	void BuildTruss( KinematicGraph& kinematicGraph );
+	void BuildRandomGeometric( KinematicGraph& kinematicGraph );
+	void BuildLinkage( KinematicGraph& kinematicGraph );
+
+	Settings settings;
+	std::vector< int > idArray;
+	int edgeCount;
+	int dragVertex;
+	int dragId;
+};
+
+// BenchmarkRig.h
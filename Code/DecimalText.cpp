@@ -0,0 +1,592 @@
+// DecimalText.cpp
+
+#include "DecimalText.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#if defined( _MSC_VER ) && defined( _M_X64 )
+#	include <intrin.h>
+#endif
+
+namespace
+{
+	// 10^k is approximately high:low * 2^exponent, with the top bit of high
+	// set.  The approximations are those of the Eisel-Lemire algorithm:
+	// truncated for k >= 0, and for k < 0 the quotient that defines them is
+	// rounded up by one unit before, or for k >= -27 after, being truncated
+	// to 128 bits.
+	struct PowerOfTen
+	{
+		unsigned long long high;
+		unsigned long long low;
+		int exponent;
+	};
+
+	// Computed exactly with big integer arithmetic the first time it is
+	// needed, rather than pasted in as several hundred constants.
+	class PowerTable
+	{
+	public:
+
+		enum
+		{
+			MIN_EXPONENT = -348,
+			MAX_EXPONENT = 347,
+		};
+
+		PowerTable( void );
+
+		const PowerOfTen& operator[]( int k ) const { return powerArray[ k - MIN_EXPONENT ]; }
+
+	private:
+
+		typedef std::vector< unsigned int > BigInteger;		// Little-endian 32-bit limbs.
+
+		static int BitLength( const BigInteger& integer );
+		static void SetTop128( PowerOfTen& power, const BigInteger& integer, int bitLength );
+
+		PowerOfTen powerArray[ MAX_EXPONENT - MIN_EXPONENT + 1 ];
+	};
+
+	PowerTable::PowerTable( void )
+	{
+		// 10^k and 5^k differ only by a power of two, so the table is built
+		// from powers of five, which keeps the numbers smaller.
+		BigInteger integer( 1, 1 );
+		for( int k = 0; k <= MAX_EXPONENT; k++ )
+		{
+			int bitLength = BitLength( integer );
+			PowerOfTen& power = powerArray[ k - MIN_EXPONENT ];
+			SetTop128( power, integer, bitLength );
+			power.exponent = k + bitLength - 128;
+
+			unsigned long long carry = 0;
+			for( int i = 0; i < ( int )integer.size(); i++ )
+			{
+				carry += ( unsigned long long )integer[i] * 5;
+				integer[i] = ( unsigned int )carry;
+				carry >>= 32;
+			}
+			if( carry )
+				integer.push_back( ( unsigned int )carry );
+		}
+
+		// Floor division by five at each step gives floor( 2^SHIFT / 5^n ),
+		// which has at least 128 significant bits for every n in the table.
+		enum { SHIFT = 1024 };
+		integer.assign( SHIFT / 32 + 1, 0 );
+		integer.back() = 1;
+		for( int n = 1; n <= -MIN_EXPONENT; n++ )
+		{
+			unsigned long long remainder = 0;
+			for( int i = ( int )integer.size() - 1; i >= 0; i-- )
+			{
+				remainder = ( remainder << 32 ) | integer[i];
+				integer[i] = ( unsigned int )( remainder / 5 );
+				remainder %= 5;
+			}
+			while( integer.back() == 0 )
+				integer.pop_back();
+
+			PowerOfTen& power = powerArray[ -n - MIN_EXPONENT ];
+			if( n <= 27 )
+			{
+				int bitLength = BitLength( integer );
+				SetTop128( power, integer, bitLength );
+				power.exponent = -n - SHIFT + bitLength - 128;
+				power.low++;
+				if( power.low == 0 )
+					power.high++;
+			}
+			else
+			{
+				BigInteger roundedInteger = integer;
+				for( int i = 0; i < ( int )roundedInteger.size() && ++roundedInteger[i] == 0; i++ )
+					;
+				int bitLength = BitLength( roundedInteger );
+				SetTop128( power, roundedInteger, bitLength );
+				power.exponent = -n - SHIFT + bitLength - 128;
+			}
+		}
+	}
+
+	/*static*/ int PowerTable::BitLength( const BigInteger& integer )
+	{
+		int bitLength = 32 * ( int )integer.size();
+		for( unsigned int top = integer.back(); !( top & 0x80000000u ); top <<= 1 )
+			bitLength--;
+		return bitLength;
+	}
+
+	/*static*/ void PowerTable::SetTop128( PowerOfTen& power, const BigInteger& integer, int bitLength )
+	{
+		power.high = 0;
+		power.low = 0;
+		for( int i = 0; i < 128; i++ )
+		{
+			int bit = bitLength - 1 - i;
+			unsigned long long value = ( bit >= 0 ) ? ( integer[ bit / 32 ] >> ( bit % 32 ) ) & 1 : 0;
+			power.high = ( power.high << 1 ) | ( power.low >> 63 );
+			power.low = ( power.low << 1 ) | value;
+		}
+	}
+
+	const PowerTable& GetPowerTable( void )
+	{
+		static const PowerTable powerTable;
+		return powerTable;
+	}
+
+	unsigned long long Multiply( unsigned long long a, unsigned long long b, unsigned long long& low )
+	{
+#if defined( _MSC_VER ) && defined( _M_X64 )
+		unsigned long long high;
+		low = _umul128( a, b, &high );
+		return high;
+#elif defined( __SIZEOF_INT128__ )
+		unsigned __int128 product = ( unsigned __int128 )a * b;
+		low = ( unsigned long long )product;
+		return ( unsigned long long )( product >> 64 );
+#else
+		unsigned long long a0 = a & 0xFFFFFFFFu, a1 = a >> 32;
+		unsigned long long b0 = b & 0xFFFFFFFFu, b1 = b >> 32;
+		unsigned long long p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+		unsigned long long middle = ( p00 >> 32 ) + ( p01 & 0xFFFFFFFFu ) + ( p10 & 0xFFFFFFFFu );
+		low = ( middle << 32 ) | ( p00 & 0xFFFFFFFFu );
+		return p11 + ( p01 >> 32 ) + ( p10 >> 32 ) + ( middle >> 32 );
+#endif
+	}
+
+	int CountLeadingZeros( unsigned long long x )
+	{
+		int count = 0;
+		if( !( x >> 32 ) ) { count += 32; x <<= 32; }
+		if( !( x >> 48 ) ) { count += 16; x <<= 16; }
+		if( !( x >> 56 ) ) { count += 8; x <<= 8; }
+		if( !( x >> 60 ) ) { count += 4; x <<= 4; }
+		if( !( x >> 62 ) ) { count += 2; x <<= 2; }
+		if( !( x >> 63 ) ) { count += 1; }
+		return count;
+	}
+
+	bool IsDigit( char c )
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	// The Eisel-Lemire algorithm, after the Go standard library: multiply
+	// the normalized mantissa by the 128-bit approximation of 10^exponent and
+	// round, giving up wherever the approximation leaves the rounding in doubt.
+	bool ConvertEiselLemire( unsigned long long mantissa, int exponent, bool negative, double& value )
+	{
+		if( exponent < PowerTable::MIN_EXPONENT || exponent > PowerTable::MAX_EXPONENT )
+			return false;
+
+		const PowerOfTen& power = GetPowerTable()[ exponent ];
+
+		int leadingZeros = CountLeadingZeros( mantissa );
+		mantissa <<= leadingZeros;
+		unsigned long long resultExponent = ( unsigned long long )( ( ( 217706 * exponent ) >> 16 ) + 64 + 1023 ) - leadingZeros;
+
+		unsigned long long low;
+		unsigned long long high = Multiply( mantissa, power.high, low );
+
+		if( ( high & 0x1FF ) == 0x1FF && low + mantissa < mantissa )
+		{
+			unsigned long long wideLow;
+			unsigned long long wideHigh = Multiply( mantissa, power.low, wideLow );
+			unsigned long long mergedHigh = high;
+			unsigned long long mergedLow = low + wideHigh;
+			if( mergedLow < low )
+				mergedHigh++;
+			if( ( mergedHigh & 0x1FF ) == 0x1FF && mergedLow + 1 == 0 && wideLow + mantissa < mantissa )
+				return false;
+			high = mergedHigh;
+			low = mergedLow;
+		}
+
+		unsigned long long topBit = high >> 63;
+		unsigned long long resultMantissa = high >> ( topBit + 9 );
+		resultExponent -= 1 ^ topBit;
+
+		// Exactly halfway between two doubles.
+		if( low == 0 && ( high & 0x1FF ) == 0 && ( resultMantissa & 3 ) == 1 )
+			return false;
+
+		resultMantissa += resultMantissa & 1;
+		resultMantissa >>= 1;
+		if( resultMantissa >> 53 )
+		{
+			resultMantissa >>= 1;
+			resultExponent++;
+		}
+
+		// Subnormal, infinite or out of range.
+		if( resultExponent - 1 >= 0x7FF - 1 )
+			return false;
+
+		unsigned long long bits = ( resultExponent << 52 ) | ( resultMantissa & ( ( 1ULL << 52 ) - 1 ) );
+		if( negative )
+			bits |= 1ULL << 63;
+		memcpy( &value, &bits, sizeof( value ) );
+		return true;
+	}
+
+	// A floating-point number f * 2^e with a 64-bit significand.
+	struct DiyFp
+	{
+		unsigned long long f;
+		int e;
+
+		DiyFp( unsigned long long f, int e ) : f( f ), e( e ) {}
+	};
+
+	DiyFp MultiplyRounded( const DiyFp& x, const DiyFp& y )
+	{
+		unsigned long long low;
+		unsigned long long high = Multiply( x.f, y.f, low );
+		return DiyFp( high + ( low >> 63 ), x.e + y.e + 64 );
+	}
+
+	DiyFp Normalize( DiyFp x )
+	{
+		int shift = CountLeadingZeros( x.f );
+		return DiyFp( x.f << shift, x.e - shift );
+	}
+
+	// The number and the midpoints between it and its neighbors, scaled to
+	// a common exponent.  A neighbor below a power of two is twice as close.
+	struct Boundaries
+	{
+		DiyFp w;
+		DiyFp minus;
+		DiyFp plus;
+
+		Boundaries( void ) : w( 0, 0 ), minus( 0, 0 ), plus( 0, 0 ) {}
+	};
+
+	Boundaries CalcBoundaries( unsigned long long bits, int precision, int bias )
+	{
+		unsigned long long hiddenBit = 1ULL << ( precision - 1 );
+		unsigned long long fraction = bits & ( hiddenBit - 1 );
+		int biasedExponent = int( bits >> ( precision - 1 ) );
+
+		DiyFp v = ( biasedExponent == 0 ) ? DiyFp( fraction, 1 - bias ) : DiyFp( fraction + hiddenBit, biasedExponent - bias );
+		bool lowerCloser = ( fraction == 0 && biasedExponent > 1 );
+
+		DiyFp plus( 2 * v.f + 1, v.e - 1 );
+		DiyFp minus = lowerCloser ? DiyFp( 4 * v.f - 1, v.e - 2 ) : DiyFp( 2 * v.f - 1, v.e - 1 );
+
+		Boundaries boundaries;
+		boundaries.plus = Normalize( plus );
+		boundaries.minus = DiyFp( minus.f << ( minus.e - boundaries.plus.e ), boundaries.plus.e );
+		boundaries.w = Normalize( v );
+		return boundaries;
+	}
+
+	void RoundWeed( char* digitArray, int digitCount, unsigned long long distance, unsigned long long delta, unsigned long long rest, unsigned long long tenKappa )
+	{
+		while( rest < distance && delta - rest >= tenKappa && ( rest + tenKappa < distance || distance - rest > rest + tenKappa - distance ) )
+		{
+			digitArray[ digitCount - 1 ]--;
+			rest += tenKappa;
+		}
+	}
+
+	// Grisu2, after Florian Loitsch's paper: scale the number and its
+	// boundaries by a cached power of ten so that the integer part of the
+	// upper boundary fits 32 bits, generate digits of it until the rest is
+	// within the boundaries, then nudge the last digit towards the number.
+	int GenerateDigits( char* digitArray, int& decimalExponent, const Boundaries& boundaries )
+	{
+		enum { ALPHA = -60, GAMMA = -32 };
+
+		int f = ALPHA - boundaries.plus.e - 1;
+		int k = ( f * 78913 ) / ( 1 << 18 ) + ( f > 0 ? 1 : 0 );
+		const PowerOfTen& power = GetPowerTable()[k];
+		unsigned long long powerF = power.high + ( power.low >> 63 );
+		int powerE = power.exponent + 64;
+		if( powerF == 0 )
+		{
+			powerF = 1ULL << 63;
+			powerE++;
+		}
+		DiyFp cachedPower( powerF, powerE );
+
+		DiyFp w = MultiplyRounded( boundaries.w, cachedPower );
+		DiyFp wMinus = MultiplyRounded( boundaries.minus, cachedPower );
+		DiyFp wPlus = MultiplyRounded( boundaries.plus, cachedPower );
+
+		// Stay safely inside the boundaries despite the rounding errors.
+		DiyFp upper( wPlus.f - 1, wPlus.e );
+		DiyFp lower( wMinus.f + 1, wMinus.e );
+		decimalExponent = -k;
+
+		unsigned long long delta = upper.f - lower.f;
+		unsigned long long distance = upper.f - w.f;
+
+		int shift = -upper.e;
+		unsigned long long one = 1ULL << shift;
+		unsigned int integral = ( unsigned int )( upper.f >> shift );
+		unsigned long long fractional = upper.f & ( one - 1 );
+
+		unsigned int divisor = 1;
+		int kappa = 1;
+		while( kappa < 10 && integral / divisor >= 10 )
+		{
+			divisor *= 10;
+			kappa++;
+		}
+
+		int digitCount = 0;
+		while( kappa > 0 )
+		{
+			digitArray[ digitCount++ ] = char( '0' + integral / divisor );
+			integral %= divisor;
+			kappa--;
+
+			unsigned long long rest = ( ( unsigned long long )integral << shift ) + fractional;
+			if( rest <= delta )
+			{
+				decimalExponent += kappa;
+				RoundWeed( digitArray, digitCount, distance, delta, rest, ( unsigned long long )divisor << shift );
+				return digitCount;
+			}
+
+			divisor /= 10;
+		}
+
+		int fractionCount = 0;
+		while( true )
+		{
+			fractional *= 10;
+			digitArray[ digitCount++ ] = char( '0' + ( fractional >> shift ) );
+			fractional &= one - 1;
+			fractionCount++;
+			delta *= 10;
+			distance *= 10;
+			if( fractional <= delta )
+				break;
+		}
+
+		decimalExponent -= fractionCount;
+		RoundWeed( digitArray, digitCount, distance, delta, fractional, one );
+		return digitCount;
+	}
+
+	// Lay out the digits in plain notation if that takes no more than about
+	// as many characters as the digits themselves, and in scientific
+	// notation otherwise.
+	int WriteNumber( char* text, bool negative, const char* digitArray, int digitCount, int decimalExponent )
+	{
+		enum { MAX_PLAIN_POINT = 17, MIN_PLAIN_POINT = -4 };
+
+		int length = 0;
+		if( negative )
+			text[ length++ ] = '-';
+
+		int point = digitCount + decimalExponent;
+		if( digitCount <= point && point <= MAX_PLAIN_POINT )
+		{
+			memcpy( text + length, digitArray, digitCount );
+			length += digitCount;
+			for( int i = digitCount; i < point; i++ )
+				text[ length++ ] = '0';
+		}
+		else if( 0 < point && point <= MAX_PLAIN_POINT )
+		{
+			memcpy( text + length, digitArray, point );
+			length += point;
+			text[ length++ ] = '.';
+			memcpy( text + length, digitArray + point, digitCount - point );
+			length += digitCount - point;
+		}
+		else if( MIN_PLAIN_POINT < point && point <= 0 )
+		{
+			text[ length++ ] = '0';
+			text[ length++ ] = '.';
+			for( int i = point; i < 0; i++ )
+				text[ length++ ] = '0';
+			memcpy( text + length, digitArray, digitCount );
+			length += digitCount;
+		}
+		else
+		{
+			text[ length++ ] = digitArray[0];
+			if( digitCount > 1 )
+			{
+				text[ length++ ] = '.';
+				memcpy( text + length, digitArray + 1, digitCount - 1 );
+				length += digitCount - 1;
+			}
+
+			int exponent = point - 1;
+			text[ length++ ] = 'e';
+			text[ length++ ] = ( exponent < 0 ) ? '-' : '+';
+			if( exponent < 0 )
+				exponent = -exponent;
+			if( exponent >= 100 )
+				text[ length++ ] = char( '0' + exponent / 100 );
+			text[ length++ ] = char( '0' + exponent / 10 % 10 );
+			text[ length++ ] = char( '0' + exponent % 10 );
+		}
+
+		text[ length ] = '\0';
+		return length;
+	}
+
+	int FormatBits( char* text, unsigned long long bits, int precision, int exponentBits )
+	{
+		int signShift = precision - 1 + exponentBits;
+		bool negative = ( ( bits >> signShift ) & 1 ) != 0;
+		bits &= ( 1ULL << signShift ) - 1;
+
+		int maxBiasedExponent = ( 1 << exponentBits ) - 1;
+		if( int( bits >> ( precision - 1 ) ) == maxBiasedExponent )
+		{
+			const char* special = ( bits & ( ( 1ULL << ( precision - 1 ) ) - 1 ) ) ? "nan" : ( negative ? "-inf" : "inf" );
+			strcpy( text, special );
+			return int( strlen( special ) );
+		}
+
+		if( bits == 0 )
+		{
+			const char digit = '0';
+			return WriteNumber( text, negative, &digit, 1, 0 );
+		}
+
+		int bias = ( 1 << ( exponentBits - 1 ) ) - 1 + precision - 1;
+		char digitArray[20];
+		int decimalExponent = 0;
+		int digitCount = GenerateDigits( digitArray, decimalExponent, CalcBoundaries( bits, precision, bias ) );
+		return WriteNumber( text, negative, digitArray, digitCount, decimalExponent );
+	}
+}
+
+/*static*/ int DecimalText::Format( char* text, double value )
+{
+	unsigned long long bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	return FormatBits( text, bits, 53, 11 );
+}
+
+// The digits are chosen to read back as the same float, but are read as a
+// double first, which in very rare cases could round differently; any such
+// number is written with the nine digits that always read back correctly.
+/*static*/ int DecimalText::Format( char* text, float value )
+{
+	unsigned int bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	int length = FormatBits( text, bits, 24, 8 );
+
+	const char* cursor = text;
+	double parsedValue = 0.0;
+	if( value - value == 0.f && ( !Parse( cursor, parsedValue ) || float( parsedValue ) != value ) )
+		length = snprintf( text, MAX_LENGTH, "%.9g", double( value ) );
+
+	return length;
+}
+
+/*static*/ bool DecimalText::Parse( const char*& cursor, double& value )
+{
+	static const double powerOfTenArray[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+
+	const char* c = cursor;
+	bool negative = ( *c == '-' );
+	if( *c == '-' || *c == '+' )
+		c++;
+
+	unsigned long long mantissa = 0;
+	int digitCount = 0;
+	int exponent = 0;
+	bool anyDigit = false;
+
+	for( ; IsDigit( *c ); c++ )
+	{
+		anyDigit = true;
+		if( mantissa != 0 || *c != '0' )
+			digitCount++;
+		mantissa = mantissa * 10 + ( *c - '0' );
+	}
+
+	if( *c == '.' )
+	{
+		for( c++; IsDigit( *c ); c++ )
+		{
+			anyDigit = true;
+			if( mantissa != 0 || *c != '0' )
+				digitCount++;
+			mantissa = mantissa * 10 + ( *c - '0' );
+			exponent--;
+		}
+	}
+
+	if( !anyDigit )
+		return false;
+
+	if( *c == 'e' || *c == 'E' )
+	{
+		const char* e = c + 1;
+		bool negativeExponent = ( *e == '-' );
+		if( *e == '-' || *e == '+' )
+			e++;
+
+		// Without digits the 'e' is not part of the number, as for strtod.
+		if( IsDigit( *e ) )
+		{
+			int exponentValue = 0;
+			for( ; IsDigit( *e ); e++ )
+			{
+				if( exponentValue < 100000 )
+					exponentValue = exponentValue * 10 + ( *e - '0' );
+			}
+
+			exponent += negativeExponent ? -exponentValue : exponentValue;
+			c = e;
+		}
+	}
+
+	// Beyond 19 digits the mantissa has overflowed, so only strtod will do.
+	bool converted = false;
+	if( digitCount <= 19 )
+	{
+		if( mantissa == 0 )
+		{
+			value = negative ? -0.0 : 0.0;
+			converted = true;
+		}
+		else if( mantissa <= ( 1ULL << 53 ) && exponent >= -22 && exponent <= 22 )
+		{
+			// Both operands are exact, so the one rounding is correct.
+			value = double( mantissa );
+			if( exponent < 0 )
+				value /= powerOfTenArray[ -exponent ];
+			else
+				value *= powerOfTenArray[ exponent ];
+			if( negative )
+				value = -value;
+			converted = true;
+		}
+		else
+			converted = ConvertEiselLemire( mantissa, exponent, negative, value );
+	}
+
+	if( !converted )
+	{
+		char* end = nullptr;
+		value = strtod( cursor, &end );
+		if( end != c )
+			return false;
+	}
+
+	cursor = c;
+	return true;
+}
+
+// DecimalText.cpp
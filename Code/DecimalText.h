@@ -0,0 +1,32 @@
+// DecimalText.h
+
+#pragma once
+
+// Converts between binary floating-point numbers and decimal text, quickly
+// and without loss.  Formatting writes the shortest (or very nearly the
+// shortest) digit string that reads back to the same number, by the Grisu2
+// algorithm; parsing is correctly rounded, by a single multiplication for
+// short numbers and otherwise by the Eisel-Lemire algorithm, with strtod
+// left for the rare inputs neither can decide.  Neither depends on the
+// locale, except through that fallback.
+class DecimalText
+{
+public:
+
+	// The longest text written, including the terminating null.
+	enum { MAX_LENGTH = 32 };
+
+	// Write the number as a null-terminated string, in plain notation where
+	// that is short and in scientific notation otherwise, and return its
+	// length.  Floats are written with as few digits as floats need.
+	static int Format( char* text, double value );
+	static int Format( char* text, float value );
+
+	// Parse an optionally signed decimal number, with an optional fraction
+	// and exponent, starting right at the cursor, and advance the cursor
+	// past it.  Infinities and NaNs are not accepted, but a number too large
+	// for a double parses to infinity.
+	static bool Parse( const char*& cursor, double& value );
+};
+
+// DecimalText.h
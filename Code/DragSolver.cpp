@@ -0,0 +1,160 @@
+// DragSolver.cpp
+
+#include "DragSolver.h"
+#include "KinematicGraph.h"
+#include <algorithm>
+
+DragSolver::DragSolver( void )
+{
+	kinematicGraph = nullptr;
+	vertexId = 0;
+	targetPending = false;
+	stopping = false;
+	frontSnapshot = 0;
+	solveCount = 0;
+	skipCount = 0;
+
+	for( int i = 0; i < 2; i++ )
+	{
+		snapshotArray[i].firstVertex = 0;
+		snapshotArray[i].fresh = false;
+	}
+}
+
+DragSolver::~DragSolver( void )
+{
+	Stop();
+}
+
+bool DragSolver::Start( KinematicGraph* kinematicGraph, int vertexId )
+{
+	Stop();
+
+	c3ga::vectorE3GA location;
+	if( !kinematicGraph->GetVertexLocation( vertexId, location ) )
+		return false;
+
+	this->kinematicGraph = kinematicGraph;
+	this->vertexId = vertexId;
+	targetPending = false;
+	stopping = false;
+	solveCount = 0;
+	skipCount = 0;
+
+	for( int i = 0; i < 2; i++ )
+		snapshotArray[i].fresh = false;
+
+	thread = std::thread( &DragSolver::SolverThread, this );
+	return true;
+}
+
+void DragSolver::Stop( void )
+{
+	if( !kinematicGraph )
+		return;
+
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		stopping = true;
+	}
+
+	wakeCondition.notify_one();
+	thread.join();
+
+	kinematicGraph = nullptr;
+}
+
+void DragSolver::SetTarget( const c3ga::vectorE3GA& target )
+{
+	if( !kinematicGraph )
+		return;
+
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		if( targetPending )
+			skipCount++;
+
+		this->target = target;
+		targetPending = true;
+	}
+
+	wakeCondition.notify_one();
+}
+
+bool DragSolver::TakeSnapshot( std::vector< float >& locationArray, int& firstVertex, int& endVertex )
+{
+	std::lock_guard< std::mutex > lock( mutex );
+
+	Snapshot& snapshot = snapshotArray[ frontSnapshot ];
+	if( !snapshot.fresh )
+		return false;
+
+	snapshot.fresh = false;
+
+	// The array may be out of date with the graph; copy only what fits.
+	firstVertex = snapshot.firstVertex;
+	endVertex = snapshot.firstVertex + ( int )snapshot.locationArray.size() / 2;
+	if( endVertex > ( int )locationArray.size() / 2 )
+		endVertex = ( int )locationArray.size() / 2;
+
+	if( firstVertex >= endVertex )
+		return false;
+
+	std::copy( snapshot.locationArray.begin(), snapshot.locationArray.begin() + 2 * ( endVertex - firstVertex ), locationArray.begin() + 2 * firstVertex );
+	return true;
+}
+
+void DragSolver::SolverThread( void )
+{
+	while( true )
+	{
+		std::unique_lock< std::mutex > lock( mutex );
+		wakeCondition.wait( lock, [this]{ return targetPending || stopping; } );
+		if( !targetPending )
+			break;
+
+		c3ga::vectorE3GA currentTarget = target;
+		targetPending = false;
+		lock.unlock();
+
+		c3ga::vectorE3GA location;
+		if( !kinematicGraph->GetVertexLocation( vertexId, location ) )
+			break;
+
+		kinematicGraph->MoveVertex( vertexId, currentTarget - location );
+		Publish();
+	}
+}
+
+// The graph's moved range is left for the renderer, so it covers every
+// vertex moved since the renderer last drew the graph itself, and a
+// snapshot taken late loses nothing to those it replaced.
+void DragSolver::Publish( void )
+{
+	int backSnapshot = 1 - frontSnapshot;
+	Snapshot& snapshot = snapshotArray[ backSnapshot ];
+
+	int firstVertex = kinematicGraph->movedVertexBegin;
+	int endVertex = kinematicGraph->movedVertexEnd;
+	snapshot.firstVertex = firstVertex;
+	snapshot.locationArray.resize( 2 * ( endVertex - firstVertex ) );
+	for( int vertex = firstVertex; vertex < endVertex; vertex++ )
+	{
+		const KinematicGraph::Vector& location = kinematicGraph->vertexLocationArray[ vertex ];
+		snapshot.locationArray[ 2 * ( vertex - firstVertex ) ] = float( location.get_e1() );
+		snapshot.locationArray[ 2 * ( vertex - firstVertex ) + 1 ] = float( location.get_e2() );
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		snapshot.fresh = true;
+		snapshotArray[ frontSnapshot ].fresh = false;
+		frontSnapshot = backSnapshot;
+		solveCount++;
+	}
+
+	if( publishCallback )
+		publishCallback();
+}
+
+// DragSolver.cpp
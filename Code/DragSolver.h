@@ -0,0 +1,89 @@
+// DragSolver.h
+
+#pragma once
+
+#include "C3GA/c3ga.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+class KinematicGraph;
+
+// Drags a vertex of a kinematic graph on a thread of its own, so that the
+// thread handling input never waits for a solve.  The targets it is given
+// are coalesced: the solver thread always solves for the latest one, and
+// any that arrived while it was busy with a solve are skipped.
+//
+// After each solve the locations of the vertices moved since the drag
+// started are published to a double buffer, from which the thread that
+// draws takes the newest whenever it is ready to, without waiting either.
+class DragSolver
+{
+public:
+
+	typedef std::function< void( void ) > Callback;
+
+	DragSolver( void );
+	~DragSolver( void );
+
+	// Called on the solver thread after each publication, e.g. to have the
+	// drawing thread take the snapshot.
+	void SetPublishCallback( const Callback& publishCallback ) { this->publishCallback = publishCallback; }
+
+	// Hand the graph over to the solver thread to drag the vertex.  Until
+	// Stop, nothing else may change the graph or read its vertex locations.
+	// Returns false if there is no such vertex.
+	bool Start( KinematicGraph* kinematicGraph, int vertexId );
+
+	// Solve for the last target given, then hand the graph back.
+	void Stop( void );
+
+	bool IsDragging( void ) const { return kinematicGraph != nullptr; }
+
+	// Ask for the dragged vertex to be moved to this location.
+	void SetTarget( const c3ga::vectorE3GA& target );
+
+	// If a snapshot has been published since the last call, copy its vertex
+	// locations as e1-e2 pairs into the array, which is indexed by vertex
+	// slot, and return the range of slots copied.
+	bool TakeSnapshot( std::vector< float >& locationArray, int& firstVertex, int& endVertex );
+
+	// How many solves the drag made and how many targets it skipped.  Read
+	// these once the drag has stopped.
+	int GetSolveCount( void ) const { return solveCount; }
+	int GetSkipCount( void ) const { return skipCount; }
+
+private:
+
+	struct Snapshot
+	{
+		std::vector< float > locationArray;		// Pairs for vertex slots from firstVertex on.
+		int firstVertex;
+		bool fresh;
+	};
+
+	void SolverThread( void );
+	void Publish( void );
+
+	KinematicGraph* kinematicGraph;
+	int vertexId;
+	Callback publishCallback;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	c3ga::vectorE3GA target;
+	bool targetPending;
+	bool stopping;
+
+	// The solver thread fills the back snapshot, then swaps it to the front.
+	Snapshot snapshotArray[2];
+	int frontSnapshot;
+
+	int solveCount;
+	int skipCount;
+};
+
+// DragSolver.h
@@ -0,0 +1,486 @@
+// EdgeKernel.cpp
+
+#include "EdgeKernel.h"
+#include <cmath>
+
+// The variants only match if no multiply and add is fused into one
+// instruction, which compilers may do on their own when allowed to target
+// FMA (e.g. GCC's default -ffp-contract=fast), so contraction is turned
+// off here whatever the build's flags.
+#if defined( __clang__ )
+#	pragma STDC FP_CONTRACT OFF
+#elif defined( __GNUC__ )
+#	pragma GCC optimize( "fp-contract=off" )
+#elif defined( _MSC_VER )
+#	pragma fp_contract( off )
+#endif
+
+#if defined( _M_X64 ) || defined( _M_IX86 ) || defined( __x86_64__ ) || defined( __i386__ )
+#	define EDGE_KERNEL_X86
+#	include <immintrin.h>
+#	if defined( _MSC_VER )
+#		include <intrin.h>
+#		define EDGE_KERNEL_TARGET_SSE2
+#		define EDGE_KERNEL_TARGET_AVX2
+#	else
+#		include <cpuid.h>
+#		define EDGE_KERNEL_TARGET_SSE2 __attribute__(( target( "sse2" ) ))
+#		define EDGE_KERNEL_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#	endif
+#endif
+
+namespace
+{
+	// Select the best variant before main() runs.
+	struct EdgeKernelInitializer
+	{
+		EdgeKernelInitializer( void ) { EdgeKernel::SetInstructionSet( EdgeKernel::INSTRUCTION_SET_AVX2 ); }
+	};
+
+	EdgeKernelInitializer edgeKernelInitializer;
+
+#if defined( EDGE_KERNEL_X86 )
+	void CallCpuid( int leaf, int subLeaf, unsigned int registers[4] )
+	{
+#	if defined( _MSC_VER )
+		int info[4];
+		__cpuidex( info, leaf, subLeaf );
+		for( int i = 0; i < 4; i++ )
+			registers[i] = ( unsigned int )info[i];
+#	else
+		registers[0] = registers[1] = registers[2] = registers[3] = 0;
+		__cpuid_count( leaf, subLeaf, registers[0], registers[1], registers[2], registers[3] );
+#	endif
+	}
+
+	unsigned long long ReadExtendedControlRegister( void )
+	{
+#	if defined( _MSC_VER )
+		return _xgetbv(0);
+#	else
+		unsigned int eax, edx;
+		__asm__ __volatile__( "xgetbv" : "=a"( eax ), "=d"( edx ) : "c"(0) );
+		return ( ( unsigned long long )edx << 32 ) | eax;
+#	endif
+	}
+#endif
+}
+
+namespace
+{
+	template< typename Real, int Dimension >
+	void ComputeScalar( const EdgeKernel::Input< Real >& input, const int* edgeList, int first, int count, EdgeKernel::Output< Real >& output )
+	{
+		for( int i = 0; i < count; i++ )
+		{
+			int edge = edgeList ? edgeList[ first + i ] : first + i;
+			const Real* locationA = &input.location[ Dimension * input.edgeVertex[ 2 * edge ] ];
+			const Real* locationB = &input.location[ Dimension * input.edgeVertex[ 2 * edge + 1 ] ];
+
+			Real weightSum = ( input.stationary[ input.edgeVertex[ 2 * edge ] ] ? Real(0) : Real(1) ) +
+								( input.stationary[ input.edgeVertex[ 2 * edge + 1 ] ] ? Real(0) : Real(1) );
+
+			Real x = locationB[0] - locationA[0];
+			Real y = locationB[1] - locationA[1];
+			Real z = 0;
+			Real squareLength = x * x + y * y;
+			if( Dimension == 3 )
+			{
+				z = locationB[ Dimension - 1 ] - locationA[ Dimension - 1 ];
+				squareLength += z * z;
+			}
+			Real length = std::sqrt( squareLength );
+
+			Real error = length - Real( input.restLength[ edge ] );
+			output.error[i] = error;
+
+			if( weightSum == Real(0) || !( length >= input.epsilon ) )
+			{
+				output.correctionX[i] = 0;
+				output.correctionY[i] = 0;
+				if( Dimension == 3 )
+					output.correctionZ[i] = 0;
+				output.active[i] = 0;
+				continue;
+			}
+
+			Real scale = error / ( length * weightSum );
+			output.correctionX[i] = x * scale;
+			output.correctionY[i] = y * scale;
+			if( Dimension == 3 )
+				output.correctionZ[i] = z * scale;
+			output.active[i] = 1;
+		}
+	}
+
+#if defined( EDGE_KERNEL_X86 )
+
+	template< int Dimension >
+	EDGE_KERNEL_TARGET_SSE2 void ComputeSSE2( const EdgeKernel::Input< double >& input, const int* edgeList, int first, int count, EdgeKernel::Output< double >& output )
+	{
+		const __m128d zero = _mm_setzero_pd();
+		const __m128d one = _mm_set1_pd( 1.0 );
+		const __m128d epsilon = _mm_set1_pd( input.epsilon );
+
+		int i = 0;
+		for( ; i + 2 <= count; i += 2 )
+		{
+			int edge0 = edgeList ? edgeList[ first + i ] : first + i;
+			int edge1 = edgeList ? edgeList[ first + i + 1 ] : first + i + 1;
+			int vertexA0 = input.edgeVertex[ 2 * edge0 ], vertexB0 = input.edgeVertex[ 2 * edge0 + 1 ];
+			int vertexA1 = input.edgeVertex[ 2 * edge1 ], vertexB1 = input.edgeVertex[ 2 * edge1 + 1 ];
+			const double* a0 = &input.location[ Dimension * vertexA0 ];
+			const double* b0 = &input.location[ Dimension * vertexB0 ];
+			const double* a1 = &input.location[ Dimension * vertexA1 ];
+			const double* b1 = &input.location[ Dimension * vertexB1 ];
+
+			__m128d x = _mm_sub_pd( _mm_set_pd( b1[0], b0[0] ), _mm_set_pd( a1[0], a0[0] ) );
+			__m128d y = _mm_sub_pd( _mm_set_pd( b1[1], b0[1] ), _mm_set_pd( a1[1], a0[1] ) );
+			__m128d z = zero;
+			__m128d squareLength = _mm_add_pd( _mm_mul_pd( x, x ), _mm_mul_pd( y, y ) );
+			if( Dimension == 3 )
+			{
+				z = _mm_sub_pd( _mm_set_pd( b1[2], b0[2] ), _mm_set_pd( a1[2], a0[2] ) );
+				squareLength = _mm_add_pd( squareLength, _mm_mul_pd( z, z ) );
+			}
+			__m128d length = _mm_sqrt_pd( squareLength );
+
+			__m128d weightSum = _mm_add_pd(
+				_mm_set_pd( input.stationary[ vertexA1 ] ? 0.0 : 1.0, input.stationary[ vertexA0 ] ? 0.0 : 1.0 ),
+				_mm_set_pd( input.stationary[ vertexB1 ] ? 0.0 : 1.0, input.stationary[ vertexB0 ] ? 0.0 : 1.0 ) );
+			__m128d active = _mm_and_pd( _mm_cmpneq_pd( weightSum, zero ), _mm_cmpge_pd( length, epsilon ) );
+
+			// Every lane reports its error, but inactive ones may divide by zero
+			// working out a correction; the mask clears whatever that produced,
+			// negative zeros included, to match the scalar variant.
+			__m128d restLength = _mm_set_pd( double( input.restLength[ edge1 ] ), double( input.restLength[ edge0 ] ) );
+			__m128d error = _mm_sub_pd( length, restLength );
+			__m128d scale = _mm_div_pd( error, _mm_mul_pd( length, _mm_max_pd( weightSum, one ) ) );
+
+			_mm_storeu_pd( &output.error[i], error );
+			_mm_storeu_pd( &output.correctionX[i], _mm_and_pd( _mm_mul_pd( x, scale ), active ) );
+			_mm_storeu_pd( &output.correctionY[i], _mm_and_pd( _mm_mul_pd( y, scale ), active ) );
+			if( Dimension == 3 )
+				_mm_storeu_pd( &output.correctionZ[i], _mm_and_pd( _mm_mul_pd( z, scale ), active ) );
+
+			int mask = _mm_movemask_pd( active );
+			output.active[i] = char( mask & 1 );
+			output.active[ i + 1 ] = char( ( mask >> 1 ) & 1 );
+		}
+
+		if( i < count )
+		{
+			EdgeKernel::Output< double > tail = { output.error + i, output.correctionX + i, output.correctionY + i, output.correctionZ + i, output.active + i };
+			ComputeScalar< double, Dimension >( input, edgeList, first + i, count - i, tail );
+		}
+	}
+
+	template< int Dimension >
+	EDGE_KERNEL_TARGET_AVX2 void ComputeAVX2( const EdgeKernel::Input< double >& input, const int* edgeList, int first, int count, EdgeKernel::Output< double >& output )
+	{
+		const __m256d zero = _mm256_setzero_pd();
+		const __m256d one = _mm256_set1_pd( 1.0 );
+		const __m256d epsilon = _mm256_set1_pd( input.epsilon );
+
+		int i = 0;
+		for( ; i + 4 <= count; i += 4 )
+		{
+			// Hardware gathers are slower than plain loads on many processors,
+			// so the endpoints are loaded individually and packed.
+			int edge[4], vertexA[4], vertexB[4];
+			for( int j = 0; j < 4; j++ )
+			{
+				edge[j] = edgeList ? edgeList[ first + i + j ] : first + i + j;
+				vertexA[j] = input.edgeVertex[ 2 * edge[j] ];
+				vertexB[j] = input.edgeVertex[ 2 * edge[j] + 1 ];
+			}
+
+			const double* a0 = &input.location[ Dimension * vertexA[0] ];
+			const double* a1 = &input.location[ Dimension * vertexA[1] ];
+			const double* a2 = &input.location[ Dimension * vertexA[2] ];
+			const double* a3 = &input.location[ Dimension * vertexA[3] ];
+			const double* b0 = &input.location[ Dimension * vertexB[0] ];
+			const double* b1 = &input.location[ Dimension * vertexB[1] ];
+			const double* b2 = &input.location[ Dimension * vertexB[2] ];
+			const double* b3 = &input.location[ Dimension * vertexB[3] ];
+
+			__m256d x = _mm256_sub_pd( _mm256_set_pd( b3[0], b2[0], b1[0], b0[0] ), _mm256_set_pd( a3[0], a2[0], a1[0], a0[0] ) );
+			__m256d y = _mm256_sub_pd( _mm256_set_pd( b3[1], b2[1], b1[1], b0[1] ), _mm256_set_pd( a3[1], a2[1], a1[1], a0[1] ) );
+			__m256d z = zero;
+			__m256d squareLength = _mm256_add_pd( _mm256_mul_pd( x, x ), _mm256_mul_pd( y, y ) );
+			if( Dimension == 3 )
+			{
+				z = _mm256_sub_pd( _mm256_set_pd( b3[2], b2[2], b1[2], b0[2] ), _mm256_set_pd( a3[2], a2[2], a1[2], a0[2] ) );
+				squareLength = _mm256_add_pd( squareLength, _mm256_mul_pd( z, z ) );
+			}
+			__m256d length = _mm256_sqrt_pd( squareLength );
+
+			__m256d weightSum = _mm256_add_pd(
+				_mm256_set_pd( input.stationary[ vertexA[3] ] ? 0.0 : 1.0, input.stationary[ vertexA[2] ] ? 0.0 : 1.0, input.stationary[ vertexA[1] ] ? 0.0 : 1.0, input.stationary[ vertexA[0] ] ? 0.0 : 1.0 ),
+				_mm256_set_pd( input.stationary[ vertexB[3] ] ? 0.0 : 1.0, input.stationary[ vertexB[2] ] ? 0.0 : 1.0, input.stationary[ vertexB[1] ] ? 0.0 : 1.0, input.stationary[ vertexB[0] ] ? 0.0 : 1.0 ) );
+			__m256d active = _mm256_and_pd( _mm256_cmp_pd( weightSum, zero, _CMP_NEQ_UQ ), _mm256_cmp_pd( length, epsilon, _CMP_GE_OQ ) );
+
+			__m256d restLength = _mm256_cvtps_pd( _mm_set_ps( input.restLength[ edge[3] ], input.restLength[ edge[2] ], input.restLength[ edge[1] ], input.restLength[ edge[0] ] ) );
+			__m256d error = _mm256_sub_pd( length, restLength );
+			__m256d scale = _mm256_div_pd( error, _mm256_mul_pd( length, _mm256_max_pd( weightSum, one ) ) );
+
+			_mm256_storeu_pd( &output.error[i], error );
+			_mm256_storeu_pd( &output.correctionX[i], _mm256_and_pd( _mm256_mul_pd( x, scale ), active ) );
+			_mm256_storeu_pd( &output.correctionY[i], _mm256_and_pd( _mm256_mul_pd( y, scale ), active ) );
+			if( Dimension == 3 )
+				_mm256_storeu_pd( &output.correctionZ[i], _mm256_and_pd( _mm256_mul_pd( z, scale ), active ) );
+
+			int mask = _mm256_movemask_pd( active );
+			for( int j = 0; j < 4; j++ )
+				output.active[ i + j ] = char( ( mask >> j ) & 1 );
+		}
+
+		if( i < count )
+		{
+			EdgeKernel::Output< double > tail = { output.error + i, output.correctionX + i, output.correctionY + i, output.correctionZ + i, output.active + i };
+			ComputeScalar< double, Dimension >( input, edgeList, first + i, count - i, tail );
+		}
+	}
+
+	template< int Dimension >
+	EDGE_KERNEL_TARGET_SSE2 void ComputeSSE2( const EdgeKernel::Input< float >& input, const int* edgeList, int first, int count, EdgeKernel::Output< float >& output )
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps( 1.f );
+		const __m128 epsilon = _mm_set1_ps( input.epsilon );
+
+		int i = 0;
+		for( ; i + 4 <= count; i += 4 )
+		{
+			int edge[4], vertexA[4], vertexB[4];
+			for( int j = 0; j < 4; j++ )
+			{
+				edge[j] = edgeList ? edgeList[ first + i + j ] : first + i + j;
+				vertexA[j] = input.edgeVertex[ 2 * edge[j] ];
+				vertexB[j] = input.edgeVertex[ 2 * edge[j] + 1 ];
+			}
+
+			const float* a0 = &input.location[ Dimension * vertexA[0] ];
+			const float* a1 = &input.location[ Dimension * vertexA[1] ];
+			const float* a2 = &input.location[ Dimension * vertexA[2] ];
+			const float* a3 = &input.location[ Dimension * vertexA[3] ];
+			const float* b0 = &input.location[ Dimension * vertexB[0] ];
+			const float* b1 = &input.location[ Dimension * vertexB[1] ];
+			const float* b2 = &input.location[ Dimension * vertexB[2] ];
+			const float* b3 = &input.location[ Dimension * vertexB[3] ];
+
+			__m128 x = _mm_sub_ps( _mm_set_ps( b3[0], b2[0], b1[0], b0[0] ), _mm_set_ps( a3[0], a2[0], a1[0], a0[0] ) );
+			__m128 y = _mm_sub_ps( _mm_set_ps( b3[1], b2[1], b1[1], b0[1] ), _mm_set_ps( a3[1], a2[1], a1[1], a0[1] ) );
+			__m128 z = zero;
+			__m128 squareLength = _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) );
+			if( Dimension == 3 )
+			{
+				z = _mm_sub_ps( _mm_set_ps( b3[2], b2[2], b1[2], b0[2] ), _mm_set_ps( a3[2], a2[2], a1[2], a0[2] ) );
+				squareLength = _mm_add_ps( squareLength, _mm_mul_ps( z, z ) );
+			}
+			__m128 length = _mm_sqrt_ps( squareLength );
+
+			__m128 weightSum = _mm_add_ps(
+				_mm_set_ps( input.stationary[ vertexA[3] ] ? 0.f : 1.f, input.stationary[ vertexA[2] ] ? 0.f : 1.f, input.stationary[ vertexA[1] ] ? 0.f : 1.f, input.stationary[ vertexA[0] ] ? 0.f : 1.f ),
+				_mm_set_ps( input.stationary[ vertexB[3] ] ? 0.f : 1.f, input.stationary[ vertexB[2] ] ? 0.f : 1.f, input.stationary[ vertexB[1] ] ? 0.f : 1.f, input.stationary[ vertexB[0] ] ? 0.f : 1.f ) );
+			__m128 active = _mm_and_ps( _mm_cmpneq_ps( weightSum, zero ), _mm_cmpge_ps( length, epsilon ) );
+
+			__m128 restLength = _mm_set_ps( input.restLength[ edge[3] ], input.restLength[ edge[2] ], input.restLength[ edge[1] ], input.restLength[ edge[0] ] );
+			__m128 error = _mm_sub_ps( length, restLength );
+			__m128 scale = _mm_div_ps( error, _mm_mul_ps( length, _mm_max_ps( weightSum, one ) ) );
+
+			_mm_storeu_ps( &output.error[i], error );
+			_mm_storeu_ps( &output.correctionX[i], _mm_and_ps( _mm_mul_ps( x, scale ), active ) );
+			_mm_storeu_ps( &output.correctionY[i], _mm_and_ps( _mm_mul_ps( y, scale ), active ) );
+			if( Dimension == 3 )
+				_mm_storeu_ps( &output.correctionZ[i], _mm_and_ps( _mm_mul_ps( z, scale ), active ) );
+
+			int mask = _mm_movemask_ps( active );
+			for( int j = 0; j < 4; j++ )
+				output.active[ i + j ] = char( ( mask >> j ) & 1 );
+		}
+
+		if( i < count )
+		{
+			EdgeKernel::Output< float > tail = { output.error + i, output.correctionX + i, output.correctionY + i, output.correctionZ + i, output.active + i };
+			ComputeScalar< float, Dimension >( input, edgeList, first + i, count - i, tail );
+		}
+	}
+
+	template< int Dimension >
+	EDGE_KERNEL_TARGET_AVX2 void ComputeAVX2( const EdgeKernel::Input< float >& input, const int* edgeList, int first, int count, EdgeKernel::Output< float >& output )
+	{
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps( 1.f );
+		const __m256 epsilon = _mm256_set1_ps( input.epsilon );
+
+		int i = 0;
+		for( ; i + 8 <= count; i += 8 )
+		{
+			// Lanes are packed from scalar loads rather than vector loads of these
+			// arrays, which would stall waiting on the scalar stores just made.
+			int edge[8];
+			const float* a[8];
+			const float* b[8];
+			float weightA[8], weightB[8], restLengthLane[8];
+			for( int j = 0; j < 8; j++ )
+			{
+				edge[j] = edgeList ? edgeList[ first + i + j ] : first + i + j;
+				int vertexA = input.edgeVertex[ 2 * edge[j] ];
+				int vertexB = input.edgeVertex[ 2 * edge[j] + 1 ];
+				a[j] = &input.location[ Dimension * vertexA ];
+				b[j] = &input.location[ Dimension * vertexB ];
+				weightA[j] = input.stationary[ vertexA ] ? 0.f : 1.f;
+				weightB[j] = input.stationary[ vertexB ] ? 0.f : 1.f;
+				restLengthLane[j] = input.restLength[ edge[j] ];
+			}
+
+			__m256 x = _mm256_sub_ps(
+				_mm256_set_ps( b[7][0], b[6][0], b[5][0], b[4][0], b[3][0], b[2][0], b[1][0], b[0][0] ),
+				_mm256_set_ps( a[7][0], a[6][0], a[5][0], a[4][0], a[3][0], a[2][0], a[1][0], a[0][0] ) );
+			__m256 y = _mm256_sub_ps(
+				_mm256_set_ps( b[7][1], b[6][1], b[5][1], b[4][1], b[3][1], b[2][1], b[1][1], b[0][1] ),
+				_mm256_set_ps( a[7][1], a[6][1], a[5][1], a[4][1], a[3][1], a[2][1], a[1][1], a[0][1] ) );
+			__m256 z = zero;
+			__m256 squareLength = _mm256_add_ps( _mm256_mul_ps( x, x ), _mm256_mul_ps( y, y ) );
+			if( Dimension == 3 )
+			{
+				z = _mm256_sub_ps(
+					_mm256_set_ps( b[7][2], b[6][2], b[5][2], b[4][2], b[3][2], b[2][2], b[1][2], b[0][2] ),
+					_mm256_set_ps( a[7][2], a[6][2], a[5][2], a[4][2], a[3][2], a[2][2], a[1][2], a[0][2] ) );
+				squareLength = _mm256_add_ps( squareLength, _mm256_mul_ps( z, z ) );
+			}
+			__m256 length = _mm256_sqrt_ps( squareLength );
+
+			__m256 weightSum = _mm256_add_ps(
+				_mm256_set_ps( weightA[7], weightA[6], weightA[5], weightA[4], weightA[3], weightA[2], weightA[1], weightA[0] ),
+				_mm256_set_ps( weightB[7], weightB[6], weightB[5], weightB[4], weightB[3], weightB[2], weightB[1], weightB[0] ) );
+			__m256 active = _mm256_and_ps( _mm256_cmp_ps( weightSum, zero, _CMP_NEQ_UQ ), _mm256_cmp_ps( length, epsilon, _CMP_GE_OQ ) );
+
+			__m256 restLength = _mm256_set_ps( restLengthLane[7], restLengthLane[6], restLengthLane[5], restLengthLane[4], restLengthLane[3], restLengthLane[2], restLengthLane[1], restLengthLane[0] );
+			__m256 error = _mm256_sub_ps( length, restLength );
+			__m256 scale = _mm256_div_ps( error, _mm256_mul_ps( length, _mm256_max_ps( weightSum, one ) ) );
+
+			_mm256_storeu_ps( &output.error[i], error );
+			_mm256_storeu_ps( &output.correctionX[i], _mm256_and_ps( _mm256_mul_ps( x, scale ), active ) );
+			_mm256_storeu_ps( &output.correctionY[i], _mm256_and_ps( _mm256_mul_ps( y, scale ), active ) );
+			if( Dimension == 3 )
+				_mm256_storeu_ps( &output.correctionZ[i], _mm256_and_ps( _mm256_mul_ps( z, scale ), active ) );
+
+			int mask = _mm256_movemask_ps( active );
+			for( int j = 0; j < 8; j++ )
+				output.active[ i + j ] = char( ( mask >> j ) & 1 );
+		}
+
+		if( i < count )
+		{
+			EdgeKernel::Output< float > tail = { output.error + i, output.correctionX + i, output.correctionY + i, output.correctionZ + i, output.active + i };
+			ComputeScalar< float, Dimension >( input, edgeList, first + i, count - i, tail );
+		}
+	}
+
+#else
+
+	template< int Dimension >
+	void ComputeSSE2( const EdgeKernel::Input< double >& input, const int* edgeList, int first, int count, EdgeKernel::Output< double >& output )
+	{
+		ComputeScalar< double, Dimension >( input, edgeList, first, count, output );
+	}
+
+	template< int Dimension >
+	void ComputeSSE2( const EdgeKernel::Input< float >& input, const int* edgeList, int first, int count, EdgeKernel::Output< float >& output )
+	{
+		ComputeScalar< float, Dimension >( input, edgeList, first, count, output );
+	}
+
+	template< int Dimension >
+	void ComputeAVX2( const EdgeKernel::Input< double >& input, const int* edgeList, int first, int count, EdgeKernel::Output< double >& output )
+	{
+		ComputeScalar< double, Dimension >( input, edgeList, first, count, output );
+	}
+
+	template< int Dimension >
+	void ComputeAVX2( const EdgeKernel::Input< float >& input, const int* edgeList, int first, int count, EdgeKernel::Output< float >& output )
+	{
+		ComputeScalar< float, Dimension >( input, edgeList, first, count, output );
+	}
+
+#endif
+}
+
+/*static*/ EdgeKernel::InstructionSet EdgeKernel::instructionSet = EdgeKernel::INSTRUCTION_SET_SCALAR;
+/*static*/ EdgeKernel::ComputeDoubleFunction EdgeKernel::computeDoubleFunction[2] = { ComputeScalar< double, 2 >, ComputeScalar< double, 3 > };
+/*static*/ EdgeKernel::ComputeFloatFunction EdgeKernel::computeFloatFunction[2] = { ComputeScalar< float, 2 >, ComputeScalar< float, 3 > };
+
+/*static*/ EdgeKernel::InstructionSet EdgeKernel::DetectInstructionSet( void )
+{
+#if defined( EDGE_KERNEL_X86 )
+	unsigned int registers[4];
+	CallCpuid( 0, 0, registers );
+	unsigned int maxLeaf = registers[0];
+	if( maxLeaf < 1 )
+		return INSTRUCTION_SET_SCALAR;
+
+	CallCpuid( 1, 0, registers );
+	bool sse2 = ( registers[3] & ( 1u << 26 ) ) != 0;
+	bool osxsave = ( registers[2] & ( 1u << 27 ) ) != 0;
+	bool avx = ( registers[2] & ( 1u << 28 ) ) != 0;
+	if( !sse2 )
+		return INSTRUCTION_SET_SCALAR;
+
+	// AVX2 also needs the operating system to save the YMM registers.
+	if( maxLeaf >= 7 && osxsave && avx && ( ReadExtendedControlRegister() & 6 ) == 6 )
+	{
+		CallCpuid( 7, 0, registers );
+		if( registers[1] & ( 1u << 5 ) )
+			return INSTRUCTION_SET_AVX2;
+	}
+
+	return INSTRUCTION_SET_SSE2;
+#else
+	return INSTRUCTION_SET_SCALAR;
+#endif
+}
+
+/*static*/ void EdgeKernel::SetInstructionSet( InstructionSet instructionSet )
+{
+	InstructionSet supported = DetectInstructionSet();
+	if( instructionSet > supported )
+		instructionSet = supported;
+
+	switch( instructionSet )
+	{
+		case INSTRUCTION_SET_AVX2:
+			computeDoubleFunction[0] = ComputeAVX2< 2 >;
+			computeDoubleFunction[1] = ComputeAVX2< 3 >;
+			computeFloatFunction[0] = ComputeAVX2< 2 >;
+			computeFloatFunction[1] = ComputeAVX2< 3 >;
+			break;
+		case INSTRUCTION_SET_SSE2:
+			computeDoubleFunction[0] = ComputeSSE2< 2 >;
+			computeDoubleFunction[1] = ComputeSSE2< 3 >;
+			computeFloatFunction[0] = ComputeSSE2< 2 >;
+			computeFloatFunction[1] = ComputeSSE2< 3 >;
+			break;
+		default:
+			computeDoubleFunction[0] = ComputeScalar< double, 2 >;
+			computeDoubleFunction[1] = ComputeScalar< double, 3 >;
+			computeFloatFunction[0] = ComputeScalar< float, 2 >;
+			computeFloatFunction[1] = ComputeScalar< float, 3 >;
+			break;
+	}
+
+	EdgeKernel::instructionSet = instructionSet;
+}
+
+/*static*/ void EdgeKernel::Compute( const Input< double >& input, const int* edgeList, int first, int count, Output< double >& output )
+{
+	computeDoubleFunction[ input.dimension - 2 ]( input, edgeList, first, count, output );
+}
+
+/*static*/ void EdgeKernel::Compute( const Input< float >& input, const int* edgeList, int first, int count, Output< float >& output )
+{
+	computeFloatFunction[ input.dimension - 2 ]( input, edgeList, first, count, output );
+}
+
+// EdgeKernel.cpp
@@ -0,0 +1,81 @@
+// EdgeKernel.h
+
+#pragma once
+
+// Computes the length errors and correction vectors of a batch of edges.
+// Vertex locations are read as packed xy pairs or xyz triples, one per
+// vertex slot, in either single or double precision.  The SIMD variants work on
+// 2 (SSE2) or 4 (AVX2) edges at once in double precision, and on 4 or 8
+// edges at once in single precision; the best one the processor supports
+// is picked at start-up by CPUID.  All variants perform the same IEEE
+// operations in the same order (no fused multiply-add), so they produce
+// bit-identical results; the source turns off the compiler's contraction
+// of multiplies and adds so that this holds under any flags short of fast
+// math.
+class EdgeKernel
+{
+public:
+
+	enum InstructionSet
+	{
+		INSTRUCTION_SET_SCALAR,
+		INSTRUCTION_SET_SSE2,
+		INSTRUCTION_SET_AVX2,
+	};
+
+	template< typename Real >
+	struct Input
+	{
+		const Real* location;			// xy or xyz of each vertex slot.
+		const char* stationary;			// Stationary flag of each vertex slot.
+		const int* edgeVertex;			// Two vertex slots per edge slot.
+		const float* restLength;		// Rest length of each edge slot.
+		Real epsilon;					// Edges shorter than this get no correction.
+		int dimension;					// 2 or 3.
+	};
+
+	// Entry i describes the i-th edge of the batch.  The correction is to be
+	// added to the first vertex and subtracted from the second, each scaled
+	// by that vertex's weight (zero if stationary, otherwise one).  Inactive
+	// edges (both ends stationary, or degenerate) have zero correction, but
+	// their error is reported all the same.
+	// In 2D the z corrections are left unwritten.
+	template< typename Real >
+	struct Output
+	{
+		Real* error;
+		Real* correctionX;
+		Real* correctionY;
+		Real* correctionZ;
+		char* active;
+	};
+
+	// Callers typically stage batches of this many edges on the stack.
+	enum { BATCH_SIZE = 256 };
+
+	// Process edge slots edgeList[first] through edgeList[first+count-1],
+	// or first through first+count-1 if the edge list is null.
+	static void Compute( const Input< double >& input, const int* edgeList, int first, int count, Output< double >& output );
+	static void Compute( const Input< float >& input, const int* edgeList, int first, int count, Output< float >& output );
+
+	static InstructionSet DetectInstructionSet( void );
+	static InstructionSet GetInstructionSet( void ) { return instructionSet; }
+
+	// Force a particular variant, e.g. for benchmarking.  Requests for an
+	// unsupported instruction set fall back to the best supported one.
+	// This must not be called while a solve is running.
+	static void SetInstructionSet( InstructionSet instructionSet );
+
+private:
+
+	typedef void ( *ComputeDoubleFunction )( const Input< double >& input, const int* edgeList, int first, int count, Output< double >& output );
+	typedef void ( *ComputeFloatFunction )( const Input< float >& input, const int* edgeList, int first, int count, Output< float >& output );
+
+	static InstructionSet instructionSet;
+
+	// The variants in use, indexed by dimension minus two.
+	static ComputeDoubleFunction computeDoubleFunction[2];
+	static ComputeFloatFunction computeFloatFunction[2];
+};
+
+// EdgeKernel.h
@@ -0,0 +1,352 @@
+// GraphFile.cpp
+
+#include "GraphFile.h"
+#include "KinematicGraph.h"
+#include "SolveRecorder.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <algorithm>
+
+#if defined( _WIN32 )
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+namespace
+{
+	const char graphFileMagic[8] = { 'K', 'G', 'R', 'A', 'P', 'H', '\r', '\n' };
+
+	// The position is tracked here rather than asked of the file, since
+	// ftell cannot report offsets past 2GB everywhere.
+	bool WriteBytes( FILE* file, unsigned long long& position, const void* buffer, size_t count )
+	{
+		if( count > 0 && fwrite( buffer, 1, count, file ) != count )
+			return false;
+		position += count;
+		return true;
+	}
+
+	bool WritePadding( FILE* file, unsigned long long& position, unsigned long long offset )
+	{
+		static const char zeroArray[ GraphFile::SECTION_ALIGNMENT ] = { 0 };
+		if( position > offset || offset - position > sizeof( zeroArray ) )
+			return false;
+		return WriteBytes( file, position, zeroArray, size_t( offset - position ) );
+	}
+}
+
+GraphFile::GraphFile( void )
+{
+	header = nullptr;
+	data = nullptr;
+	size = 0;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+}
+
+GraphFile::~GraphFile( void )
+{
+	Close();
+}
+
+/*static*/ bool GraphFile::IsLittleEndian( void )
+{
+	unsigned int one = 1;
+	return *reinterpret_cast< const unsigned char* >( &one ) == 1;
+}
+
+/*static*/ unsigned long long GraphFile::AlignOffset( unsigned long long offset )
+{
+	return ( offset + SECTION_ALIGNMENT - 1 ) & ~( unsigned long long )( SECTION_ALIGNMENT - 1 );
+}
+
+/*static*/ void GraphFile::MakeHeader( Header& header, unsigned int vertexCount, unsigned int edgeCount )
+{
+	memset( &header, 0, sizeof( Header ) );
+	memcpy( header.magic, graphFileMagic, sizeof( header.magic ) );
+	header.version = VERSION;
+	header.headerSize = sizeof( Header );
+	header.vertexCount = vertexCount;
+	header.edgeCount = edgeCount;
+	header.selectionType = SELECTION_NONE;
+	header.selectionIndex = -1;
+	header.locationOffset = AlignOffset( sizeof( Header ) );
+	header.stationOffset = AlignOffset( header.locationOffset + 3ULL * sizeof( double ) * vertexCount );
+	header.stationaryOffset = AlignOffset( header.stationOffset + 3ULL * sizeof( double ) * vertexCount );
+	header.edgeVertexOffset = AlignOffset( header.stationaryOffset + vertexCount );
+	header.edgeLengthOffset = AlignOffset( header.edgeVertexOffset + 2ULL * sizeof( unsigned int ) * edgeCount );
+	header.fileSize = header.edgeLengthOffset + sizeof( float ) * ( unsigned long long )edgeCount;
+}
+
+// The section offsets are derived from the counts, so a header whose
+// offsets disagree with its counts is rejected along with a truncated file.
+/*static*/ bool GraphFile::CheckHeader( const Header& header, unsigned long long size )
+{
+	if( memcmp( header.magic, graphFileMagic, sizeof( header.magic ) ) != 0 )
+		return false;
+
+	if( header.version != VERSION || header.headerSize != sizeof( Header ) )
+		return false;
+
+	if( header.vertexCount > INT_MAX || header.edgeCount > INT_MAX )
+		return false;
+
+	Header expectedHeader;
+	MakeHeader( expectedHeader, header.vertexCount, header.edgeCount );
+	if( header.locationOffset != expectedHeader.locationOffset ||
+		header.stationOffset != expectedHeader.stationOffset ||
+		header.stationaryOffset != expectedHeader.stationaryOffset ||
+		header.edgeVertexOffset != expectedHeader.edgeVertexOffset ||
+		header.edgeLengthOffset != expectedHeader.edgeLengthOffset ||
+		header.fileSize != expectedHeader.fileSize ||
+		header.fileSize > size )
+	{
+		return false;
+	}
+
+	switch( header.selectionType )
+	{
+		case SELECTION_NONE:
+			return true;
+		case SELECTION_EDGE:
+			return header.selectionIndex >= 0 && ( unsigned int )header.selectionIndex < header.edgeCount;
+		case SELECTION_VERTEX:
+			return header.selectionIndex >= 0 && ( unsigned int )header.selectionIndex < header.vertexCount;
+	}
+
+	return false;
+}
+
+/*static*/ bool GraphFile::Write( const KinematicGraph& kinematicGraph, const char* path )
+{
+	if( !IsLittleEndian() )
+		return false;
+
+	int vertexCount = ( int )kinematicGraph.vertexIdArray.size();
+	int edgeCount = ( int )kinematicGraph.edgeIdArray.size();
+
+	Header header;
+	MakeHeader( header, vertexCount, edgeCount );
+
+	const KinematicGraph::Handle* handle = kinematicGraph.handleTable.Find( kinematicGraph.selectedId );
+	if( handle )
+	{
+		header.selectionType = ( handle->type == KinematicGraph::TYPE_VERTEX ) ? SELECTION_VERTEX : SELECTION_EDGE;
+		header.selectionIndex = handle->slot;
+	}
+
+	FILE* file = fopen( path, "wb" );
+	if( !file )
+		return false;
+
+	unsigned long long position = 0;
+	bool success = WriteBytes( file, position, &header, sizeof( Header ) );
+
+	// The vertex sections are converted to double triples a block at a time.
+	enum { BLOCK_SIZE = 1024 };
+	double tripleArray[ 3 * BLOCK_SIZE ];
+	const std::vector< KinematicGraph::Vector >* vectorArray[2] = { &kinematicGraph.vertexLocationArray, &kinematicGraph.vertexStationArray };
+	unsigned long long vectorOffset[2] = { header.locationOffset, header.stationOffset };
+	for( int i = 0; i < 2 && success; i++ )
+	{
+		success = WritePadding( file, position, vectorOffset[i] );
+		for( int first = 0; first < vertexCount && success; first += BLOCK_SIZE )
+		{
+			int count = std::min( int( BLOCK_SIZE ), vertexCount - first );
+			for( int j = 0; j < count; j++ )
+			{
+				const KinematicGraph::Vector& vector = ( *vectorArray[i] )[ first + j ];
+				tripleArray[ 3 * j ] = vector.get_e1();
+				tripleArray[ 3 * j + 1 ] = vector.get_e2();
+				tripleArray[ 3 * j + 2 ] = vector.get_e3();
+			}
+			success = WriteBytes( file, position, tripleArray, 3 * sizeof( double ) * count );
+		}
+	}
+
+	const char* stationary = vertexCount > 0 ? &kinematicGraph.vertexStationaryArray[0] : nullptr;
+	const int* edgeVertex = edgeCount > 0 ? &kinematicGraph.edgeVertexArray[0] : nullptr;
+	const float* edgeLength = edgeCount > 0 ? &kinematicGraph.edgeLengthArray[0] : nullptr;
+
+	success = success && WritePadding( file, position, header.stationaryOffset ) && WriteBytes( file, position, stationary, vertexCount );
+	success = success && WritePadding( file, position, header.edgeVertexOffset ) && WriteBytes( file, position, edgeVertex, 2 * sizeof( int ) * edgeCount );
+	success = success && WritePadding( file, position, header.edgeLengthOffset ) && WriteBytes( file, position, edgeLength, sizeof( float ) * edgeCount );
+	success = success && position == header.fileSize;
+
+	if( fclose( file ) != 0 )
+		success = false;
+
+	if( !success )
+		remove( path );
+
+	return success;
+}
+
+bool GraphFile::Open( const char* path )
+{
+	Close();
+
+	if( !IsLittleEndian() )
+		return false;
+
+#if defined( _WIN32 )
+	HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if( !GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart < ( LONGLONG )sizeof( Header ) || ( unsigned long long )fileSize.QuadPart > SIZE_MAX )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+	if( !mapping )
+	{
+		CloseHandle( file );
+		return false;
+	}
+
+	const void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+	if( !view )
+	{
+		CloseHandle( mapping );
+		CloseHandle( file );
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	size = size_t( fileSize.QuadPart );
+#else
+	int file = open( path, O_RDONLY );
+	if( file < 0 )
+		return false;
+
+	struct stat fileStat;
+	if( fstat( file, &fileStat ) != 0 || fileStat.st_size < ( off_t )sizeof( Header ) )
+	{
+		close( file );
+		return false;
+	}
+
+	// The mapping holds its own reference to the file.
+	void* view = mmap( nullptr, size_t( fileStat.st_size ), PROT_READ, MAP_SHARED, file, 0 );
+	close( file );
+	if( view == MAP_FAILED )
+		return false;
+
+	size = size_t( fileStat.st_size );
+#endif
+
+	data = static_cast< const char* >( view );
+	if( !CheckHeader( *reinterpret_cast< const Header* >( data ), size ) )
+	{
+		Close();
+		return false;
+	}
+
+	header = reinterpret_cast< const Header* >( data );
+	return true;
+}
+
+void GraphFile::Close( void )
+{
+	if( data )
+	{
+#if defined( _WIN32 )
+		UnmapViewOfFile( data );
+		CloseHandle( mappingHandle );
+		CloseHandle( fileHandle );
+#else
+		munmap( const_cast< char* >( data ), size );
+#endif
+	}
+
+	header = nullptr;
+	data = nullptr;
+	size = 0;
+	fileHandle = nullptr;
+	mappingHandle = nullptr;
+}
+
+// A recorder attached to the graph keyframes the loaded graph instead of
+// recording the calls that build it, which are not the whole story.
+bool GraphFile::Load( KinematicGraph& kinematicGraph ) const
+{
+	SolveRecorder* recorder = kinematicGraph.recorder;
+	kinematicGraph.recorder = nullptr;
+
+	bool loaded = LoadContents( kinematicGraph );
+
+	kinematicGraph.recorder = recorder;
+	if( recorder )
+		recorder->RecordKeyframe( kinematicGraph );
+
+	return loaded;
+}
+
+bool GraphFile::LoadContents( KinematicGraph& kinematicGraph ) const
+{
+	kinematicGraph.Clear();
+	kinematicGraph.SetSelectedId(0);
+
+	if( !header )
+		return false;
+
+	int vertexCount = GetVertexCount();
+	int edgeCount = GetEdgeCount();
+
+	const double* location = GetLocations();
+	std::vector< c3ga::vectorE3GA > locationArray( vertexCount );
+	for( int i = 0; i < vertexCount; i++ )
+		locationArray[i].set( c3ga::vectorE3GA::coord_e1_e2_e3, location[ 3 * i ], location[ 3 * i + 1 ], location[ 3 * i + 2 ] );
+
+	const unsigned int* edgeVertex = GetEdgeVertices();
+	std::vector< int > edgeArray( 2 * edgeCount );
+	for( int i = 0; i < 2 * edgeCount; i++ )
+	{
+		if( edgeVertex[i] >= ( unsigned int )vertexCount )
+			return false;
+		edgeArray[i] = int( edgeVertex[i] );
+	}
+
+	// The graph was empty, so the vertex and edge slots come out as they
+	// were saved unless an edge was dropped.
+	std::vector< int > idArray;
+	if( kinematicGraph.InsertGraph( locationArray, edgeArray, idArray ) != edgeCount )
+	{
+		kinematicGraph.Clear();
+		return false;
+	}
+
+	const double* station = GetStations();
+	const char* stationary = GetStationaryFlags();
+	for( int i = 0; i < vertexCount; i++ )
+	{
+		kinematicGraph.vertexStationArray[i] = KinematicGraph::Vector( KinematicGraph::Real( station[ 3 * i ] ), KinematicGraph::Real( station[ 3 * i + 1 ] ), KinematicGraph::Real( station[ 3 * i + 2 ] ) );
+		kinematicGraph.vertexStationaryArray[i] = stationary[i] ? 1 : 0;
+	}
+
+	const float* edgeLength = GetEdgeLengths();
+	for( int i = 0; i < edgeCount; i++ )
+		kinematicGraph.edgeLengthArray[i] = edgeLength[i];
+
+	if( header->selectionType == SELECTION_VERTEX )
+		kinematicGraph.SetSelectedId( idArray[ header->selectionIndex ] );
+	else if( header->selectionType == SELECTION_EDGE )
+		kinematicGraph.SetSelectedId( kinematicGraph.edgeIdArray[ header->selectionIndex ] );
+
+	return true;
+}
+
+// GraphFile.cpp
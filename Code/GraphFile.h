@@ -0,0 +1,97 @@
+// GraphFile.h
+
+#pragma once
+
+#include <stddef.h>
+
+class KinematicGraph;
+
+// A kinematic graph saved in a versioned, little-endian binary format that
+// is laid out to be used in place: the file is a header followed by one
+// aligned array per section, so opening it only maps it read-only and
+// checks the header, however large the rig.  The mapping is shared with
+// any other process that opens the same file.  The arrays are indexed by
+// the vertex and edge slots the graph had when it was saved; ids are not
+// stored, so a graph loaded from the file hands out fresh ones.
+//
+// Writing and mapping both refuse to run on a big-endian host.
+class GraphFile
+{
+public:
+
+	enum
+	{
+		VERSION = 1,
+		SECTION_ALIGNMENT = 64,
+	};
+
+	enum SelectionType
+	{
+		SELECTION_NONE = -1,
+		SELECTION_EDGE,
+		SELECTION_VERTEX,
+	};
+
+	struct Header
+	{
+		char magic[8];							// "KGRAPH" followed by "\r\n".
+		unsigned int version;
+		unsigned int headerSize;
+		unsigned int vertexCount;
+		unsigned int edgeCount;
+		int selectionType;						// A SelectionType.
+		int selectionIndex;						// The selected vertex or edge slot.
+		unsigned long long locationOffset;		// vertexCount xyz triples of doubles.
+		unsigned long long stationOffset;		// vertexCount xyz triples of doubles.
+		unsigned long long stationaryOffset;	// vertexCount bytes, zero or one.
+		unsigned long long edgeVertexOffset;	// edgeCount pairs of unsigned int vertex slots.
+		unsigned long long edgeLengthOffset;	// edgeCount floats.
+		unsigned long long fileSize;
+	};
+
+	GraphFile( void );
+	~GraphFile( void );
+
+	static bool Write( const KinematicGraph& kinematicGraph, const char* path );
+
+	bool Open( const char* path );
+	void Close( void );
+	bool IsOpen( void ) const { return header != nullptr; }
+
+	// Replace the contents of the graph with those of the open file.  This
+	// fails, leaving the graph empty, if an edge refers to a vertex out of
+	// range or repeats another edge.
+	bool Load( KinematicGraph& kinematicGraph ) const;
+
+	// These read straight from the mapping, which stays valid until the
+	// file is closed.
+	const Header* GetHeader( void ) const { return header; }
+	int GetVertexCount( void ) const { return int( header->vertexCount ); }
+	int GetEdgeCount( void ) const { return int( header->edgeCount ); }
+	const double* GetLocations( void ) const { return reinterpret_cast< const double* >( data + header->locationOffset ); }
+	const double* GetStations( void ) const { return reinterpret_cast< const double* >( data + header->stationOffset ); }
+	const char* GetStationaryFlags( void ) const { return data + header->stationaryOffset; }
+	const unsigned int* GetEdgeVertices( void ) const { return reinterpret_cast< const unsigned int* >( data + header->edgeVertexOffset ); }
+	const float* GetEdgeLengths( void ) const { return reinterpret_cast< const float* >( data + header->edgeLengthOffset ); }
+
+private:
+
+	GraphFile( const GraphFile& );
+	GraphFile& operator=( const GraphFile& );
+
+	static bool IsLittleEndian( void );
+	static unsigned long long AlignOffset( unsigned long long offset );
+	static void MakeHeader( Header& header, unsigned int vertexCount, unsigned int edgeCount );
+	static bool CheckHeader( const Header& header, unsigned long long size );
+	bool LoadContents( KinematicGraph& kinematicGraph ) const;
+
+	const Header* header;
+	const char* data;
+	size_t size;
+
+	// Platform handles of the mapping (unused on POSIX).
+	void* fileHandle;
+	void* mappingHandle;
+};
+
+// GraphFile.h
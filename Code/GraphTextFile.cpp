@@ -0,0 +1,521 @@
+// GraphTextFile.cpp
+
+#include "GraphTextFile.h"
+#include "KinematicGraph.h"
+#include "SolveRecorder.h"
+#include "DecimalText.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unordered_map>
+
+namespace
+{
+	const char formatName[] = "kinematic-graph";
+
+	bool IsDigit( char c )
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	bool IsSpace( char c )
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	const char* SkipSpace( const char* cursor )
+	{
+		while( IsSpace( *cursor ) )
+			cursor++;
+		return cursor;
+	}
+
+	// Every number must be followed by white space or the end of the line.
+	bool EndOfToken( const char* cursor )
+	{
+		return *cursor == '\0' || IsSpace( *cursor );
+	}
+
+	bool ParseInt( const char*& cursor, int& value )
+	{
+		const char* c = SkipSpace( cursor );
+		bool negative = ( *c == '-' );
+		if( *c == '-' || *c == '+' )
+			c++;
+
+		if( !IsDigit( *c ) )
+			return false;
+
+		long long magnitude = 0;
+		while( IsDigit( *c ) )
+		{
+			magnitude = magnitude * 10 + ( *c++ - '0' );
+			if( magnitude > ( long long )INT_MAX + 1 )
+				return false;
+		}
+
+		if( !EndOfToken( c ) || ( !negative && magnitude > INT_MAX ) )
+			return false;
+
+		value = int( negative ? -magnitude : magnitude );
+		cursor = c;
+		return true;
+	}
+
+	bool ParseFiniteReal( const char*& cursor, double& value )
+	{
+		const char* c = SkipSpace( cursor );
+		if( !DecimalText::Parse( c, value ) || !EndOfToken( c ) || value - value != 0.0 )
+			return false;
+
+		cursor = c;
+		return true;
+	}
+
+	int FormatInt( char* text, int value )
+	{
+		char digitArray[16];
+		int digitCount = 0;
+		unsigned int magnitude = ( value < 0 ) ? 0u - ( unsigned int )value : ( unsigned int )value;
+		do
+		{
+			digitArray[ digitCount++ ] = char( '0' + magnitude % 10 );
+			magnitude /= 10;
+		}
+		while( magnitude != 0 );
+
+		int length = 0;
+		if( value < 0 )
+			text[ length++ ] = '-';
+		while( digitCount > 0 )
+			text[ length++ ] = digitArray[ --digitCount ];
+		return length;
+	}
+
+	// Maps the vertex ids of a file to the order in which the vertices were
+	// given.  Written files number their vertices 0, 1, 2 and so on, which
+	// needs no lookup at all; any other numbering moves to a hash map.
+	class VertexIndexMap
+	{
+	public:
+
+		VertexIndexMap( void ) : count(0), sequential( true ) {}
+
+		// Returns false if the id was given before.
+		bool Insert( int id )
+		{
+			if( sequential && id == count )
+			{
+				count++;
+				return true;
+			}
+
+			if( sequential )
+			{
+				sequential = false;
+				for( int i = 0; i < count; i++ )
+					indexMap.insert( std::pair< int, int >( i, i ) );
+			}
+
+			if( !indexMap.insert( std::pair< int, int >( id, count ) ).second )
+				return false;
+
+			count++;
+			return true;
+		}
+
+		// Returns -1 if the id was not given.
+		int Find( int id ) const
+		{
+			if( sequential )
+				return ( id >= 0 && id < count ) ? id : -1;
+
+			std::unordered_map< int, int >::const_iterator iter = indexMap.find( id );
+			return ( iter != indexMap.end() ) ? iter->second : -1;
+		}
+
+	private:
+
+		int count;
+		bool sequential;
+		std::unordered_map< int, int > indexMap;
+	};
+
+	// Collects whole lines in a fixed buffer and hands it to the file
+	// whenever there might not be room for another line.
+	class LineWriter
+	{
+	public:
+
+		enum
+		{
+			BUFFER_SIZE = 64 * 1024,
+			MAX_LINE_LENGTH = 512,
+		};
+
+		LineWriter( FILE* file ) : file( file ), count(0), failed( false ) {}
+
+		void PutText( const char* text )
+		{
+			size_t length = strlen( text );
+			memcpy( bufferArray + count, text, length );
+			count += int( length );
+		}
+
+		void PutInt( int value )
+		{
+			bufferArray[ count++ ] = ' ';
+			count += FormatInt( bufferArray + count, value );
+		}
+
+		template< typename Real >
+		void PutReal( Real value )
+		{
+			bufferArray[ count++ ] = ' ';
+			count += DecimalText::Format( bufferArray + count, value );
+		}
+
+		void EndLine( void )
+		{
+			bufferArray[ count++ ] = '\n';
+			if( count > BUFFER_SIZE - MAX_LINE_LENGTH )
+				Flush();
+		}
+
+		bool Flush( void )
+		{
+			if( count > 0 && fwrite( bufferArray, 1, count, file ) != size_t( count ) )
+				failed = true;
+			count = 0;
+			return !failed;
+		}
+
+	private:
+
+		FILE* file;
+		char bufferArray[ BUFFER_SIZE ];
+		int count;
+		bool failed;
+	};
+
+	// Reads the file a buffer at a time and hands out one null-terminated
+	// line at a time, without its line break.  The rest of a line cut off at
+	// the end of the buffer is moved to the front before the next read.
+	class LineReader
+	{
+	public:
+
+		enum { BUFFER_SIZE = 64 * 1024 };
+
+		LineReader( FILE* file ) : file( file ), bufferArray( BUFFER_SIZE + 1 ), start(0), end(0), endOfFile( false ), failed( false ), lineNumber(0) {}
+
+		// Returns null at the end of the file, or on an error if failed is set.
+		char* NextLine( void )
+		{
+			while( true )
+			{
+				char* line = &bufferArray[ start ];
+				char* lineBreak = static_cast< char* >( memchr( line, '\n', end - start ) );
+				if( lineBreak || ( endOfFile && start < end ) )
+				{
+					char* lineEnd = lineBreak ? lineBreak : &bufferArray[ end ];
+					*lineEnd = '\0';
+					start = int( lineEnd - &bufferArray[0] ) + ( lineBreak ? 1 : 0 );
+					lineNumber++;
+					return line;
+				}
+
+				if( endOfFile )
+					return nullptr;
+
+				// A line longer than the buffer is refused rather than grown.
+				if( start == 0 && end == BUFFER_SIZE )
+				{
+					lineNumber++;
+					failed = true;
+					return nullptr;
+				}
+
+				memmove( &bufferArray[0], &bufferArray[ start ], end - start );
+				end -= start;
+				start = 0;
+
+				size_t readCount = fread( &bufferArray[ end ], 1, BUFFER_SIZE - end, file );
+				end += int( readCount );
+				if( readCount == 0 )
+				{
+					endOfFile = true;
+					if( ferror( file ) )
+					{
+						lineNumber = 0;
+						failed = true;
+						return nullptr;
+					}
+				}
+			}
+		}
+
+		bool Failed( void ) const { return failed; }
+		int GetLineNumber( void ) const { return lineNumber; }
+
+	private:
+
+		FILE* file;
+		std::vector< char > bufferArray;	// One spare byte for the terminator of a last line without a break.
+		int start;
+		int end;
+		bool endOfFile;
+		bool failed;
+		int lineNumber;
+	};
+}
+
+// Vertices are named by their slot, which reading preserves, so writing
+// a graph that was read back gives the same text.
+/*static*/ bool GraphTextFile::Write( const KinematicGraph& kinematicGraph, const char* path )
+{
+	FILE* file = fopen( path, "wb" );
+	if( !file )
+		return false;
+
+	LineWriter lineWriter( file );
+
+	lineWriter.PutText( formatName );
+	lineWriter.PutInt( VERSION );
+	lineWriter.EndLine();
+
+	for( int i = 0; i < ( int )kinematicGraph.vertexIdArray.size(); i++ )
+	{
+		const KinematicGraph::Vector& location = kinematicGraph.vertexLocationArray[i];
+		const KinematicGraph::Vector& station = kinematicGraph.vertexStationArray[i];
+		bool stationary = kinematicGraph.vertexStationaryArray[i] ? true : false;
+
+		lineWriter.PutText( "v" );
+		lineWriter.PutInt(i);
+		lineWriter.PutReal( location.get_e1() );
+		lineWriter.PutReal( location.get_e2() );
+		lineWriter.PutReal( location.get_e3() );
+		lineWriter.PutInt( stationary ? 1 : 0 );
+		if( stationary && ( station.get_e1() != location.get_e1() || station.get_e2() != location.get_e2() || station.get_e3() != location.get_e3() ) )
+		{
+			lineWriter.PutReal( station.get_e1() );
+			lineWriter.PutReal( station.get_e2() );
+			lineWriter.PutReal( station.get_e3() );
+		}
+		lineWriter.EndLine();
+	}
+
+	for( int i = 0; i < ( int )kinematicGraph.edgeIdArray.size(); i++ )
+	{
+		lineWriter.PutText( "e" );
+		lineWriter.PutInt( kinematicGraph.edgeVertexArray[ 2 * i ] );
+		lineWriter.PutInt( kinematicGraph.edgeVertexArray[ 2 * i + 1 ] );
+		lineWriter.PutReal( kinematicGraph.edgeLengthArray[i] );
+		lineWriter.EndLine();
+	}
+
+	const KinematicGraph::Handle* handle = kinematicGraph.handleTable.Find( kinematicGraph.selectedId );
+	if( handle )
+	{
+		lineWriter.PutText( "s" );
+		int slot = handle->slot;
+		if( handle->type == KinematicGraph::TYPE_VERTEX )
+			lineWriter.PutInt( slot );
+		else
+		{
+			lineWriter.PutInt( kinematicGraph.edgeVertexArray[ 2 * slot ] );
+			lineWriter.PutInt( kinematicGraph.edgeVertexArray[ 2 * slot + 1 ] );
+		}
+		lineWriter.EndLine();
+	}
+
+	bool success = lineWriter.Flush();
+
+	if( fclose( file ) != 0 )
+		success = false;
+
+	if( !success )
+		remove( path );
+
+	return success;
+}
+
+// As with the binary format, a recorder keyframes the graph read.
+/*static*/ bool GraphTextFile::Read( KinematicGraph& kinematicGraph, const char* path, int& errorLine )
+{
+	SolveRecorder* recorder = kinematicGraph.recorder;
+	kinematicGraph.recorder = nullptr;
+
+	bool read = ReadContents( kinematicGraph, path, errorLine );
+
+	kinematicGraph.recorder = recorder;
+	if( recorder )
+		recorder->RecordKeyframe( kinematicGraph );
+
+	return read;
+}
+
+/*static*/ bool GraphTextFile::ReadContents( KinematicGraph& kinematicGraph, const char* path, int& errorLine )
+{
+	kinematicGraph.Clear();
+	kinematicGraph.SetSelectedId(0);
+	errorLine = 0;
+
+	FILE* file = fopen( path, "rb" );
+	if( !file )
+		return false;
+
+	LineReader lineReader( file );
+
+	std::vector< c3ga::vectorE3GA > locationArray;
+	std::vector< c3ga::vectorE3GA > stationArray;
+	std::vector< char > stationaryArray;
+	std::vector< int > edgeArray;
+	std::vector< float > lengthArray;		// Negative where the length is to be measured.
+	VertexIndexMap vertexIndexMap;
+	int selectionArray[2] = { -1, -1 };
+	int selectionLine = 0;
+	bool success = true;
+
+	while( success )
+	{
+		const char* cursor = lineReader.NextLine();
+		if( !cursor )
+		{
+			success = !lineReader.Failed() && lineReader.GetLineNumber() > 0;
+			break;
+		}
+
+		cursor = SkipSpace( cursor );
+
+		if( lineReader.GetLineNumber() == 1 )
+		{
+			int version = 0;
+			success = strncmp( cursor, formatName, sizeof( formatName ) - 1 ) == 0 && IsSpace( cursor[ sizeof( formatName ) - 1 ] );
+			if( success )
+			{
+				cursor += sizeof( formatName ) - 1;
+				success = ParseInt( cursor, version ) && version == VERSION;
+			}
+		}
+		else if( *cursor == 'v' && IsSpace( cursor[1] ) )
+		{
+			cursor++;
+			int id = 0, stationary = 0;
+			double location[3], station[3];
+			success = ParseInt( cursor, id ) &&
+				ParseFiniteReal( cursor, location[0] ) && ParseFiniteReal( cursor, location[1] ) && ParseFiniteReal( cursor, location[2] ) &&
+				ParseInt( cursor, stationary ) && ( stationary == 0 || stationary == 1 );
+
+			if( success && *SkipSpace( cursor ) != '\0' )
+				success = ParseFiniteReal( cursor, station[0] ) && ParseFiniteReal( cursor, station[1] ) && ParseFiniteReal( cursor, station[2] );
+			else
+				memcpy( station, location, sizeof( station ) );
+
+			if( success )
+				success = vertexIndexMap.Insert( id );
+
+			if( success )
+			{
+				locationArray.push_back( c3ga::vectorE3GA( c3ga::vectorE3GA::coord_e1_e2_e3, location[0], location[1], location[2] ) );
+				stationArray.push_back( c3ga::vectorE3GA( c3ga::vectorE3GA::coord_e1_e2_e3, station[0], station[1], station[2] ) );
+				stationaryArray.push_back( char( stationary ) );
+			}
+		}
+		else if( *cursor == 'e' && IsSpace( cursor[1] ) )
+		{
+			cursor++;
+			int idA = 0, idB = 0;
+			double length = -1.0;
+			success = ParseInt( cursor, idA ) && ParseInt( cursor, idB ) && idA != idB;
+			if( success && *SkipSpace( cursor ) != '\0' )
+				success = ParseFiniteReal( cursor, length ) && length >= 0.0;
+
+			int indexA = vertexIndexMap.Find( idA );
+			int indexB = vertexIndexMap.Find( idB );
+			success = success && indexA >= 0 && indexB >= 0;
+
+			if( success )
+			{
+				edgeArray.push_back( indexA );
+				edgeArray.push_back( indexB );
+				lengthArray.push_back( float( length ) );
+			}
+		}
+		else if( *cursor == 's' && IsSpace( cursor[1] ) )
+		{
+			cursor++;
+			int idArray[2] = { 0, 0 };
+			int idCount = 0;
+			while( success && idCount < 2 && *SkipSpace( cursor ) != '\0' )
+				success = ParseInt( cursor, idArray[ idCount++ ] );
+			success = success && idCount > 0;
+
+			for( int i = 0; i < idCount && success; i++ )
+			{
+				selectionArray[i] = vertexIndexMap.Find( idArray[i] );
+				success = selectionArray[i] >= 0;
+			}
+
+			if( success && idCount == 1 )
+				selectionArray[1] = -1;
+			selectionLine = lineReader.GetLineNumber();
+		}
+		else
+		{
+			success = ( *cursor == '\0' || *cursor == '#' );
+			cursor += strlen( cursor );
+		}
+
+		success = success && *SkipSpace( cursor ) == '\0';
+	}
+
+	fclose( file );
+
+	if( !success )
+	{
+		errorLine = lineReader.GetLineNumber();
+		return false;
+	}
+
+	// The graph was empty, so vertex and edge slots follow the order of the
+	// file, and the edges that were kept are in the order they were given.
+	std::vector< int > idArray;
+	int edgeCount = kinematicGraph.InsertGraph( locationArray, edgeArray, idArray );
+
+	for( int i = 0; i < ( int )locationArray.size(); i++ )
+	{
+		kinematicGraph.vertexStationaryArray[i] = stationaryArray[i];
+		if( stationaryArray[i] )
+			kinematicGraph.vertexStationArray[i] = KinematicGraph::Vector( stationArray[i] );
+	}
+
+	for( int i = 0, edge = 0; i < ( int )lengthArray.size() && edge < edgeCount; i++ )
+	{
+		if( kinematicGraph.edgeVertexArray[ 2 * edge ] != edgeArray[ 2 * i ] || kinematicGraph.edgeVertexArray[ 2 * edge + 1 ] != edgeArray[ 2 * i + 1 ] )
+			continue;
+
+		if( lengthArray[i] >= 0.f )
+			kinematicGraph.edgeLengthArray[ edge ] = lengthArray[i];
+		edge++;
+	}
+
+	if( selectionArray[0] >= 0 && selectionArray[1] < 0 )
+		kinematicGraph.SetSelectedId( idArray[ selectionArray[0] ] );
+	else if( selectionArray[0] >= 0 )
+	{
+		KinematicGraph::NeighborMap::const_iterator iter = kinematicGraph.neighborMap.find( KinematicGraph::VertexIdPair( idArray[ selectionArray[0] ], idArray[ selectionArray[1] ] ) );
+		if( iter == kinematicGraph.neighborMap.end() )
+		{
+			kinematicGraph.Clear();
+			errorLine = selectionLine;
+			return false;
+		}
+		kinematicGraph.SetSelectedId( iter->second );
+	}
+
+	return true;
+}
+
+// GraphTextFile.cpp
@@ -0,0 +1,43 @@
+// GraphTextFile.h
+
+#pragma once
+
+class KinematicGraph;
+
+// A kinematic graph saved as line-oriented text that can be read, edited
+// and diffed by hand.  The first line names the format and its version,
+// and each of the others is blank, a comment starting with '#', or one of
+//
+//		v <id> <x> <y> <z> <stationary> [<station x> <station y> <station z>]
+//		e <vertex id> <vertex id> [<rest length>]
+//		s <vertex id>
+//		s <vertex id> <vertex id>
+//
+// A vertex's station defaults to its location, and an edge's rest length
+// to the distance between its vertices; "s" selects a vertex, or the edge
+// between two.  The ids only name the vertices within the file (they are
+// written as vertex slots), so a graph read from it hands out fresh ones.
+// An edge that repeats an earlier one is skipped.
+//
+// Both directions stream through a fixed-size buffer, so neither ever
+// holds the text of the whole file.  Numbers are written with the fewest
+// digits that read back to the same value.
+class GraphTextFile
+{
+public:
+
+	enum { VERSION = 1 };
+
+	static bool Write( const KinematicGraph& kinematicGraph, const char* path );
+
+	// Replace the contents of the graph with those of the file.  On failure
+	// the graph is left empty and the error line is set to the number of the
+	// offending line, or to zero if the file could not be read at all.
+	static bool Read( KinematicGraph& kinematicGraph, const char* path, int& errorLine );
+
+private:
+
+	static bool ReadContents( KinematicGraph& kinematicGraph, const char* path, int& errorLine );
+};
+
+// GraphTextFile.h
@@ -0,0 +1,91 @@
+// GraphVector.h
+
+#pragma once
+
+#include "C3GA/c3ga.h"
+#include <cmath>
+
+// A Euclidean vector in two or three dimensions stored in a chosen
+// precision.  c3ga is generated for 3D doubles only, so the graph keeps its
+// vertex locations in this type instead, which provides just the operations
+// the solvers need under the names c3ga uses for them, and converts to and
+// from c3ga::vectorE3GA at the public interface.  A 2D vector reads its e3
+// coordinate as zero and ignores writes to it.  The coordinates are packed,
+// so an array of these can be read as an array of coordinate tuples.
+template< typename Real, int Dimension >
+class GraphVector
+{
+public:
+
+	GraphVector( void ) { set( 0, 0, 0 ); }
+	GraphVector( Real e1, Real e2, Real e3 ) { set( e1, e2, e3 ); }
+	explicit GraphVector( const c3ga::vectorE3GA& vector ) { set( Real( vector.get_e1() ), Real( vector.get_e2() ), Real( vector.get_e3() ) ); }
+
+	c3ga::vectorE3GA ToE3GA( void ) const { return c3ga::vectorE3GA( c3ga::vectorE3GA::coord_e1_e2_e3, get_e1(), get_e2(), get_e3() ); }
+
+	void set( Real e1, Real e2, Real e3 )
+	{
+		m_c[0] = e1;
+		m_c[1] = e2;
+		if( Dimension == 3 )
+			m_c[ Dimension - 1 ] = e3;
+	}
+
+	Real get_e1( void ) const { return m_c[0]; }
+	Real get_e2( void ) const { return m_c[1]; }
+	Real get_e3( void ) const { return ( Dimension == 3 ) ? m_c[ Dimension - 1 ] : Real(0); }
+
+	const Real* getC( void ) const { return m_c; }
+
+	Real& operator[]( int i ) { return m_c[i]; }
+	Real operator[]( int i ) const { return m_c[i]; }
+
+	GraphVector operator+( const GraphVector& vector ) const
+	{
+		GraphVector result;
+		for( int i = 0; i < Dimension; i++ )
+			result.m_c[i] = m_c[i] + vector.m_c[i];
+		return result;
+	}
+
+	GraphVector operator-( const GraphVector& vector ) const
+	{
+		GraphVector result;
+		for( int i = 0; i < Dimension; i++ )
+			result.m_c[i] = m_c[i] - vector.m_c[i];
+		return result;
+	}
+
+	GraphVector operator*( Real scale ) const
+	{
+		GraphVector result;
+		for( int i = 0; i < Dimension; i++ )
+			result.m_c[i] = m_c[i] * scale;
+		return result;
+	}
+
+private:
+
+	Real m_c[ Dimension ];
+};
+
+template< typename Real, int Dimension >
+inline Real norm( const GraphVector< Real, Dimension >& vector )
+{
+	Real squareLength = vector[0] * vector[0];
+	for( int i = 1; i < Dimension; i++ )
+		squareLength += vector[i] * vector[i];
+	return std::sqrt( squareLength );
+}
+
+template< typename Real, int Dimension >
+inline GraphVector< Real, Dimension > unit( const GraphVector< Real, Dimension >& vector )
+{
+	Real length = norm( vector );
+	GraphVector< Real, Dimension > result;
+	for( int i = 0; i < Dimension; i++ )
+		result[i] = vector[i] / length;
+	return result;
+}
+
+// GraphVector.h
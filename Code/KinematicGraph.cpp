@@ -1,108 +1,268 @@
 // KinematicGraph.cpp
 
 #include "KinematicGraph.h"
-
-KinematicGraph::KinematicGraph( void )
+#include "SolveRecorder.h"
+#include "PickGrid.h"
+#include <assert.h>
+#include <algorithm>
+#include <math.h>
+#include <limits.h>
+#include <float.h>
+
+// Bounds on the acceleration.  Over-relaxing by a factor of two or more, or
+// assuming the sweeps do not converge at all, diverges even on a linear system.
+static const float maxRelaxation = 1.9f;
+static const float maxSpectralRadius = 0.999f;
+
+KinematicGraph::KinematicGraph( void ) :
+	neighborMap( NeighborMap::key_compare(), NeighborMap::allocator_type( &nodeArena ) )
 {
 	newId = 1;
 	selectedId = 0;
 	key = 0;
 	epsilon = 1e-5f;
+	adjacencyDirty = true;
+	recorder = nullptr;
+	pickGrid = nullptr;
+	threadPool = nullptr;
+	movedVertexBegin = 0;
+	movedVertexEnd = 0;
+	drawingDirty = true;
+
+	solverSettings.solverType = SOLVER_GAUSS_SEIDEL;
+	solverSettings.maxIterations = 100;
+	solverSettings.maxMoves = 10000000;
+	solverSettings.maxSeconds = 0.0;
+	solverSettings.tolerance = epsilon;
+	solverSettings.stallIterations = 10;
+	solverSettings.stallRatio = 1e-3f;
+	solverSettings.divergenceRatio = 1e3f;
+	solverSettings.linearIterations = 200;
+	solverSettings.damping = 1e-6f;
+	solverSettings.threadCount = 0;
+	solverSettings.accelerationType = ACCELERATION_NONE;
+	solverSettings.relaxation = 0.f;
+	solverSettings.spectralRadius = 0.f;
+	solverSettings.andersonDepth = 5;
+	solverSettings.treeReaching = true;
+
+	sweepRelaxation = 1.f;
 }
 
 KinematicGraph::~KinematicGraph( void )
 {
+	recorder = nullptr;
 	Clear();
+
+	delete pickGrid;
+	delete threadPool;
 }
 
+// Everything is emptied but keeps its capacity: the map nodes go back to
+// the node arena, the id table's pages to its spares and the component
+// arrays onto the free list, so that a graph of the same size can be rebuilt
+// without touching the heap.
 void KinematicGraph::Clear( void )
 {
-	while( elementMap.size() > 0 )
-	{
-		ElementMap::iterator elementIter = elementMap.begin();
-		Element* element = elementIter->second;
-		delete element;
-		elementMap.erase( elementIter );
-	}
+	handleTable.Clear();
+	neighborMap.clear();
+
+	vertexIdArray.clear();
+	vertexLocationArray.clear();
+	vertexStationArray.clear();
+	vertexStationaryArray.clear();
+	vertexKeyArray.clear();
+
+	edgeIdArray.clear();
+	edgeVertexArray.clear();
+	edgeLengthArray.clear();
+
+	adjacencyOffsetArray.clear();
+	adjacencyEdgeArray.clear();
+	adjacencyDirty = true;
+
+	vertexComponentArray.clear();
+	vertexComponentIndexArray.clear();
+	edgeComponentIndexArray.clear();
+	freeComponentArray.clear();
+	splitComponentArray.clear();
+	for( int component = ( int )componentArray.size() - 1; component >= 0; component-- )
+		FreeComponent( component );
+
+	drawingDirty = true;
+	if( pickGrid )
+		pickGrid->Invalidate();
+
+	if( recorder )
+		recorder->RecordClear( *this );
+}
+
+void KinematicGraph::SetSolverSettings( const SolverSettings& solverSettings )
+{
+	this->solverSettings = solverSettings;
+
+	if( recorder )
+		recorder->RecordSetSolverSettings( *this );
+}
+
+void KinematicGraph::SetRecorder( SolveRecorder* recorder )
+{
+	this->recorder = recorder;
+
+	if( recorder )
+		recorder->Start( *this );
 }
 
 bool KinematicGraph::GetVertexLocation( int id, c3ga::vectorE3GA& location )
 {
-	Vertex* vertex = FindElement< Vertex >( id );
-	if( !vertex )
+	int vertex = FindVertex( id );
+	if( vertex < 0 )
 		return false;
 
-	location = vertex->location;
+	location = vertexLocationArray[ vertex ].ToE3GA();
 	return true;
 }
 
-void KinematicGraph::Render( GLenum renderMode )
+KinematicGraph::Handle* KinematicGraph::FindHandle( int id, ElementType type )
 {
-	// Draw all edges first.
-	glLineWidth( 2.f );
-	ElementMap::iterator elementIter = elementMap.begin();
-	while( elementIter != elementMap.end() )
-	{
-		Element* element = elementIter->second;
-		if( element->ReturnType() == Edge::Type() )
-			element->Render( renderMode );
-		elementIter++;
-	}
+	Handle* handle = handleTable.Find( id );
+	if( !handle || handle->type != type )
+		return nullptr;
 
-	// Draw all vertices last.
-	glPointSize( 10.f );
-	elementIter = elementMap.begin();
-	while( elementIter != elementMap.end() )
-	{
-		Element* element = elementIter->second;
-		if( element->ReturnType() == Vertex::Type() )
-			element->Render( renderMode );
-		elementIter++;
-	}
+	return handle;
 }
 
-template< typename ElementType >
-ElementType* KinematicGraph::FindElement( int id, ElementMap::iterator* foundIter /*= nullptr*/ )
+int KinematicGraph::FindVertex( int id )
 {
-	ElementMap::iterator elementIter = elementMap.find( id );
-	if( elementIter == elementMap.end() )
-		return nullptr;
+	Handle* handle = FindHandle( id, TYPE_VERTEX );
+	if( !handle )
+		return -1;
 
-	Element* element = elementIter->second;
-	if( element->ReturnType() != ElementType::Type() )
-		return nullptr;
+	return handle->slot;
+}
+
+int KinematicGraph::FindEdge( int id )
+{
+	Handle* handle = FindHandle( id, TYPE_EDGE );
+	if( !handle )
+		return -1;
+
+	return handle->slot;
+}
 
-	if( foundIter )
-		*foundIter = elementIter;
+int KinematicGraph::FollowEdge( int edge, int vertex ) const
+{
+	const int* edgeVertex = &edgeVertexArray[ 2 * edge ];
+	if( edgeVertex[0] == vertex )
+		return edgeVertex[1];
+	if( edgeVertex[1] == vertex )
+		return edgeVertex[0];
+	return -1;
+}
 
-	return( ( ElementType* )element );
+float KinematicGraph::CalcEdgeLength( int edge ) const
+{
+	const int* edgeVertex = &edgeVertexArray[ 2 * edge ];
+	return norm( vertexLocationArray[ edgeVertex[0] ] - vertexLocationArray[ edgeVertex[1] ] );
 }
 
 int KinematicGraph::InsertVertex( const c3ga::vectorE3GA& location )
 {
-	Vertex* vertex = new Vertex( newId++, this );
-	vertex->location = location;
-	elementMap.insert( std::pair< int, Element* >( vertex->id, vertex ) );
-	return vertex->id;
+	Handle handle;
+	handle.type = TYPE_VERTEX;
+	handle.slot = ( int )vertexIdArray.size();
+
+	int id = newId++;
+	handleTable.Insert( id, handle );
+
+	vertexIdArray.push_back( id );
+	vertexLocationArray.push_back( Vector( location ) );
+	vertexStationArray.push_back( Vector() );
+	vertexStationaryArray.push_back( false );
+	vertexKeyArray.push_back(0);
+	vertexComponentArray.push_back( -1 );
+	vertexComponentIndexArray.push_back( -1 );
+
+	AddVertexToComponent( handle.slot, NewComponent() );
+
+	adjacencyDirty = true;
+	drawingDirty = true;
+
+	if( pickGrid )
+		pickGrid->InsertVertex( *this, handle.slot );
+
+	if( recorder )
+		recorder->RecordInsertVertex( *this, location, id );
+
+	return id;
 }
 
 bool KinematicGraph::RemoveVertex( int id )
 {
-	ElementMap::iterator elementIter;
-	Vertex* vertex = FindElement< Vertex >( id, &elementIter );
-	if( !vertex )
+	int vertex = FindVertex( id );
+	if( vertex < 0 )
 		return false;
 
-	while( vertex->edgeList.size() > 0 )
+	while( true )
 	{
-		EdgeList::iterator edgeIter = vertex->edgeList.begin();
-		Edge* edge = *edgeIter;
-		if( !DisconnectVertices( vertex->id, edge->Follow( vertex )->id ) )
+		NeighborMap::iterator neighborIter = neighborMap.lower_bound( VertexIdPair( id, INT_MIN ) );
+		if( neighborIter == neighborMap.end() || neighborIter->first.first != id )
+			break;
+
+		if( !RemoveEdgeBetween( id, neighborIter->first.second ) )
 			return false;
 	}
 
-	elementMap.erase( elementIter );
-	delete vertex;
+	RemoveVertexFromComponent( vertex );
+
+	// Fill the hole with the last vertex so that the vertex arrays stay dense.
+	int lastVertex = ( int )vertexIdArray.size() - 1;
+	if( pickGrid )
+		pickGrid->RemoveVertex( vertex, lastVertex );
+	if( vertex != lastVertex )
+	{
+		int lastId = vertexIdArray[ lastVertex ];
+
+		vertexIdArray[ vertex ] = lastId;
+		vertexLocationArray[ vertex ] = vertexLocationArray[ lastVertex ];
+		vertexStationArray[ vertex ] = vertexStationArray[ lastVertex ];
+		vertexStationaryArray[ vertex ] = vertexStationaryArray[ lastVertex ];
+		vertexKeyArray[ vertex ] = vertexKeyArray[ lastVertex ];
+		vertexComponentArray[ vertex ] = vertexComponentArray[ lastVertex ];
+		vertexComponentIndexArray[ vertex ] = vertexComponentIndexArray[ lastVertex ];
+
+		Component& component = componentArray[ vertexComponentArray[ vertex ] ];
+		component.vertexArray[ vertexComponentIndexArray[ vertex ] ] = vertex;
+		component.stationsDirty = true;
+		handleTable.Find( lastId )->slot = vertex;
+
+		NeighborMap::iterator neighborIter = neighborMap.lower_bound( VertexIdPair( lastId, INT_MIN ) );
+		while( neighborIter != neighborMap.end() && neighborIter->first.first == lastId )
+		{
+			int* edgeVertex = &edgeVertexArray[ 2 * FindEdge( neighborIter->second ) ];
+			if( edgeVertex[0] == lastVertex )
+				edgeVertex[0] = vertex;
+			else if( edgeVertex[1] == lastVertex )
+				edgeVertex[1] = vertex;
+			neighborIter++;
+		}
+	}
+
+	vertexIdArray.pop_back();
+	vertexLocationArray.pop_back();
+	vertexStationArray.pop_back();
+	vertexStationaryArray.pop_back();
+	vertexKeyArray.pop_back();
+	vertexComponentArray.pop_back();
+	vertexComponentIndexArray.pop_back();
+
+	handleTable.Erase( id );
+	adjacencyDirty = true;
+	drawingDirty = true;
+
+	if( recorder )
+		recorder->RecordRemoveVertex( *this, id );
+
 	return true;
 }
 
@@ -111,358 +271,2452 @@ bool KinematicGraph::ConnectVertices( int idA, int idB )
 	if( idA == idB )
 		return false;
 
-	Vertex* vertexA = FindElement< Vertex >( idA );
-	if( !vertexA )
+	int vertexA = FindVertex( idA );
+	if( vertexA < 0 )
 		return false;
 
-	Vertex* vertexB = FindElement< Vertex >( idB );
-	if( !vertexB )
+	int vertexB = FindVertex( idB );
+	if( vertexB < 0 )
 		return false;
 
-	Edge* edgeA = vertexA->Follow( vertexB );
-	if( edgeA )
+	if( neighborMap.find( VertexIdPair( idA, idB ) ) != neighborMap.end() )
 		return false;
 
-	Edge* edgeB = vertexB->Follow( vertexA );
-	if( edgeB )
-		return false;
+	Handle handle;
+	handle.type = TYPE_EDGE;
+	handle.slot = ( int )edgeIdArray.size();
+
+	int id = newId++;
+	handleTable.Insert( id, handle );
+
+	edgeIdArray.push_back( id );
+	edgeVertexArray.push_back( vertexA );
+	edgeVertexArray.push_back( vertexB );
+	edgeLengthArray.push_back( 0.f );
+	edgeLengthArray[ handle.slot ] = CalcEdgeLength( handle.slot );
+	edgeComponentIndexArray.push_back( -1 );
+
+	AddEdgeToComponent( handle.slot, MergeComponents( vertexComponentArray[ vertexA ], vertexComponentArray[ vertexB ] ) );
 
-	Edge* edge = new Edge( newId++, this );
-	edge->vertex[0] = vertexA;
-	edge->vertex[1] = vertexB;
-	edge->length = edge->CalcLength();
-	elementMap.insert( std::pair< int, Element* >( edge->id, edge ) );
+	neighborMap.insert( std::pair< VertexIdPair, int >( VertexIdPair( idA, idB ), id ) );
+	neighborMap.insert( std::pair< VertexIdPair, int >( VertexIdPair( idB, idA ), id ) );
 
-	vertexA->edgeList.push_back( edge );
-	vertexB->edgeList.push_back( edge );
+	adjacencyDirty = true;
+	drawingDirty = true;
+
+	if( pickGrid )
+		pickGrid->InsertEdge( *this, handle.slot );
+
+	if( recorder )
+		recorder->RecordConnectVertices( *this, idA, idB, id );
 
 	return true;
 }
 
-bool KinematicGraph::DisconnectVertices( int idA, int idB )
+void KinematicGraph::Reserve( int vertexCount, int edgeCount )
 {
-	Vertex* vertexA = FindElement< Vertex >( idA );
-	if( !vertexA )
-		return false;
+	vertexCount += ( int )vertexIdArray.size();
+	edgeCount += ( int )edgeIdArray.size();
+
+	vertexIdArray.reserve( vertexCount );
+	vertexLocationArray.reserve( vertexCount );
+	vertexStationArray.reserve( vertexCount );
+	vertexStationaryArray.reserve( vertexCount );
+	vertexKeyArray.reserve( vertexCount );
+	vertexComponentArray.reserve( vertexCount );
+	vertexComponentIndexArray.reserve( vertexCount );
+
+	edgeIdArray.reserve( edgeCount );
+	edgeVertexArray.reserve( 2 * edgeCount );
+	edgeLengthArray.reserve( edgeCount );
+	edgeComponentIndexArray.reserve( edgeCount );
+}
 
-	Vertex* vertexB = FindElement< Vertex >( idB );
-	if( !vertexB )
-		return false;
+// The neighbor map is rebuilt from its own entries, which keep their order
+// under the renumbering, so each goes back in with an end() hint.
+void KinematicGraph::CompactIds( std::vector< int >& oldIdArray )
+{
+	oldIdArray.clear();
+	oldIdArray.reserve( vertexIdArray.size() + edgeIdArray.size() );
+	oldIdArray.insert( oldIdArray.end(), vertexIdArray.begin(), vertexIdArray.end() );
+	oldIdArray.insert( oldIdArray.end(), edgeIdArray.begin(), edgeIdArray.end() );
+	std::sort( oldIdArray.begin(), oldIdArray.end() );
+
+	// Ids no longer in use, such as a stale selection, become zero.
+	auto renumber = [&]( int id ) -> int
+	{
+		std::vector< int >::const_iterator iter = std::lower_bound( oldIdArray.begin(), oldIdArray.end(), id );
+		if( iter == oldIdArray.end() || *iter != id )
+			return 0;
+		return int( iter - oldIdArray.begin() ) + 1;
+	};
 
-	EdgeList::iterator edgeIterA;
-	Edge* edgeA = vertexA->Follow( vertexB, &edgeIterA );
-	if( !edgeA )
-		return false;
+	handleTable.Clear();
 
-	EdgeList::iterator edgeIterB;
-	Edge* edgeB = vertexB->Follow( vertexA, &edgeIterB );
-	if( !edgeB )
-		return false;
+	for( int vertex = 0; vertex < ( int )vertexIdArray.size(); vertex++ )
+	{
+		Handle handle;
+		handle.type = TYPE_VERTEX;
+		handle.slot = vertex;
 
-	if( edgeA != edgeB )
-		return false;
+		vertexIdArray[ vertex ] = renumber( vertexIdArray[ vertex ] );
+		handleTable.Insert( vertexIdArray[ vertex ], handle );
+	}
 
-	vertexA->edgeList.erase( edgeIterA );
-	vertexB->edgeList.erase( edgeIterB );
+	for( int edge = 0; edge < ( int )edgeIdArray.size(); edge++ )
+	{
+		Handle handle;
+		handle.type = TYPE_EDGE;
+		handle.slot = edge;
 
-	ElementMap::iterator elementIter;
-	Edge* edge = FindElement< Edge >( edgeA->id, &elementIter );
-	if( !edge )
-		return false;
+		edgeIdArray[ edge ] = renumber( edgeIdArray[ edge ] );
+		handleTable.Insert( edgeIdArray[ edge ], handle );
+	}
 
-	elementMap.erase( elementIter );
-	delete edge;
-	return true;
+	std::vector< std::pair< VertexIdPair, int > > neighborArray( neighborMap.begin(), neighborMap.end() );
+	neighborMap.clear();
+	for( int i = 0; i < ( int )neighborArray.size(); i++ )
+	{
+		const std::pair< VertexIdPair, int >& neighbor = neighborArray[i];
+		VertexIdPair idPair( renumber( neighbor.first.first ), renumber( neighbor.first.second ) );
+		neighborMap.insert( neighborMap.end(), std::pair< VertexIdPair, int >( idPair, renumber( neighbor.second ) ) );
+	}
+
+	selectedId = renumber( selectedId );
+	newId = ( int )oldIdArray.size() + 1;
+
+	if( recorder )
+		recorder->RecordCompactIds( *this );
 }
 
-bool KinematicGraph::SetVertexStationary( int id, bool stationary )
+// New ids are larger than every id in the neighbor map, so each entry can
+// be appended with an end() hint in constant time, provided the entries go
+// in in key order.  The new vertices only connect among themselves, so their
+// components are found with a union-find pass and built directly.
+int KinematicGraph::InsertGraph( const std::vector< c3ga::vectorE3GA >& locationArray, const std::vector< int >& edgeArray, std::vector< int >& idArray )
 {
-	Vertex* vertex = FindElement< Vertex >( id );
-	if( !vertex )
-		return false;
+	int vertexCount = ( int )locationArray.size();
+	int pairCount = ( int )edgeArray.size() / 2;
+	int firstVertex = ( int )vertexIdArray.size();
+
+	// Keep the first occurrence of each pair, in order, using an open
+	// addressing hash set of pair keys at most half full.
+	std::vector< int > pairArray;
+	pairArray.reserve( 2 * pairCount );
+	int tableSize = 1;
+	while( tableSize < 2 * pairCount )
+		tableSize *= 2;
+	std::vector< unsigned long long > pairTable( tableSize, ULLONG_MAX );
+	for( int i = 0; i < pairCount; i++ )
+	{
+		int indexA = edgeArray[ 2 * i ];
+		int indexB = edgeArray[ 2 * i + 1 ];
+		if( indexA < 0 || indexA >= vertexCount || indexB < 0 || indexB >= vertexCount || indexA == indexB )
+			continue;
+
+		unsigned long long pairKey = ( ( unsigned long long )std::min( indexA, indexB ) << 32 ) | ( unsigned int )std::max( indexA, indexB );
+		unsigned long long hash = pairKey * 0x9E3779B97F4A7C15ULL;
+		int slot = int( ( hash >> 32 ) & ( tableSize - 1 ) );
+		while( pairTable[ slot ] != ULLONG_MAX && pairTable[ slot ] != pairKey )
+			slot = ( slot + 1 ) & ( tableSize - 1 );
+
+		if( pairTable[ slot ] == pairKey )
+			continue;
+
+		pairTable[ slot ] = pairKey;
+		pairArray.push_back( indexA );
+		pairArray.push_back( indexB );
+	}
 
-	vertex->stationary = stationary;
-	if( stationary )
-		vertex->station = vertex->location;
-	else
-		vertex->station.set( c3ga::vectorE3GA::coord_e1_e2_e3, 0.f, 0.f, 0.f );
+	int edgeCount = ( int )pairArray.size() / 2;
+	Reserve( vertexCount, edgeCount );
 
-	return true;
+	idArray.resize( vertexCount );
+	for( int i = 0; i < vertexCount; i++ )
+	{
+		Handle handle;
+		handle.type = TYPE_VERTEX;
+		handle.slot = firstVertex + i;
+
+		int id = newId++;
+		handleTable.Insert( id, handle );
+		idArray[i] = id;
+
+		vertexIdArray.push_back( id );
+		vertexLocationArray.push_back( Vector( locationArray[i] ) );
+		vertexStationArray.push_back( Vector() );
+		vertexStationaryArray.push_back( false );
+		vertexKeyArray.push_back(0);
+		vertexComponentArray.push_back( -1 );
+		vertexComponentIndexArray.push_back( -1 );
+	}
+
+	for( int i = 0; i < edgeCount; i++ )
+	{
+		Handle handle;
+		handle.type = TYPE_EDGE;
+		handle.slot = ( int )edgeIdArray.size();
+
+		int id = newId++;
+		handleTable.Insert( id, handle );
+
+		int vertexA = firstVertex + pairArray[ 2 * i ];
+		int vertexB = firstVertex + pairArray[ 2 * i + 1 ];
+
+		edgeIdArray.push_back( id );
+		edgeVertexArray.push_back( vertexA );
+		edgeVertexArray.push_back( vertexB );
+		edgeLengthArray.push_back( 0.f );
+		edgeLengthArray[ handle.slot ] = CalcEdgeLength( handle.slot );
+		edgeComponentIndexArray.push_back( -1 );
+	}
+
+	// The neighbor entries are put in key order by bucketing them on their
+	// first vertex, whose ids ascend with the vertex index, then sorting
+	// each bucket on the second.
+	std::vector< int > neighborOffsetArray( vertexCount + 1, 0 );
+	for( int i = 0; i < 2 * edgeCount; i++ )
+		neighborOffsetArray[ pairArray[i] + 1 ]++;
+	for( int i = 0; i < vertexCount; i++ )
+		neighborOffsetArray[ i + 1 ] += neighborOffsetArray[i];
+
+	std::vector< std::pair< int, int > > neighborArray( 2 * edgeCount );
+	std::vector< int > neighborCountArray( vertexCount, 0 );
+	for( int i = 0; i < edgeCount; i++ )
+	{
+		int indexA = pairArray[ 2 * i ];
+		int indexB = pairArray[ 2 * i + 1 ];
+		int id = edgeIdArray[ edgeIdArray.size() - edgeCount + i ];
+		neighborArray[ neighborOffsetArray[ indexA ] + neighborCountArray[ indexA ]++ ] = std::pair< int, int >( idArray[ indexB ], id );
+		neighborArray[ neighborOffsetArray[ indexB ] + neighborCountArray[ indexB ]++ ] = std::pair< int, int >( idArray[ indexA ], id );
+	}
+
+	for( int i = 0; i < vertexCount; i++ )
+	{
+		std::sort( neighborArray.begin() + neighborOffsetArray[i], neighborArray.begin() + neighborOffsetArray[ i + 1 ] );
+		for( int j = neighborOffsetArray[i]; j < neighborOffsetArray[ i + 1 ]; j++ )
+			neighborMap.insert( neighborMap.end(), std::pair< VertexIdPair, int >( VertexIdPair( idArray[i], neighborArray[j].first ), neighborArray[j].second ) );
+	}
+
+	// Union-find over the new vertices, with path halving.
+	std::vector< int > parentArray( vertexCount );
+	for( int i = 0; i < vertexCount; i++ )
+		parentArray[i] = i;
+
+	for( int i = 0; i < edgeCount; i++ )
+	{
+		int rootA = pairArray[ 2 * i ];
+		while( parentArray[ rootA ] != rootA )
+			rootA = parentArray[ rootA ] = parentArray[ parentArray[ rootA ] ];
+
+		int rootB = pairArray[ 2 * i + 1 ];
+		while( parentArray[ rootB ] != rootB )
+			rootB = parentArray[ rootB ] = parentArray[ parentArray[ rootB ] ];
+
+		if( rootA != rootB )
+			parentArray[ std::max( rootA, rootB ) ] = std::min( rootA, rootB );
+	}
+
+	// Each root precedes the rest of its set, so its component is created
+	// before any other vertex of the set looks it up.
+	std::vector< int > rootComponentArray( vertexCount, -1 );
+	for( int i = 0; i < vertexCount; i++ )
+	{
+		int root = i;
+		while( parentArray[ root ] != root )
+			root = parentArray[ root ];
+
+		if( root == i )
+			rootComponentArray[i] = NewComponent();
+
+		AddVertexToComponent( firstVertex + i, rootComponentArray[ root ] );
+	}
+
+	for( int i = 0; i < edgeCount; i++ )
+	{
+		int edge = ( int )edgeIdArray.size() - edgeCount + i;
+		AddEdgeToComponent( edge, vertexComponentArray[ edgeVertexArray[ 2 * edge ] ] );
+	}
+
+	adjacencyDirty = true;
+	drawingDirty = true;
+
+	if( pickGrid )
+		pickGrid->InsertElements( *this, firstVertex, ( int )edgeIdArray.size() - edgeCount );
+
+	if( recorder )
+		recorder->RecordInsertGraph( *this, locationArray, edgeArray, idArray, edgeCount );
+
+	return edgeCount;
 }
 
-bool KinematicGraph::GetVertexStationary( int id )
+bool KinematicGraph::DisconnectVertices( int idA, int idB )
 {
-	Vertex* vertex = FindElement< Vertex >( id );
-	if( !vertex )
+	if( !RemoveEdgeBetween( idA, idB ) )
 		return false;
 
-	return vertex->stationary;
+	if( recorder )
+		recorder->RecordDisconnectVertices( *this, idA, idB );
+
+	return true;
 }
 
-void KinematicGraph::MoveVertex( int id, const c3ga::vectorE3GA& delta )
+bool KinematicGraph::RemoveEdgeBetween( int idA, int idB )
 {
-	Vertex* vertex = FindElement< Vertex >( id );
-	if( !vertex )
-		return;
+	if( FindVertex( idA ) < 0 || FindVertex( idB ) < 0 )
+		return false;
 
-	Move move;
-	move.vertex = vertex;
-	move.delta = delta;
+	NeighborMap::iterator neighborIterA = neighborMap.find( VertexIdPair( idA, idB ) );
+	if( neighborIterA == neighborMap.end() )
+		return false;
 
-	MoveList moveQueue;
-	moveQueue.push_back( move );
+	NeighborMap::iterator neighborIterB = neighborMap.find( VertexIdPair( idB, idA ) );
+	if( neighborIterB == neighborMap.end() )
+		return false;
 
-	while( moveQueue.size() > 0 )
-	{
-		// Flush the queue.
-		while( moveQueue.size() > 0 )
-		{
-			MoveList::iterator moveIter = moveQueue.begin();
-			move = *moveIter;
-			moveQueue.erase( moveIter );
-			key++;
-			MoveVertexUnconstrained( move.vertex, move.delta );
-		}
+	if( neighborIterA->second != neighborIterB->second )
+		return false;
 
-		// Now go obey the constraints.
-		ElementMap::iterator elementIter = elementMap.begin();
-		while( elementIter != elementMap.end() )
-		{
-			Element* element = elementIter->second;
-			if( element->ReturnType() == Vertex::Type() )
-			{
-				Vertex* vertex = ( Vertex* )element;
-				if( vertex->stationary )
-				{
-					float error = c3ga::norm( vertex->station - vertex->location );
-					if( error > epsilon )
-					{
-						c3ga::vectorE3GA deltaDir = c3ga::unit( vertex->station - vertex->location );
+	int edge = FindEdge( neighborIterA->second );
+	if( edge < 0 )
+		return false;
 
-						move.vertex = vertex;
-						move.delta = deltaDir * ( error * 0.5f );
-						moveQueue.push_back( move );
+	neighborMap.erase( neighborIterA );
+	neighborMap.erase( neighborIterB );
 
-						break;
-					}
-				}
-			}
-			else if( element->ReturnType() == Edge::Type() )
-			{
-				Edge* edge = ( Edge* )element;
-				float error = edge->CalcLength() - edge->length;
-				if( fabs( error ) > epsilon )
-				{
-					c3ga::vectorE3GA deltaDir = c3ga::unit( edge->vertex[1]->location - edge->vertex[0]->location );
+	RemoveEdge( edge );
+	return true;
+}
 
-					move.vertex = edge->vertex[0];
-					move.delta = deltaDir * ( error * 0.5f );
-					moveQueue.push_back( move );
+void KinematicGraph::RemoveEdge( int edge )
+{
+	int id = edgeIdArray[ edge ];
 
-					//move.vertex = edge->vertex[1];
-					//move.delta = deltaDir * ( -error * 0.5f );
-					//moveQueue.push_back( move );
+	RemoveEdgeFromComponent( edge );
 
-					break;
-				}
-			}
+	// Fill the hole with the last edge so that the edge arrays stay dense.
+	int lastEdge = ( int )edgeIdArray.size() - 1;
+	if( pickGrid )
+		pickGrid->RemoveEdge( edge, lastEdge );
+	if( edge != lastEdge )
+	{
+		int lastId = edgeIdArray[ lastEdge ];
 
-			elementIter++;
-		}
-	}
-}
+		edgeIdArray[ edge ] = lastId;
+		edgeVertexArray[ 2 * edge ] = edgeVertexArray[ 2 * lastEdge ];
+		edgeVertexArray[ 2 * edge + 1 ] = edgeVertexArray[ 2 * lastEdge + 1 ];
+		edgeLengthArray[ edge ] = edgeLengthArray[ lastEdge ];
+		edgeComponentIndexArray[ edge ] = edgeComponentIndexArray[ lastEdge ];
 
-// TODO: Note that I have seen this routine lock-up (i.e., loop forever);
-//       so there are some cases where it's possible.
-void KinematicGraph::MoveVertexUnconstrained( Vertex* vertex, const c3ga::vectorE3GA& delta )
-{
-	Move move;
-	move.vertex = vertex;
-	move.delta = delta;
+		// The moved edge is still listed under its old slot, including in the coloring.
+		Component& component = componentArray[ vertexComponentArray[ edgeVertexArray[ 2 * edge ] ] ];
+		component.edgeArray[ edgeComponentIndexArray[ edge ] ] = edge;
+		component.coloringDirty = true;
 
-	MoveList moveQueue;
-	moveQueue.push_back( move );
+		handleTable.Find( lastId )->slot = edge;
+	}
 
-	while( moveQueue.size() > 0 )
-	{
-		MoveList::iterator moveIter = moveQueue.begin();
-		move = *moveIter;
-		moveQueue.erase( moveIter );
+	edgeIdArray.pop_back();
+	edgeVertexArray.pop_back();
+	edgeVertexArray.pop_back();
+	edgeLengthArray.pop_back();
+	edgeComponentIndexArray.pop_back();
 
-		Vertex* vertex = move.vertex;
+	handleTable.Erase( id );
+	adjacencyDirty = true;
+	drawingDirty = true;
+}
 
-		wxASSERT( vertex->key != key );
-		vertex->key = key;
+void KinematicGraph::UpdateAdjacency( void )
+{
+	if( !adjacencyDirty )
+		return;
 
-		vertex->location = vertex->location + move.delta;
+	int vertexCount = ( int )vertexIdArray.size();
+	int edgeCount = ( int )edgeIdArray.size();
 
-		EdgeList::iterator edgeIter = vertex->edgeList.begin();
-		while( edgeIter != vertex->edgeList.end() )
-		{
-			Edge* edge = *edgeIter;
-			
-			Vertex* otherVertex = edge->Follow( vertex );
-			if( otherVertex->key != key && !FoundOnMoveList( moveQueue, otherVertex ) )
-			{
-				c3ga::vectorE3GA deltaDir = c3ga::unit( otherVertex->location - vertex->location );
-				float currentLength = edge->CalcLength();
-				float error = edge->length - currentLength;
-				if( fabs( error ) > epsilon )
-				{
-					move.vertex = otherVertex;
-					move.delta = deltaDir * error;
-					moveQueue.push_back( move );
-				}
-			}
+	// Count the degree of each vertex, then turn the counts into offsets.
+	adjacencyOffsetArray.assign( vertexCount + 1, 0 );
+	for( int i = 0; i < 2 * edgeCount; i++ )
+		adjacencyOffsetArray[ edgeVertexArray[i] + 1 ]++;
 
-			edgeIter++;
-		}
+	for( int vertex = 0; vertex < vertexCount; vertex++ )
+		adjacencyOffsetArray[ vertex + 1 ] += adjacencyOffsetArray[ vertex ];
+
+	std::vector< int > insertOffsetArray( adjacencyOffsetArray.begin(), adjacencyOffsetArray.end() - 1 );
+	adjacencyEdgeArray.resize( 2 * edgeCount );
+	for( int edge = 0; edge < edgeCount; edge++ )
+	{
+		adjacencyEdgeArray[ insertOffsetArray[ edgeVertexArray[ 2 * edge ] ]++ ] = edge;
+		adjacencyEdgeArray[ insertOffsetArray[ edgeVertexArray[ 2 * edge + 1 ] ]++ ] = edge;
 	}
+
+	adjacencyDirty = false;
 }
 
-bool KinematicGraph::FoundOnMoveList( const MoveList& moveList, Vertex* vertex )
+int KinematicGraph::NewComponent( void )
 {
-	MoveList::const_iterator moveIter = moveList.begin();
-	while( moveIter != moveList.end() )
+	int component;
+	if( freeComponentArray.size() > 0 )
+	{
+		component = freeComponentArray.back();
+		freeComponentArray.pop_back();
+	}
+	else
 	{
-		const Move& move = *moveIter;
-		if( move.vertex == vertex )
-			return true;
-		moveIter++;
+		component = ( int )componentArray.size();
+		componentArray.push_back( Component() );
 	}
-	return false;
+
+	componentArray[ component ].splitPending = false;
+	componentArray[ component ].coloringDirty = true;
+	componentArray[ component ].stationsDirty = true;
+	return component;
 }
 
-KinematicGraph::Element::Element( int id, KinematicGraph* kinematicGraph )
+void KinematicGraph::FreeComponent( int component )
 {
-	this->id = id;
-	this->kinematicGraph = kinematicGraph;
-
-	color.set( c3ga::vectorE3GA::coord_e1_e2_e3, 0.f, 0.f, 0.f );
+	Component& freeComponent = componentArray[ component ];
+	freeComponent.vertexArray.clear();
+	freeComponent.edgeArray.clear();
+	freeComponent.colorOffsetArray.clear();
+	freeComponent.colorEdgeArray.clear();
+	freeComponent.stationArray.clear();
+	freeComponent.splitPending = false;
+	freeComponent.coloringDirty = true;
+	freeComponent.stationsDirty = true;
+
+	freeComponentArray.push_back( component );
 }
 
-/*virtual*/ KinematicGraph::Element::~Element( void )
+// Move the elements of the smaller component into the larger one, so that
+// no vertex changes component more than log2(n) times through merges.
+int KinematicGraph::MergeComponents( int componentA, int componentB )
 {
+	if( componentA == componentB )
+		return componentA;
+
+	if( componentArray[ componentA ].vertexArray.size() < componentArray[ componentB ].vertexArray.size() )
+		std::swap( componentA, componentB );
+
+	const Component& source = componentArray[ componentB ];
+	for( int i = 0; i < ( int )source.vertexArray.size(); i++ )
+		AddVertexToComponent( source.vertexArray[i], componentA );
+	for( int i = 0; i < ( int )source.edgeArray.size(); i++ )
+		AddEdgeToComponent( source.edgeArray[i], componentA );
+
+	Component& target = componentArray[ componentA ];
+	if( source.splitPending && !target.splitPending )
+	{
+		target.splitPending = true;
+		splitComponentArray.push_back( componentA );
+	}
+
+	FreeComponent( componentB );
+	return componentA;
 }
 
-/*virtual*/ void KinematicGraph::Element::Render( GLenum renderMode )
+void KinematicGraph::AddVertexToComponent( int vertex, int component )
 {
-	if( renderMode == GL_SELECT )
-		glLoadName( id );
+	std::vector< int >& vertexArray = componentArray[ component ].vertexArray;
+	vertexComponentArray[ vertex ] = component;
+	vertexComponentIndexArray[ vertex ] = ( int )vertexArray.size();
+	vertexArray.push_back( vertex );
+	componentArray[ component ].stationsDirty = true;
+}
 
-	if( id == kinematicGraph->selectedId )
-		glColor3f( 1.f, 0.f, 0.f );
-	else
-		glColor3f( color.get_e1(), color.get_e2(), color.get_e3() );
+// The edge must already be attached to vertices of the component.
+void KinematicGraph::AddEdgeToComponent( int edge, int component )
+{
+	std::vector< int >& edgeArray = componentArray[ component ].edgeArray;
+	edgeComponentIndexArray[ edge ] = ( int )edgeArray.size();
+	edgeArray.push_back( edge );
+	componentArray[ component ].coloringDirty = true;
 }
 
-KinematicGraph::Edge::Edge( int id, KinematicGraph* kinematicGraph ) : Element( id, kinematicGraph )
+void KinematicGraph::RemoveVertexFromComponent( int vertex )
 {
-	length = 0.f;
-	vertex[0] = nullptr;
-	vertex[1] = nullptr;
+	int component = vertexComponentArray[ vertex ];
+	std::vector< int >& vertexArray = componentArray[ component ].vertexArray;
+
+	int index = vertexComponentIndexArray[ vertex ];
+	int lastVertex = vertexArray.back();
+	vertexArray[ index ] = lastVertex;
+	vertexComponentIndexArray[ lastVertex ] = index;
+	vertexArray.pop_back();
+	componentArray[ component ].stationsDirty = true;
+
+	if( vertexArray.size() == 0 )
+		FreeComponent( component );
 }
 
-/*virtual*/ KinematicGraph::Edge::~Edge( void )
+// Losing an edge may split its component in two, which is checked later.
+void KinematicGraph::RemoveEdgeFromComponent( int edge )
 {
+	int component = vertexComponentArray[ edgeVertexArray[ 2 * edge ] ];
+	Component& edgeComponent = componentArray[ component ];
+
+	int index = edgeComponentIndexArray[ edge ];
+	int lastEdge = edgeComponent.edgeArray.back();
+	edgeComponent.edgeArray[ index ] = lastEdge;
+	edgeComponentIndexArray[ lastEdge ] = index;
+	edgeComponent.edgeArray.pop_back();
+	edgeComponent.coloringDirty = true;
+
+	if( !edgeComponent.splitPending )
+	{
+		edgeComponent.splitPending = true;
+		splitComponentArray.push_back( component );
+	}
 }
 
-/*virtual*/ void KinematicGraph::Edge::Render( GLenum renderMode )
+// Split every component that lost an edge into its connected pieces, by
+// searching the adjacency from each vertex not yet reached.  The first
+// piece keeps the original component.
+void KinematicGraph::UpdateComponents( void )
 {
-	Element::Render( renderMode );
+	UpdateAdjacency();
+
+	std::vector< int > vertexArray;
+	std::vector< int > searchArray;
 
-	if( vertex[0] && vertex[1] )
+	for( int i = 0; i < ( int )splitComponentArray.size(); i++ )
 	{
-		c3ga::vectorE3GA* locationA = &vertex[0]->location;
-		c3ga::vectorE3GA* locationB = &vertex[1]->location;
+		int component = splitComponentArray[i];
+		if( !componentArray[ component ].splitPending )
+			continue;
 
-		if( renderMode == GL_RENDER )
-		{
-			glBegin( GL_LINES );
-			glVertex3f( locationA->get_e1(), locationA->get_e2(), locationA->get_e3() );
-			glVertex3f( locationB->get_e1(), locationB->get_e2(), locationB->get_e3() );
-			glEnd();
-		}
-		else if( renderMode == GL_SELECT )
+		vertexArray.swap( componentArray[ component ].vertexArray );
+		componentArray[ component ].vertexArray.clear();
+		componentArray[ component ].edgeArray.clear();
+		componentArray[ component ].splitPending = false;
+		componentArray[ component ].coloringDirty = true;
+		componentArray[ component ].stationsDirty = true;
+
+		NewKey();
+
+		int piece = component;
+		for( int j = 0; j < ( int )vertexArray.size(); j++ )
 		{
-			c3ga::vectorE3GA pointA = *locationA + ( *locationB - *locationA ) * ( 1.f / 3.f );
-			c3ga::vectorE3GA pointB = *locationA + ( *locationB - *locationA ) * ( 2.f / 3.f );
+			int root = vertexArray[j];
+			if( vertexKeyArray[ root ] == key )
+				continue;
+
+			if( piece < 0 )
+				piece = NewComponent();
+
+			vertexKeyArray[ root ] = key;
+			searchArray.clear();
+			searchArray.push_back( root );
+
+			while( searchArray.size() > 0 )
+			{
+				int vertex = searchArray.back();
+				searchArray.pop_back();
+				AddVertexToComponent( vertex, piece );
+
+				for( int k = adjacencyOffsetArray[ vertex ]; k < adjacencyOffsetArray[ vertex + 1 ]; k++ )
+				{
+					int edge = adjacencyEdgeArray[k];
 
-			glBegin( GL_LINES );
-			glVertex3f( pointA.get_e1(), pointA.get_e2(), pointA.get_e3() );
-			glVertex3f( pointB.get_e1(), pointB.get_e2(), pointB.get_e3() );
-			glEnd();
+					// Every edge is reached from both ends; take it from its first.
+					if( edgeVertexArray[ 2 * edge ] == vertex )
+						AddEdgeToComponent( edge, piece );
+
+					int otherVertex = FollowEdge( edge, vertex );
+					if( vertexKeyArray[ otherVertex ] != key )
+					{
+						vertexKeyArray[ otherVertex ] = key;
+						searchArray.push_back( otherVertex );
+					}
+				}
+			}
+
+			piece = -1;
 		}
 	}
+
+	splitComponentArray.clear();
 }
 
-KinematicGraph::Vertex* KinematicGraph::Edge::Follow( Vertex* vertex )
+bool KinematicGraph::SetVertexStationary( int id, bool stationary )
 {
-	if( this->vertex[0] == vertex )
-		return this->vertex[1];
-	if( this->vertex[1] == vertex )
-		return this->vertex[0];
-	return nullptr;
+	int vertex = FindVertex( id );
+	if( vertex < 0 )
+		return false;
+
+	vertexStationaryArray[ vertex ] = stationary;
+	if( stationary )
+		vertexStationArray[ vertex ] = vertexLocationArray[ vertex ];
+	else
+		vertexStationArray[ vertex ].set( 0, 0, 0 );
+
+	componentArray[ vertexComponentArray[ vertex ] ].stationsDirty = true;
+	drawingDirty = true;
+
+	if( recorder )
+		recorder->RecordSetVertexStationary( *this, id, stationary );
+
+	return true;
 }
 
-float KinematicGraph::Edge::CalcLength( void )
+int KinematicGraph::PickElement( const c3ga::vectorE3GA& point, double radius )
 {
-	return c3ga::norm( vertex[0]->location - vertex[1]->location );
+	if( !pickGrid )
+		pickGrid = new PickGrid();
+
+	return pickGrid->Pick( *this, point.get_e1(), point.get_e2(), radius );
 }
 
-KinematicGraph::Vertex::Vertex( int id, KinematicGraph* kinematicGraph ) : Element( id, kinematicGraph )
+bool KinematicGraph::GetVertexStationary( int id )
 {
-	stationary = false;
-	
-	location.set( c3ga::vectorE3GA::coord_e1_e2_e3, 0.f, 0.f, 0.f );
-	station.set( c3ga::vectorE3GA::coord_e1_e2_e3, 0.f, 0.f, 0.f );
+	int vertex = FindVertex( id );
+	if( vertex < 0 )
+		return false;
 
-	key = 0;
+	return vertexStationaryArray[ vertex ] ? true : false;
 }
 
-/*virtual*/ KinematicGraph::Vertex::~Vertex( void )
+KinematicGraph::SolveResult KinematicGraph::MoveVertex( int id, const c3ga::vectorE3GA& delta )
 {
+	SolveBudget budget;
+	budget.movesLeft = solverSettings.maxMoves;
+	budget.timed = ( solverSettings.maxSeconds > 0.0 );
+	if( budget.timed )
+		budget.deadline = SolveClock::now() + std::chrono::duration_cast< SolveClock::duration >( std::chrono::duration< double >( solverSettings.maxSeconds ) );
+	budget.deadlineCheck = -1;
+	budget.checkCount = 0;
+	budget.passedCheck = -1;
+
+	return MoveVertex( id, delta, budget );
 }
 
-/*virtual*/ void KinematicGraph::Vertex::Render( GLenum renderMode )
+KinematicGraph::SolveResult KinematicGraph::MoveVertex( int id, const c3ga::vectorE3GA& delta, SolveBudget& budget )
 {
-	Element::Render( renderMode );
+	SolveResult result;
+	result.status = SOLVE_CONVERGED;
+	result.iterations = 0;
+	result.moveCount = 0;
+	result.residual = 0.f;
+	result.convergenceRate = 0.f;
+	result.relaxation = 1.f;
+	result.restartCount = 0;
+	result.reachedTree = false;
+
+	int vertex = FindVertex( id );
+	if( vertex < 0 )
+		return result;
+
+	UpdateComponents();
+	UpdateStations( componentArray[ vertexComponentArray[ vertex ] ] );
+
+	if( recorder )
+		recorder->BeginMoveVertex( *this, vertex );
+
+	// Trees are solved by reaching, whatever the solver.
+	bool reachedTree = solverSettings.treeReaching && CanReachTree( componentArray[ vertexComponentArray[ vertex ] ], vertex );
+	if( reachedTree )
+		result = SolveTree( vertex, Vector( delta ), budget );
+	else
+	{
+		switch( solverSettings.solverType )
+		{
+			case SOLVER_PROPAGATE:
+			{
+				result = SolvePropagate( vertex, Vector( delta ), budget );
+				break;
+			}
+			case SOLVER_GAUSS_SEIDEL:
+			case SOLVER_JACOBI:
+			case SOLVER_PARALLEL:
+			{
+				result = SolveIterative( vertex, Vector( delta ), budget );
+				break;
+			}
+			case SOLVER_GAUSS_NEWTON:
+			{
+				result = SolveGaussNewton( vertex, Vector( delta ), budget );
+				break;
+			}
+			case SOLVER_WORKLIST:
+			{
+				result = SolveWorklist( vertex, Vector( delta ), budget );
+				break;
+			}
+		}
+	}
 
-	glBegin( GL_POINTS );
-	glVertex3f( location.get_e1(), location.get_e2(), location.get_e3() );
-	glEnd();
+	result.reachedTree = reachedTree;
 
-	if( renderMode == GL_RENDER && stationary )
+	// Only the vertices of the dragged vertex's component can have moved.
+	const Component& movedComponent = componentArray[ vertexComponentArray[ vertex ] ];
+	for( int i = 0; i < ( int )movedComponent.vertexArray.size(); i++ )
 	{
-		glLineWidth( 1.5f );
-		glColor3f( 1.f, 0.f, 0.f );
-		glBegin( GL_LINE_LOOP );
-		int segments = 16;
-		float radius = 0.15f;
-		for( int i = 0; i < segments; i++ )
+		int movedVertex = movedComponent.vertexArray[i];
+		if( movedVertexBegin == movedVertexEnd )
+		{
+			movedVertexBegin = movedVertex;
+			movedVertexEnd = movedVertex + 1;
+		}
+		else
 		{
-			float angle = float(i) / float( segments ) * 2.f * M_PI;
-			glVertex2f( station.get_e1() + radius * cos( angle ), station.get_e2() + radius * sin( angle ) );
+			movedVertexBegin = std::min( movedVertexBegin, movedVertex );
+			movedVertexEnd = std::max( movedVertexEnd, movedVertex + 1 );
 		}
-		glEnd();
 	}
+
+	if( pickGrid )
+		pickGrid->UpdateComponent( *this, vertexComponentArray[ vertex ] );
+
+	if( recorder )
+		recorder->RecordMoveVertex( *this, id, delta, budget.passedCheck, result );
+
+	return result;
+}
+
+bool KinematicGraph::SolveBudget::Exhausted( void ) const
+{
+	if( movesLeft <= 0 )
+		return true;
+
+	if( !timed )
+		return false;
+
+	int check = checkCount++;
+	if( deadlineCheck >= 0 )
+		return check >= deadlineCheck;
+
+	if( SolveClock::now() < deadline )
+		return false;
+
+	if( passedCheck < 0 )
+		passedCheck = check;
+
+	return true;
 }
 
-KinematicGraph::Edge* KinematicGraph::Vertex::Follow( Vertex* vertex, EdgeList::iterator* foundIter /*= nullptr*/ )
+// Classify the largest error found by the latest iteration of a solve.
+// Returns false once the solve should stop, with the result's status
+// saying why.  The iteration cap, the move budget and the deadline all
+// count as a stall if the solve has not converged by then.
+bool KinematicGraph::CheckProgress( SolveResult& result, SolveProgress& progress, float error, const SolveBudget& budget ) const
 {
-	for( EdgeList::iterator edgeIter = edgeList.begin(); edgeIter != edgeList.end(); edgeIter++ )
+	if( progress.errorCount++ == 0 )
+		progress.firstError = error;
+	else if( progress.firstError > 0.f && error == error )
+		result.convergenceRate = powf( error / progress.firstError, 1.f / float( progress.errorCount - 1 ) );
+
+	if( error <= solverSettings.tolerance )
 	{
-		Edge* edge = *edgeIter;
-		if( edge->Follow( this ) == vertex )
-		{
-			if( foundIter )
-				*foundIter = edgeIter;
+		result.status = SOLVE_CONVERGED;
+		return false;
+	}
 
-			return edge;
-		}
+	if( error != error || error > progress.divergenceLimit )
+	{
+		result.status = SOLVE_DIVERGED;
+		return false;
 	}
 
-	return nullptr;
-}
+	result.status = SOLVE_STALLED;
+
+	if( progress.divergenceLimit == FLT_MAX )
+		progress.divergenceLimit = fmax( fmax( error, progress.scale ), solverSettings.tolerance ) * solverSettings.divergenceRatio;
+
+	if( error < progress.bestError * ( 1.f - solverSettings.stallRatio ) )
+	{
+		progress.bestError = error;
+		progress.stallCount = 0;
+	}
+	else if( ++progress.stallCount >= solverSettings.stallIterations )
+		return false;
+
+	if( result.iterations >= solverSettings.maxIterations || budget.Exhausted() )
+		return false;
 
-// KinematicGraph.cpp
\ No newline at end of file
+	return true;
+}
+
+KinematicGraph::SolveResult KinematicGraph::SolvePropagate( int vertex, const Vector& delta, SolveBudget& budget )
+{
+	SolveResult result;
+	result.status = SOLVE_CONVERGED;
+	result.iterations = 0;
+	result.moveCount = 0;
+	result.convergenceRate = 0.f;
+	result.relaxation = 1.f;
+	result.restartCount = 0;
+
+	SolveProgress progress;
+	progress.scale = norm( delta );
+
+	Move move;
+	move.vertex = vertex;
+	move.delta = delta;
+
+	solveQueue.Clear();
+	solveQueue.Push( move );
+
+	const Component& component = componentArray[ vertexComponentArray[ vertex ] ];
+	int stationCount = ( int )component.stationArray.size();
+	int edgeCount = ( int )component.edgeArray.size();
+
+	while( !solveQueue.IsEmpty() )
+	{
+		result.iterations++;
+
+		// Flush the queue.
+		while( !solveQueue.IsEmpty() )
+		{
+			move = solveQueue.Pop();
+			result.moveCount += MoveVertexUnconstrained( move.vertex, move.delta, budget );
+		}
+
+		// Now go obey the constraints.
+		float maxError = 0.f;
+		for( int i = 0; i < stationCount && solveQueue.IsEmpty(); i++ )
+		{
+			int stationVertex = component.stationArray[i];
+			float error = norm( vertexStationArray[ stationVertex ] - vertexLocationArray[ stationVertex ] );
+			if( error > epsilon )
+			{
+				Vector deltaDir = unit( vertexStationArray[ stationVertex ] - vertexLocationArray[ stationVertex ] );
+
+				move.vertex = stationVertex;
+				move.delta = deltaDir * ( error * 0.5f );
+				solveQueue.Push( move );
+
+				maxError = error;
+			}
+		}
+
+		for( int i = 0; i < edgeCount && solveQueue.IsEmpty(); i++ )
+		{
+			int edge = component.edgeArray[i];
+			float error = CalcEdgeLength( edge ) - edgeLengthArray[ edge ];
+			if( fabs( error ) > epsilon )
+			{
+				const int* edgeVertex = &edgeVertexArray[ 2 * edge ];
+				Vector deltaDir = unit( vertexLocationArray[ edgeVertex[1] ] - vertexLocationArray[ edgeVertex[0] ] );
+
+				move.vertex = edgeVertex[0];
+				move.delta = deltaDir * ( error * 0.5f );
+				solveQueue.Push( move );
+
+				//move.vertex = edgeVertex[1];
+				//move.delta = deltaDir * ( -error * 0.5f );
+				//moveQueue.push_back( move );
+
+				maxError = fabs( error );
+			}
+		}
+
+		// Only the first violation is known here, so the stall test is
+		// left to the budget; a violation larger than the divergence limit
+		// still ends the solve.
+		if( !solveQueue.IsEmpty() )
+		{
+			progress.bestError = FLT_MAX;
+			if( !CheckProgress( result, progress, maxError, budget ) )
+				break;
+		}
+	}
+
+	// An empty queue means that no constraint is violated any more.
+	result.residual = CalcResidual( component );
+	if( solveQueue.IsEmpty() )
+		result.status = ( result.residual <= solverSettings.tolerance ) ? SOLVE_CONVERGED : SOLVE_STALLED;
+
+	return result;
+}
+
+KinematicGraph::SolveResult KinematicGraph::SolveIterative( int vertex, const Vector& delta, SolveBudget& budget )
+{
+	SolveResult result;
+	result.status = SOLVE_CONVERGED;
+	result.iterations = 0;
+	result.moveCount = 0;
+	result.convergenceRate = 0.f;
+	result.relaxation = 1.f;
+	result.restartCount = 0;
+
+	SolveProgress progress;
+	progress.scale = norm( delta );
+
+	Component& component = componentArray[ vertexComponentArray[ vertex ] ];
+	if( solverSettings.solverType == SOLVER_PARALLEL )
+	{
+		UpdateColoring( component );
+		UpdateThreadPool();
+	}
+
+	// The rigid propagation of the move makes a good initial guess.
+	result.moveCount += MoveVertexUnconstrained( vertex, delta, budget );
+
+	SolveAcceleration acceleration;
+	BeginAcceleration( acceleration );
+
+	while( true )
+	{
+		result.iterations++;
+
+		if( solverSettings.accelerationType == ACCELERATION_CHEBYSHEV || solverSettings.accelerationType == ACCELERATION_ANDERSON )
+			SaveSweepStart( component );
+
+		int moveCount = 0;
+		float error = 0.f;
+		if( solverSettings.solverType == SOLVER_JACOBI )
+			error = ProjectConstraintsJacobi( component, moveCount );
+		else if( solverSettings.solverType == SOLVER_PARALLEL )
+			error = ProjectConstraintsColored( component, moveCount );
+		else
+			error = ProjectConstraintsGaussSeidel( component, moveCount );
+
+		result.moveCount += moveCount;
+		budget.movesLeft -= moveCount;
+
+		if( !CheckProgress( result, progress, error, budget ) )
+			break;
+
+		if( solverSettings.accelerationType != ACCELERATION_NONE )
+		{
+			moveCount = 0;
+			AccelerateSweep( component, acceleration, result, progress, error, moveCount );
+			result.moveCount += moveCount;
+			budget.movesLeft -= moveCount;
+		}
+	}
+
+	if( solverSettings.accelerationType == ACCELERATION_SOR )
+		result.relaxation = sweepRelaxation;
+
+	sweepRelaxation = 1.f;
+
+	result.residual = CalcResidual( component );
+	return result;
+}
+
+void KinematicGraph::BeginAcceleration( SolveAcceleration& acceleration )
+{
+	acceleration.spectralRadius = 0.f;
+	acceleration.lastError = FLT_MAX;
+	acceleration.windowError = 0.f;
+	acceleration.windowEnd = 0;
+	acceleration.windowSettling = false;
+	acceleration.chebyshevStep = 0;
+	acceleration.historyCount = 0;
+	acceleration.historyNext = 0;
+	acceleration.historyPrimed = false;
+
+	sweepRelaxation = 1.f;
+	if( solverSettings.accelerationType == ACCELERATION_SOR && solverSettings.relaxation > 0.f )
+		sweepRelaxation = solverSettings.relaxation;
+	if( solverSettings.accelerationType == ACCELERATION_CHEBYSHEV && solverSettings.spectralRadius > 0.f )
+		acceleration.spectralRadius = std::min( solverSettings.spectralRadius, maxSpectralRadius );
+
+	acceleration.baseRadius = 0.f;
+	acceleration.ceiling = 0.f;
+}
+
+void KinematicGraph::SaveSweepStart( const Component& component )
+{
+	sweepStartArray.resize( vertexIdArray.size() );
+
+	int vertexCount = ( int )component.vertexArray.size();
+	for( int i = 0; i < vertexCount; i++ )
+	{
+		int vertex = component.vertexArray[i];
+		sweepStartArray[ vertex ] = vertexLocationArray[ vertex ];
+	}
+}
+
+// Called after each sweep that has not ended the solve, with the largest
+// error the sweep found.  Anderson mixing restarts whenever the error
+// grows; over-relaxation and Chebyshev judge progress over windows of
+// sweeps instead, the first starting a few sweeps in, once the fast
+// initial drop of the error is over.  A window over which the error grew
+// is undone, and they back off; so is one in which the error more than
+// doubled under Chebyshev, whose extrapolation can blow up within a
+// window.  The rate of convergence measured over a window tunes them.
+//
+// Over-relaxation adapts its factor as SOR does on a linear system
+// (Hageman and Young): the rate observed with the current factor gives an
+// estimate of the spectral radius of the Jacobi iteration, and that the
+// optimal factor, which is taken if it is larger.  Jacobi sweeps average
+// their corrections, so their error factors are taken to be positive, for
+// which simultaneous over-relaxation is optimal.  Chebyshev likewise
+// corrects its spectral radius from the rate it observes.  Either only
+// increases halfway to a value that has failed before.
+void KinematicGraph::AccelerateSweep( const Component& component, SolveAcceleration& acceleration, SolveResult& result, SolveProgress& progress, float error, int& moveCount )
+{
+	if( solverSettings.accelerationType == ACCELERATION_ANDERSON )
+	{
+		if( error > acceleration.lastError && acceleration.historyCount > 0 )
+		{
+			acceleration.historyCount = 0;
+			acceleration.historyNext = 0;
+			result.restartCount++;
+		}
+
+		acceleration.lastError = error;
+		MixAnderson( component, acceleration, moveCount );
+		return;
+	}
+
+	bool chebyshev = ( solverSettings.accelerationType == ACCELERATION_CHEBYSHEV );
+	bool windowEnded = ( result.iterations == ACCELERATION_WINDOW / 2 || result.iterations == acceleration.windowEnd );
+	bool errorGrew = ( chebyshev && acceleration.windowError > 0.f && error > 2.f * acceleration.windowError );
+
+	float windowRate = 0.f;
+	if( result.iterations == acceleration.windowEnd && !acceleration.windowSettling )
+	{
+		windowRate = ( acceleration.windowError > 0.f ) ? powf( error / acceleration.windowError, 1.f / float( ACCELERATION_WINDOW ) ) : 1.f;
+		errorGrew = errorGrew || ( windowRate >= 1.f );
+	}
+
+	bool accelerating = chebyshev ? ( acceleration.spectralRadius > 0.f ) : ( sweepRelaxation > 1.f );
+	if( errorGrew && accelerating )
+	{
+		result.restartCount++;
+
+		int vertexCount = ( int )component.vertexArray.size();
+		for( int i = 0; i < vertexCount; i++ )
+		{
+			int vertex = component.vertexArray[i];
+			if( !vertexStationaryArray[ vertex ] )
+			{
+				vertexLocationArray[ vertex ] = windowLocationArray[ vertex ];
+				moveCount++;
+			}
+		}
+
+		if( !chebyshev )
+		{
+			acceleration.ceiling = sweepRelaxation;
+			sweepRelaxation = 1.f + ( sweepRelaxation - 1.f ) * 0.5f;
+		}
+		else if( acceleration.spectralRadius - acceleration.baseRadius < 1e-3f )
+		{
+			acceleration.spectralRadius = -1.f;
+			result.relaxation = 1.f;
+		}
+		else
+		{
+			acceleration.ceiling = acceleration.spectralRadius;
+			acceleration.spectralRadius = acceleration.baseRadius + ( acceleration.spectralRadius - acceleration.baseRadius ) * 0.5f;
+			acceleration.chebyshevStep = 0;
+		}
+
+		acceleration.windowEnd = result.iterations + ACCELERATION_WINDOW;
+		acceleration.windowSettling = true;
+		return;
+	}
+
+	// The error is upset for a while by a change of the acceleration, so
+	// the stall test is held off until the window after has settled.
+	if( acceleration.windowSettling )
+	{
+		progress.bestError = error;
+		progress.stallCount = 0;
+	}
+
+	if( windowEnded )
+	{
+		windowLocationArray.resize( vertexIdArray.size() );
+
+		int vertexCount = ( int )component.vertexArray.size();
+		for( int i = 0; i < vertexCount; i++ )
+		{
+			int vertex = component.vertexArray[i];
+			windowLocationArray[ vertex ] = vertexLocationArray[ vertex ];
+		}
+
+		acceleration.windowError = error;
+		acceleration.windowEnd = result.iterations + ACCELERATION_WINDOW;
+		acceleration.windowSettling = false;
+	}
+
+	if( !chebyshev )
+	{
+		if( windowRate > 0.f && windowRate < 1.f && solverSettings.relaxation <= 0.f )
+		{
+			float relaxation = sweepRelaxation;
+			if( solverSettings.solverType == SOLVER_JACOBI )
+			{
+				float jacobiRadius = 1.f - ( 1.f - windowRate ) / sweepRelaxation;
+				if( jacobiRadius > 0.f )
+					relaxation = 2.f / ( 2.f - jacobiRadius );
+			}
+			else
+			{
+				float sum = windowRate + sweepRelaxation - 1.f;
+				float squareJacobiRadius = sum * sum / ( windowRate * sweepRelaxation * sweepRelaxation );
+				if( squareJacobiRadius < 1.f )
+					relaxation = 2.f / ( 1.f + sqrtf( 1.f - squareJacobiRadius ) );
+			}
+
+			relaxation = std::min( relaxation, ( acceleration.ceiling > 0.f ) ? 0.5f * ( sweepRelaxation + acceleration.ceiling ) : maxRelaxation );
+			if( relaxation > sweepRelaxation )
+			{
+				sweepRelaxation = relaxation;
+				acceleration.windowSettling = true;
+			}
+		}
+		return;
+	}
+
+	if( acceleration.spectralRadius == 0.f )
+	{
+		if( windowRate > 0.f && windowRate < 1.f )
+		{
+			acceleration.spectralRadius = std::min( windowRate, maxSpectralRadius );
+			acceleration.baseRadius = acceleration.spectralRadius;
+			acceleration.windowSettling = true;
+		}
+		return;
+	}
+
+	if( acceleration.spectralRadius < 0.f )
+		return;
+
+	if( windowRate > 0.f && windowRate < 1.f && solverSettings.spectralRadius <= 0.f )
+	{
+		// The rate at which the error of a spectral radius larger than the
+		// one assumed decays under the Chebyshev recurrence gives it away.
+		float squareRadius = acceleration.spectralRadius * acceleration.spectralRadius;
+		float scaledRate = windowRate * ( 1.f + sqrtf( 1.f - squareRadius ) );
+		float spectralRadius = ( scaledRate * scaledRate + squareRadius ) / ( 2.f * scaledRate );
+		spectralRadius = std::min( spectralRadius, ( acceleration.ceiling > 0.f ) ? 0.5f * ( acceleration.spectralRadius + acceleration.ceiling ) : maxSpectralRadius );
+		if( spectralRadius > acceleration.spectralRadius )
+		{
+			acceleration.spectralRadius = spectralRadius;
+			acceleration.chebyshevStep = 0;
+			acceleration.windowSettling = true;
+		}
+	}
+
+	float squareRadius = acceleration.spectralRadius * acceleration.spectralRadius;
+	acceleration.chebyshevStep++;
+	if( acceleration.chebyshevStep == 1 )
+		result.relaxation = 1.f;
+	else if( acceleration.chebyshevStep == 2 )
+		result.relaxation = 2.f / ( 2.f - squareRadius );
+	else
+		result.relaxation = 4.f / ( 4.f - squareRadius * result.relaxation );
+
+	if( acceleration.chebyshevStep > 1 )
+		ExtrapolateChebyshev( component, result.relaxation, moveCount );
+
+	chebyshevPreviousArray.swap( sweepStartArray );
+}
+
+// The free vertices are moved to q + w * ( q' - q ), where q' is where the
+// sweep left them and q where they were before the sweep before it.
+void KinematicGraph::ExtrapolateChebyshev( const Component& component, float weight, int& moveCount )
+{
+	int vertexCount = ( int )component.vertexArray.size();
+	for( int i = 0; i < vertexCount; i++ )
+	{
+		int vertex = component.vertexArray[i];
+		if( vertexStationaryArray[ vertex ] )
+			continue;
+
+		const Vector& previous = chebyshevPreviousArray[ vertex ];
+		vertexLocationArray[ vertex ] = previous + ( vertexLocationArray[ vertex ] - previous ) * Real( weight );
+		moveCount++;
+	}
+}
+
+// The sweep is a map g from locations to locations whose fixed point is
+// sought.  With x the locations before the latest sweep and f = g(x) - x,
+// the coefficients c minimizing | f - sum c_j dF_j | over the differences
+// dF_j of f between successive sweeps are found from the normal equations,
+// and the same combination of the differences dG_j of g is taken off g(x).
+// The history is dropped if the equations are singular.
+void KinematicGraph::MixAnderson( const Component& component, SolveAcceleration& acceleration, int& moveCount )
+{
+	int depth = std::max( 1, std::min( solverSettings.andersonDepth, int( MAX_ANDERSON_DEPTH ) ) );
+	int vertexCount = ( int )component.vertexArray.size();
+	int size = vertexCount * DIMENSION;
+
+	if( !acceleration.historyPrimed )
+	{
+		andersonResultArray.resize( size );
+		andersonResidualArray.resize( size );
+		andersonResultDeltaArray.resize( size * depth );
+		andersonResidualDeltaArray.resize( size * depth );
+	}
+
+	// Take the differences to the last sweep into the next column.
+	int column = acceleration.historyNext;
+	double* resultDelta = &andersonResultDeltaArray[ column * size ];
+	double* residualDelta = &andersonResidualDeltaArray[ column * size ];
+	for( int i = 0; i < vertexCount; i++ )
+	{
+		int vertex = component.vertexArray[i];
+		for( int j = 0; j < DIMENSION; j++ )
+		{
+			int index = i * DIMENSION + j;
+			double result = vertexLocationArray[ vertex ][j];
+			double residual = result - sweepStartArray[ vertex ][j];
+			if( acceleration.historyPrimed )
+			{
+				resultDelta[ index ] = result - andersonResultArray[ index ];
+				residualDelta[ index ] = residual - andersonResidualArray[ index ];
+			}
+
+			andersonResultArray[ index ] = result;
+			andersonResidualArray[ index ] = residual;
+		}
+	}
+
+	if( !acceleration.historyPrimed )
+	{
+		acceleration.historyPrimed = true;
+		return;
+	}
+
+	acceleration.historyCount = std::min( acceleration.historyCount + 1, depth );
+	acceleration.historyNext = ( column + 1 ) % depth;
+
+	int historyCount = acceleration.historyCount;
+	for( int k = 0; k < historyCount; k++ )
+	{
+		const double* otherDelta = &andersonResidualDeltaArray[ k * size ];
+		double dot = 0.0;
+		for( int index = 0; index < size; index++ )
+			dot += residualDelta[ index ] * otherDelta[ index ];
+
+		andersonGram[ column ][k] = dot;
+		andersonGram[k][ column ] = dot;
+	}
+
+	// The normal equations are solved by Gaussian elimination with partial
+	// pivoting, lightly regularized against nearly parallel columns.
+	double matrix[ MAX_ANDERSON_DEPTH ][ MAX_ANDERSON_DEPTH + 1 ];
+	double trace = 0.0;
+	for( int k = 0; k < historyCount; k++ )
+		trace += andersonGram[k][k];
+
+	for( int k = 0; k < historyCount; k++ )
+	{
+		const double* delta = &andersonResidualDeltaArray[ k * size ];
+		double dot = 0.0;
+		for( int index = 0; index < size; index++ )
+			dot += delta[ index ] * andersonResidualArray[ index ];
+
+		for( int l = 0; l < historyCount; l++ )
+			matrix[k][l] = andersonGram[k][l];
+
+		matrix[k][k] += 1e-10 * trace;
+		matrix[k][ historyCount ] = dot;
+	}
+
+	for( int k = 0; k < historyCount; k++ )
+	{
+		int pivot = k;
+		for( int l = k + 1; l < historyCount; l++ )
+			if( fabs( matrix[l][k] ) > fabs( matrix[ pivot ][k] ) )
+				pivot = l;
+
+		if( !( fabs( matrix[ pivot ][k] ) > 0.0 ) )
+		{
+			acceleration.historyCount = 0;
+			acceleration.historyNext = 0;
+			return;
+		}
+
+		for( int l = k; l <= historyCount; l++ )
+			std::swap( matrix[k][l], matrix[ pivot ][l] );
+
+		for( int l = k + 1; l < historyCount; l++ )
+		{
+			double factor = matrix[l][k] / matrix[k][k];
+			for( int m = k; m <= historyCount; m++ )
+				matrix[l][m] -= factor * matrix[k][m];
+		}
+	}
+
+	double coefficient[ MAX_ANDERSON_DEPTH ];
+	for( int k = historyCount - 1; k >= 0; k-- )
+	{
+		double sum = matrix[k][ historyCount ];
+		for( int l = k + 1; l < historyCount; l++ )
+			sum -= matrix[k][l] * coefficient[l];
+
+		coefficient[k] = sum / matrix[k][k];
+	}
+
+	for( int i = 0; i < vertexCount; i++ )
+	{
+		int vertex = component.vertexArray[i];
+		if( vertexStationaryArray[ vertex ] )
+			continue;
+
+		for( int j = 0; j < DIMENSION; j++ )
+		{
+			int index = i * DIMENSION + j;
+			double mixed = andersonResultArray[ index ];
+			for( int k = 0; k < historyCount; k++ )
+				mixed -= coefficient[k] * andersonResultDeltaArray[ k * size + index ];
+
+			vertexLocationArray[ vertex ][j] = Real( mixed );
+		}
+		moveCount++;
+	}
+}
+
+// Stationary vertices are treated as having infinite mass, so they are
+// snapped onto their stations and are never moved by an edge.  Each
+// sweep returns the largest error it found before correcting it.
+float KinematicGraph::ProjectConstraintsGaussSeidel( const Component& component, int& moveCount )
+{
+	float maxError = 0.f;
+
+	int stationCount = ( int )component.stationArray.size();
+	for( int i = 0; i < stationCount; i++ )
+		ProjectStation( component.stationArray[i], maxError, moveCount );
+
+	int edgeCount = ( int )component.edgeArray.size();
+	for( int i = 0; i < edgeCount; i++ )
+		ProjectEdge( component.edgeArray[i], maxError, moveCount );
+
+	return maxError;
+}
+
+// The edges of a color class share no vertices, so each class can be
+// projected concurrently with exactly the same outcome as projecting it
+// serially.  Per-chunk results are combined in chunk order, which keeps
+// the sweep deterministic for any number of threads.
+float KinematicGraph::ProjectConstraintsColored( const Component& component, int& moveCount )
+{
+	const int grainSize = 256;
+
+	const int* station = component.stationArray.data();
+	int stationCount = ( int )component.stationArray.size();
+	int chunkCount = ThreadPool::CalcChunkCount( stationCount, grainSize );
+	chunkErrorArray.assign( chunkCount, 0.f );
+	chunkMoveCountArray.assign( chunkCount, 0 );
+
+	threadPool->ParallelFor( stationCount, grainSize, [this, station]( int begin, int end, int chunk )
+	{
+		for( int i = begin; i < end; i++ )
+			ProjectStation( station[i], chunkErrorArray[ chunk ], chunkMoveCountArray[ chunk ] );
+	} );
+
+	float maxError = 0.f;
+	for( int chunk = 0; chunk < chunkCount; chunk++ )
+	{
+		maxError = fmax( maxError, chunkErrorArray[ chunk ] );
+		moveCount += chunkMoveCountArray[ chunk ];
+	}
+
+	const std::vector< int >& colorOffsetArray = component.colorOffsetArray;
+	int colorCount = ( int )colorOffsetArray.size() - 1;
+	for( int color = 0; color < colorCount; color++ )
+	{
+		const int* colorEdge = &component.colorEdgeArray[ colorOffsetArray[ color ] ];
+		int colorSize = colorOffsetArray[ color + 1 ] - colorOffsetArray[ color ];
+
+		chunkCount = ThreadPool::CalcChunkCount( colorSize, grainSize );
+		chunkErrorArray.assign( chunkCount, 0.f );
+		chunkMoveCountArray.assign( chunkCount, 0 );
+
+		threadPool->ParallelFor( colorSize, grainSize, [this, colorEdge]( int begin, int end, int chunk )
+		{
+			ProjectEdgeBatch( colorEdge, begin, end - begin, chunkErrorArray[ chunk ], chunkMoveCountArray[ chunk ] );
+		} );
+
+		for( int chunk = 0; chunk < chunkCount; chunk++ )
+		{
+			maxError = fmax( maxError, chunkErrorArray[ chunk ] );
+			moveCount += chunkMoveCountArray[ chunk ];
+		}
+	}
+
+	return maxError;
+}
+
+// The constraints are checked in rounds, each taking the constraints
+// queued during the last, and only those found off by more than the
+// tolerance are projected.  A constraint's error can only change when one
+// of its vertices moves, which queues it again, so once the queue drains
+// every constraint the solve touched is met; the others were left alone.
+// As many checks as the component has constraints count as an iteration,
+// so the solver settings bound the same work as for a sweeping solver.
+// The residual is that of the whole component, as for every other solver,
+// since constraints the solve never touched may be off too.
+KinematicGraph::SolveResult KinematicGraph::SolveWorklist( int vertex, const Vector& delta, SolveBudget& budget )
+{
+	SolveResult result;
+	result.status = SOLVE_CONVERGED;
+	result.iterations = 0;
+	result.moveCount = 0;
+	result.convergenceRate = 0.f;
+	result.relaxation = 1.f;
+	result.restartCount = 0;
+
+	SolveProgress progress;
+	progress.scale = norm( delta );
+
+	const Component& component = componentArray[ vertexComponentArray[ vertex ] ];
+	int sweepSize = std::max( 1, ( int )( component.edgeArray.size() + component.stationArray.size() ) );
+
+	// Entries for slots added since the last solve start out clear.
+	edgeQueuedArray.resize( edgeIdArray.size(), 0 );
+	stationQueuedArray.resize( vertexIdArray.size(), 0 );
+	worklistArray.clear();
+	nextWorklistArray.clear();
+
+	// Only the dragged vertex is moved to begin with, rather than the
+	// rigid propagation of the move, which would disturb the whole
+	// component; the corrections spread only as far as they have to.
+	vertexLocationArray[ vertex ] = vertexLocationArray[ vertex ] + delta;
+	result.moveCount++;
+	budget.movesLeft--;
+	QueueConstraints( vertex, INT_MAX );
+
+	int checkCount = 0;
+	int moveCount = 0;
+	float maxError = 0.f;
+	bool stopped = false;
+
+	while( !stopped && nextWorklistArray.size() > 0 )
+	{
+		worklistArray.swap( nextWorklistArray );
+		nextWorklistArray.clear();
+
+		for( int i = 0; i < ( int )worklistArray.size(); i++ )
+		{
+			ProjectQueuedConstraint( worklistArray[i], maxError, moveCount );
+			if( ++checkCount < sweepSize )
+				continue;
+
+			result.iterations++;
+			result.moveCount += moveCount;
+			budget.movesLeft -= moveCount;
+
+			// Convergence is only known once the queue drains.
+			bool progressing = CheckProgress( result, progress, maxError, budget ) || result.status == SOLVE_CONVERGED;
+			checkCount = 0;
+			moveCount = 0;
+			maxError = 0.f;
+
+			if( !progressing )
+			{
+				for( int j = i + 1; j < ( int )worklistArray.size(); j++ )
+					nextWorklistArray.push_back( worklistArray[j] );
+
+				stopped = true;
+				break;
+			}
+		}
+	}
+
+	if( checkCount > 0 )
+	{
+		result.iterations++;
+		result.moveCount += moveCount;
+		budget.movesLeft -= moveCount;
+	}
+
+	// Leave the queued flags clear for the next solve.
+	for( int i = 0; i < ( int )nextWorklistArray.size(); i++ )
+	{
+		int constraint = nextWorklistArray[i];
+		if( constraint >= 0 )
+			edgeQueuedArray[ constraint ] = 0;
+		else
+			stationQueuedArray[ -1 - constraint ] = 0;
+	}
+
+	result.residual = CalcResidual( component );
+	if( !stopped )
+		result.status = ( result.residual <= solverSettings.tolerance ) ? SOLVE_CONVERGED : SOLVE_STALLED;
+
+	return result;
+}
+
+// Check a constraint taken off the queue, and if it is off by more than
+// the tolerance, project it and queue the constraints of the vertices it
+// moved.
+void KinematicGraph::ProjectQueuedConstraint( int constraint, float& maxError, int& moveCount )
+{
+	float tolerance = solverSettings.tolerance;
+
+	if( constraint >= 0 )
+	{
+		int edge = constraint;
+		edgeQueuedArray[ edge ] = 0;
+
+		if( fabs( CalcEdgeLength( edge ) - edgeLengthArray[ edge ] ) <= tolerance )
+			return;
+
+		int lastMoveCount = moveCount;
+		ProjectEdge( edge, maxError, moveCount );
+		if( moveCount == lastMoveCount )
+			return;
+
+		for( int i = 0; i < 2; i++ )
+		{
+			int edgeVertex = edgeVertexArray[ 2 * edge + i ];
+			if( !vertexStationaryArray[ edgeVertex ] )
+				QueueConstraints( edgeVertex, edge );
+		}
+	}
+	else
+	{
+		int stationVertex = -1 - constraint;
+		stationQueuedArray[ stationVertex ] = 0;
+
+		if( norm( vertexStationArray[ stationVertex ] - vertexLocationArray[ stationVertex ] ) <= tolerance )
+			return;
+
+		ProjectStation( stationVertex, maxError, moveCount );
+		QueueConstraints( stationVertex, constraint );
+	}
+}
+
+// Queue the constraints of a vertex that has just moved, except the one
+// that moved it, which it now meets.  INT_MAX skips none.
+void KinematicGraph::QueueConstraints( int vertex, int skipConstraint )
+{
+	for( int i = adjacencyOffsetArray[ vertex ]; i < adjacencyOffsetArray[ vertex + 1 ]; i++ )
+	{
+		int edge = adjacencyEdgeArray[i];
+		if( edge != skipConstraint && !edgeQueuedArray[ edge ] )
+		{
+			edgeQueuedArray[ edge ] = 1;
+			nextWorklistArray.push_back( edge );
+		}
+	}
+
+	if( vertexStationaryArray[ vertex ] && -1 - vertex != skipConstraint && !stationQueuedArray[ vertex ] )
+	{
+		stationQueuedArray[ vertex ] = 1;
+		nextWorklistArray.push_back( -1 - vertex );
+	}
+}
+
+// A connected component is a tree if it has one edge fewer than vertices.
+bool KinematicGraph::CanReachTree( const Component& component, int vertex ) const
+{
+	return component.edgeArray.size() + 1 == component.vertexArray.size() && component.stationArray.size() <= MAX_TREE_STATIONS && !vertexStationaryArray[ vertex ];
+}
+
+// Forward and backward reaching on a tree.  The tree is rooted at its first
+// station, or at the dragged vertex if it has none, and the other pinned
+// vertices (the dragged vertex at its target and the second station) are
+// joined to the root by the paths of the skeleton.  Each iteration places
+// the skeleton inwards from the pins, each vertex at the mean of the places
+// its children pull it to, then outwards from the root, each vertex on the
+// line to its parent at the edge's length.  Only the pins can be off after
+// that, so the error is how far off they are.  The rest of the tree hangs
+// off the skeleton and is placed once at the end, outwards only.
+KinematicGraph::SolveResult KinematicGraph::SolveTree( int vertex, const Vector& delta, SolveBudget& budget )
+{
+	SolveResult result;
+	result.status = SOLVE_CONVERGED;
+	result.iterations = 0;
+	result.moveCount = 0;
+	result.convergenceRate = 0.f;
+	result.relaxation = 1.f;
+	result.restartCount = 0;
+
+	const Component& component = componentArray[ vertexComponentArray[ vertex ] ];
+	Vector target = vertexLocationArray[ vertex ] + delta;
+	int root = component.stationArray.empty() ? vertex : component.stationArray[0];
+
+	treeParentEdgeArray.resize( vertexIdArray.size() );
+	treePullArray.resize( vertexIdArray.size() );
+	treePullCountArray.resize( vertexIdArray.size() );
+
+	// Order the tree outwards from the root.
+	NewKey();
+	treeOrderArray.clear();
+	treeOrderArray.push_back( root );
+	treeParentEdgeArray[ root ] = -1;
+	vertexKeyArray[ root ] = key;
+
+	for( int i = 0; i < ( int )treeOrderArray.size(); i++ )
+	{
+		int parent = treeOrderArray[i];
+		for( int j = adjacencyOffsetArray[ parent ]; j < adjacencyOffsetArray[ parent + 1 ]; j++ )
+		{
+			int edge = adjacencyEdgeArray[j];
+			int child = FollowEdge( edge, parent );
+			if( vertexKeyArray[ child ] != key )
+			{
+				treeOrderArray.push_back( child );
+				treeParentEdgeArray[ child ] = edge;
+				vertexKeyArray[ child ] = key;
+			}
+		}
+	}
+
+	// Stamp the paths from the pins back to the root with a fresh key, and
+	// keep the skeleton they make in the order of the tree.
+	NewKey();
+	vertexKeyArray[ root ] = key;
+	for( int i = 0; i <= ( int )component.stationArray.size(); i++ )
+	{
+		int pin = ( i == 0 ) ? vertex : component.stationArray[ i - 1 ];
+		for( ; vertexKeyArray[ pin ] != key; pin = FollowEdge( treeParentEdgeArray[ pin ], pin ) )
+			vertexKeyArray[ pin ] = key;
+	}
+
+	treeSkeletonArray.clear();
+	for( int i = 0; i < ( int )treeOrderArray.size(); i++ )
+	{
+		int skeletonVertex = treeOrderArray[i];
+		if( vertexKeyArray[ skeletonVertex ] == key )
+		{
+			treeSkeletonArray.push_back( skeletonVertex );
+			treePullArray[ skeletonVertex ] = Vector();
+			treePullCountArray[ skeletonVertex ] = 0;
+		}
+	}
+
+	SolveProgress progress;
+	progress.scale = norm( delta );
+
+	while( true )
+	{
+		result.iterations++;
+
+		int moveCount = 0;
+		float error = ReachSkeleton( vertex, &target, moveCount );
+		result.moveCount += moveCount;
+		budget.movesLeft -= moveCount;
+
+		if( !CheckProgress( result, progress, error, budget ) )
+			break;
+	}
+
+	// The target is only where the move would take the vertex, like the
+	// initial guess of the other solvers, whereas the stations must hold.
+	// If the target is out of their reach, it is let go.
+	if( result.status != SOLVE_CONVERGED && component.stationArray.size() > 1 )
+	{
+		SolveProgress releasedProgress;
+		releasedProgress.scale = progress.scale;
+
+		while( true )
+		{
+			result.iterations++;
+
+			int moveCount = 0;
+			float error = ReachSkeleton( vertex, nullptr, moveCount );
+			result.moveCount += moveCount;
+			budget.movesLeft -= moveCount;
+
+			if( !CheckProgress( result, releasedProgress, error, budget ) )
+				break;
+		}
+	}
+
+	// Hang the rest of the tree off the skeleton.  This is done whatever
+	// the budget, since it is what keeps the edges at their lengths.
+	int moveCount = 0;
+	for( int i = 1; i < ( int )treeOrderArray.size(); i++ )
+	{
+		int child = treeOrderArray[i];
+		if( vertexKeyArray[ child ] != key )
+		{
+			int edge = treeParentEdgeArray[ child ];
+			vertexLocationArray[ child ] = Reach( vertexLocationArray[ FollowEdge( edge, child ) ], vertexLocationArray[ child ], edgeLengthArray[ edge ] );
+			moveCount++;
+		}
+	}
+
+	result.moveCount += moveCount;
+	budget.movesLeft -= moveCount;
+
+	// The edges are at their lengths, so unless it diverged, the solve
+	// converged if the stations hold.
+	result.residual = CalcResidual( component );
+	if( result.status != SOLVE_DIVERGED )
+		result.status = ( result.residual <= solverSettings.tolerance ) ? SOLVE_CONVERGED : SOLVE_STALLED;
+
+	return result;
+}
+
+// One iteration of reaching over the skeleton, which returns how far the
+// pinned vertices are left off.  The dragged vertex is pinned to the
+// target unless that is null.  A vertex of the skeleton that no pin
+// pulls on is left to follow its parent.
+float KinematicGraph::ReachSkeleton( int vertex, const Vector* target, int& moveCount )
+{
+	int skeletonCount = ( int )treeSkeletonArray.size();
+	int root = treeSkeletonArray[0];
+
+	// Reach in from the pins.
+	for( int i = skeletonCount - 1; i > 0; i-- )
+	{
+		int child = treeSkeletonArray[i];
+		if( child == vertex && target )
+			vertexLocationArray[ child ] = *target;
+		else if( vertexStationaryArray[ child ] )
+			vertexLocationArray[ child ] = vertexStationArray[ child ];
+		else if( treePullCountArray[ child ] > 0 )
+			vertexLocationArray[ child ] = treePullArray[ child ] * Real( 1.0 / treePullCountArray[ child ] );
+		else
+			continue;
+		moveCount++;
+
+		treePullArray[ child ] = Vector();
+		treePullCountArray[ child ] = 0;
+
+		int edge = treeParentEdgeArray[ child ];
+		int parent = FollowEdge( edge, child );
+		treePullArray[ parent ] = treePullArray[ parent ] + Reach( vertexLocationArray[ child ], vertexLocationArray[ parent ], edgeLengthArray[ edge ] );
+		treePullCountArray[ parent ]++;
+	}
+
+	treePullArray[ root ] = Vector();
+	treePullCountArray[ root ] = 0;
+
+	// Reach out from the root.
+	vertexLocationArray[ root ] = ( root == vertex ) ? *target : vertexStationArray[ root ];
+	moveCount++;
+
+	float error = 0.f;
+	for( int i = 1; i < skeletonCount; i++ )
+	{
+		int child = treeSkeletonArray[i];
+		int edge = treeParentEdgeArray[ child ];
+		vertexLocationArray[ child ] = Reach( vertexLocationArray[ FollowEdge( edge, child ) ], vertexLocationArray[ child ], edgeLengthArray[ edge ] );
+		moveCount++;
+
+		if( child == vertex && target )
+			error = fmax( error, norm( *target - vertexLocationArray[ child ] ) );
+		else if( vertexStationaryArray[ child ] )
+			error = fmax( error, norm( vertexStationArray[ child ] - vertexLocationArray[ child ] ) );
+	}
+
+	return error;
+}
+
+// The point at the given distance from the anchor on the way to the
+// location.  A location on the anchor gives no way, so the point is then
+// put along e1, which keeps the edge at its length all the same.
+KinematicGraph::Vector KinematicGraph::Reach( const Vector& anchor, const Vector& location, float length ) const
+{
+	Vector offset = location - anchor;
+	Real distance = norm( offset );
+	if( distance < epsilon )
+		return anchor + Vector( Real( length ), 0, 0 );
+
+	return anchor + offset * Real( length / distance );
+}
+
+// Stationary vertices are snapped back onto their stations.
+void KinematicGraph::ProjectStation( int vertex, float& maxError, int& moveCount )
+{
+	float error = norm( vertexStationArray[ vertex ] - vertexLocationArray[ vertex ] );
+	if( error > maxError )
+		maxError = error;
+
+	vertexLocationArray[ vertex ] = vertexStationArray[ vertex ];
+	moveCount++;
+}
+
+// The correction to add to the first end of an edge and subtract from the
+// second, each scaled by that end's weight (zero if stationary, otherwise
+// one), to restore the edge's length.  Coincident ends have no direction
+// between them, so they are pushed apart along e1, as Reach does.  This
+// returns the edge's length error.
+float KinematicGraph::CalcEdgeCorrection( int edge, Vector& correction ) const
+{
+	int vertexA = edgeVertexArray[ 2 * edge ];
+	int vertexB = edgeVertexArray[ 2 * edge + 1 ];
+
+	float weightSum = ( vertexStationaryArray[ vertexA ] ? 0.f : 1.f ) + ( vertexStationaryArray[ vertexB ] ? 0.f : 1.f );
+
+	Vector vectorAB = vertexLocationArray[ vertexB ] - vertexLocationArray[ vertexA ];
+	float length = norm( vectorAB );
+	float error = length - edgeLengthArray[ edge ];
+
+	if( weightSum == 0.f )
+		correction.set( 0, 0, 0 );
+	else if( length < epsilon )
+		correction = Vector( Real( error * sweepRelaxation / weightSum ), 0, 0 );
+	else
+		correction = vectorAB * ( error * sweepRelaxation / ( length * weightSum ) );
+
+	return error;
+}
+
+// Restore the length of an edge by moving both of its ends equally, or
+// only the free end if the other one is stationary.
+void KinematicGraph::ProjectEdge( int edge, float& maxError, int& moveCount )
+{
+	Vector correction;
+	float error = fabs( CalcEdgeCorrection( edge, correction ) );
+	if( error > maxError )
+		maxError = error;
+
+	int vertexA = edgeVertexArray[ 2 * edge ];
+	int vertexB = edgeVertexArray[ 2 * edge + 1 ];
+	if( !vertexStationaryArray[ vertexA ] )
+	{
+		vertexLocationArray[ vertexA ] = vertexLocationArray[ vertexA ] + correction;
+		moveCount++;
+	}
+	if( !vertexStationaryArray[ vertexB ] )
+	{
+		vertexLocationArray[ vertexB ] = vertexLocationArray[ vertexB ] - correction;
+		moveCount++;
+	}
+}
+
+// Project a set of edges that share no vertices.  Because they are
+// independent, computing every correction from the current locations
+// before applying any is the same as projecting them one at a time,
+// which lets the corrections be computed by the SIMD edge kernel.
+void KinematicGraph::ProjectEdgeBatch( const int* edgeList, int first, int count, float& maxError, int& moveCount )
+{
+	EdgeKernel::Input< Real > input;
+	FillEdgeKernelInput( input );
+
+	Real error[ EdgeKernel::BATCH_SIZE ];
+	Real correctionX[ EdgeKernel::BATCH_SIZE ];
+	Real correctionY[ EdgeKernel::BATCH_SIZE ];
+	Real correctionZ[ EdgeKernel::BATCH_SIZE ];
+	char active[ EdgeKernel::BATCH_SIZE ];
+	EdgeKernel::Output< Real > output = { error, correctionX, correctionY, correctionZ, active };
+
+	for( int offset = 0; offset < count; offset += EdgeKernel::BATCH_SIZE )
+	{
+		int batchSize = std::min( count - offset, int( EdgeKernel::BATCH_SIZE ) );
+		EdgeKernel::Compute( input, edgeList, first + offset, batchSize, output );
+
+		for( int i = 0; i < batchSize; i++ )
+		{
+			int edge = edgeList[ first + offset + i ];
+			int vertexA = edgeVertexArray[ 2 * edge ];
+			int vertexB = edgeVertexArray[ 2 * edge + 1 ];
+
+			if( fabs( error[i] ) > maxError )
+				maxError = float( fabs( error[i] ) );
+
+			// The kernel leaves the correction of an edge whose ends coincide
+			// or are both stationary to be worked out here.
+			Vector correction;
+			if( active[i] )
+				correction = Vector( correctionX[i], correctionY[i], ( DIMENSION == 3 ) ? correctionZ[i] : Real(0) ) * Real( sweepRelaxation );
+			else
+				CalcEdgeCorrection( edge, correction );
+
+			if( !vertexStationaryArray[ vertexA ] )
+			{
+				vertexLocationArray[ vertexA ] = vertexLocationArray[ vertexA ] + correction;
+				moveCount++;
+			}
+			if( !vertexStationaryArray[ vertexB ] )
+			{
+				vertexLocationArray[ vertexB ] = vertexLocationArray[ vertexB ] - correction;
+				moveCount++;
+			}
+		}
+	}
+}
+
+void KinematicGraph::FillEdgeKernelInput( EdgeKernel::Input< Real >& input ) const
+{
+	static_assert( sizeof( Vector ) == DIMENSION * sizeof( Real ), "The edge kernel reads locations as packed tuples." );
+
+	input.location = vertexLocationArray.empty() ? nullptr : vertexLocationArray[0].getC();
+	input.stationary = vertexStationaryArray.empty() ? nullptr : &vertexStationaryArray[0];
+	input.edgeVertex = edgeVertexArray.empty() ? nullptr : &edgeVertexArray[0];
+	input.restLength = edgeLengthArray.empty() ? nullptr : &edgeLengthArray[0];
+	input.epsilon = epsilon;
+	input.dimension = DIMENSION;
+}
+
+// Greedily color the edges of a component so that no two edges of the
+// same color share a vertex, then group the edge slots by color.
+void KinematicGraph::UpdateColoring( Component& component )
+{
+	if( !component.coloringDirty )
+		return;
+
+	// Only the entries of the component's edges are used.
+	int edgeCount = ( int )component.edgeArray.size();
+	edgeColorSlotArray.resize( edgeIdArray.size() );
+	for( int i = 0; i < edgeCount; i++ )
+		edgeColorSlotArray[ component.edgeArray[i] ] = -1;
+
+	colorForbiddenArray.clear();
+	int colorCount = 0;
+
+	for( int i = 0; i < edgeCount; i++ )
+	{
+		int edge = component.edgeArray[i];
+		for( int j = 0; j < 2; j++ )
+		{
+			int vertex = edgeVertexArray[ 2 * edge + j ];
+			for( int k = adjacencyOffsetArray[ vertex ]; k < adjacencyOffsetArray[ vertex + 1 ]; k++ )
+			{
+				int color = edgeColorSlotArray[ adjacencyEdgeArray[k] ];
+				if( color >= 0 )
+					colorForbiddenArray[ color ] = edge;
+			}
+		}
+
+		int color = 0;
+		while( color < colorCount && colorForbiddenArray[ color ] == edge )
+			color++;
+
+		if( color == colorCount )
+		{
+			colorCount++;
+			colorForbiddenArray.push_back( -1 );
+		}
+
+		edgeColorSlotArray[ edge ] = color;
+	}
+
+	std::vector< int >& colorOffsetArray = component.colorOffsetArray;
+	colorOffsetArray.assign( colorCount + 1, 0 );
+	for( int i = 0; i < edgeCount; i++ )
+		colorOffsetArray[ edgeColorSlotArray[ component.edgeArray[i] ] + 1 ]++;
+
+	for( int color = 0; color < colorCount; color++ )
+		colorOffsetArray[ color + 1 ] += colorOffsetArray[ color ];
+
+	colorInsertArray.assign( colorOffsetArray.begin(), colorOffsetArray.end() - 1 );
+	component.colorEdgeArray.resize( edgeCount );
+	for( int i = 0; i < edgeCount; i++ )
+	{
+		int edge = component.edgeArray[i];
+		component.colorEdgeArray[ colorInsertArray[ edgeColorSlotArray[ edge ] ]++ ] = edge;
+	}
+
+	component.coloringDirty = false;
+}
+
+void KinematicGraph::UpdateStations( Component& component )
+{
+	if( !component.stationsDirty )
+		return;
+
+	component.stationArray.clear();
+	for( int i = 0; i < ( int )component.vertexArray.size(); i++ )
+	{
+		int vertex = component.vertexArray[i];
+		if( vertexStationaryArray[ vertex ] )
+			component.stationArray.push_back( vertex );
+	}
+
+	component.stationsDirty = false;
+}
+
+void KinematicGraph::UpdateThreadPool( void )
+{
+	int threadCount = solverSettings.threadCount;
+	if( threadCount <= 0 )
+		threadCount = ( int )std::thread::hardware_concurrency();
+	if( threadCount <= 0 )
+		threadCount = 1;
+
+	if( threadPool && threadPool->GetThreadCount() == threadCount )
+		return;
+
+	delete threadPool;
+	threadPool = new ThreadPool( threadCount );
+}
+
+float KinematicGraph::ProjectConstraintsJacobi( const Component& component, int& moveCount )
+{
+	float maxError = 0.f;
+
+	// Only the entries of the component's vertices are used.
+	jacobiDeltaArray.resize( vertexIdArray.size() );
+	jacobiCountArray.resize( vertexIdArray.size() );
+
+	int vertexCount = ( int )component.vertexArray.size();
+	for( int i = 0; i < vertexCount; i++ )
+	{
+		int vertex = component.vertexArray[i];
+		jacobiDeltaArray[ vertex ].set( 0, 0, 0 );
+		jacobiCountArray[ vertex ] = 0;
+	}
+
+	int stationCount = ( int )component.stationArray.size();
+	for( int i = 0; i < stationCount; i++ )
+	{
+		int vertex = component.stationArray[i];
+		float error = norm( vertexStationArray[ vertex ] - vertexLocationArray[ vertex ] );
+		if( error > maxError )
+			maxError = error;
+
+		jacobiDeltaArray[ vertex ] = vertexStationArray[ vertex ] - vertexLocationArray[ vertex ];
+		jacobiCountArray[ vertex ] = 1;
+	}
+
+	EdgeKernel::Input< Real > input;
+	FillEdgeKernelInput( input );
+
+	Real error[ EdgeKernel::BATCH_SIZE ];
+	Real correctionX[ EdgeKernel::BATCH_SIZE ];
+	Real correctionY[ EdgeKernel::BATCH_SIZE ];
+	Real correctionZ[ EdgeKernel::BATCH_SIZE ];
+	char active[ EdgeKernel::BATCH_SIZE ];
+	EdgeKernel::Output< Real > output = { error, correctionX, correctionY, correctionZ, active };
+
+	const int* componentEdge = component.edgeArray.empty() ? nullptr : &component.edgeArray[0];
+	int edgeCount = ( int )component.edgeArray.size();
+	for( int first = 0; first < edgeCount; first += EdgeKernel::BATCH_SIZE )
+	{
+		int count = std::min( edgeCount - first, int( EdgeKernel::BATCH_SIZE ) );
+		EdgeKernel::Compute( input, componentEdge, first, count, output );
+
+		for( int i = 0; i < count; i++ )
+		{
+			int edge = componentEdge[ first + i ];
+			int vertexA = edgeVertexArray[ 2 * edge ];
+			int vertexB = edgeVertexArray[ 2 * edge + 1 ];
+
+			if( fabs( error[i] ) > maxError )
+				maxError = float( fabs( error[i] ) );
+
+			Vector correction;
+			if( active[i] )
+				correction = Vector( correctionX[i], correctionY[i], ( DIMENSION == 3 ) ? correctionZ[i] : Real(0) ) * Real( sweepRelaxation );
+			else
+				CalcEdgeCorrection( edge, correction );
+
+			if( !vertexStationaryArray[ vertexA ] )
+			{
+				jacobiDeltaArray[ vertexA ] = jacobiDeltaArray[ vertexA ] + correction;
+				jacobiCountArray[ vertexA ]++;
+			}
+			if( !vertexStationaryArray[ vertexB ] )
+			{
+				jacobiDeltaArray[ vertexB ] = jacobiDeltaArray[ vertexB ] - correction;
+				jacobiCountArray[ vertexB ]++;
+			}
+		}
+	}
+
+	for( int i = 0; i < vertexCount; i++ )
+	{
+		int vertex = component.vertexArray[i];
+		if( jacobiCountArray[ vertex ] > 0 )
+		{
+			vertexLocationArray[ vertex ] = vertexLocationArray[ vertex ] + jacobiDeltaArray[ vertex ] * ( 1.0 / double( jacobiCountArray[ vertex ] ) );
+			moveCount++;
+		}
+	}
+
+	return maxError;
+}
+
+KinematicGraph::SolveResult KinematicGraph::SolveGaussNewton( int vertex, const Vector& delta, SolveBudget& budget )
+{
+	SolveResult result;
+	result.status = SOLVE_CONVERGED;
+	result.iterations = 0;
+	result.moveCount = 0;
+	result.convergenceRate = 0.f;
+	result.relaxation = 1.f;
+	result.restartCount = 0;
+
+	SolveProgress progress;
+	progress.scale = norm( delta );
+
+	// Unlike the projection solvers, this one converges best when only the
+	// grabbed vertex is moved up front; the rigid propagation can leave the
+	// linearization a long way from the solution near the stations.
+	vertexLocationArray[ vertex ] = vertexLocationArray[ vertex ] + delta;
+	result.moveCount++;
+	budget.movesLeft--;
+
+	// Stations are hard constraints, so satisfy them once up front and leave
+	// the stationary vertices out of the system altogether.  Only the entries
+	// of the component's vertices are used in the per-vertex scratch arrays.
+	const Component& component = componentArray[ vertexComponentArray[ vertex ] ];
+	int vertexCount = ( int )component.vertexArray.size();
+	int columnCount = 0;
+	jacobianColumnArray.resize( vertexIdArray.size() );
+	baseLocationArray.resize( vertexIdArray.size() );
+	for( int i = 0; i < vertexCount; i++ )
+	{
+		int freeVertex = component.vertexArray[i];
+		if( vertexStationaryArray[ freeVertex ] )
+		{
+			vertexLocationArray[ freeVertex ] = vertexStationArray[ freeVertex ];
+			jacobianColumnArray[ freeVertex ] = -1;
+			result.moveCount++;
+			budget.movesLeft--;
+		}
+		else
+		{
+			jacobianColumnArray[ freeVertex ] = columnCount;
+			columnCount += DIMENSION;
+		}
+	}
+
+	double damping = solverSettings.damping;
+
+	while( true )
+	{
+		result.iterations++;
+
+		// The locations are judged before stepping from them, so that the
+		// solve stops as soon as they meet the tolerance.
+		float error = AssembleJacobian( component, columnCount );
+		if( !CheckProgress( result, progress, error, budget ) )
+			break;
+
+		// Find the smallest step that zeroes the linearized constraints:
+		// J dx = -c with dx = J^T m, so ( J J^T ) m = -c.
+		int rowCount = jacobian.GetRowCount();
+		for( int row = 0; row < rowCount; row++ )
+			constraintErrorArray[ row ] = -constraintErrorArray[ row ];
+
+		jacobian.SolveNormalEquations( constraintErrorArray, multiplierArray, damping, solverSettings.linearIterations, solverSettings.tolerance * 1e-2 );
+		jacobian.MultiplyTranspose( multiplierArray, stepArray );
+
+		// Far from the solution the linearization can overshoot badly, so
+		// back off the step until the sum of squared errors goes down.
+		double merit = CalcConstraintMerit( component );
+		for( int i = 0; i < vertexCount; i++ )
+			baseLocationArray[ component.vertexArray[i] ] = vertexLocationArray[ component.vertexArray[i] ];
+
+		// Every attempt is charged for the vertices it moves, whether or not
+		// it is kept, and the budget can cut the backing off short.
+		int moveCount = 0;
+		double stepScale = 1.0;
+		bool improved = false;
+		for( int attempt = 0; attempt < 8 && !improved; attempt++ )
+		{
+			if( attempt > 0 && budget.Exhausted() )
+				break;
+
+			moveCount = 0;
+			for( int i = 0; i < vertexCount; i++ )
+			{
+				int freeVertex = component.vertexArray[i];
+				int column = jacobianColumnArray[ freeVertex ];
+				if( column >= 0 )
+				{
+					Vector step;
+					for( int k = 0; k < DIMENSION; k++ )
+						step[k] = Real( stepArray[ column + k ] );
+					vertexLocationArray[ freeVertex ] = baseLocationArray[ freeVertex ] + step * stepScale;
+					moveCount++;
+				}
+			}
+
+			result.moveCount += moveCount;
+			budget.movesLeft -= moveCount;
+
+			improved = ( CalcConstraintMerit( component ) < merit );
+			stepScale *= 0.5;
+		}
+
+		// If no step helps, the locations are put back and the next iteration
+		// starts over from them with more damping, which shortens the step
+		// and turns it towards the gradient.  The error stays the same
+		// meanwhile, so the stall test ends the solve if that does not help,
+		// and the budget test if the budget ran out while backing off.
+		if( !improved )
+		{
+			for( int i = 0; i < vertexCount; i++ )
+				vertexLocationArray[ component.vertexArray[i] ] = baseLocationArray[ component.vertexArray[i] ];
+
+			result.moveCount += moveCount;
+			budget.movesLeft -= moveCount;
+
+			damping = fmax( damping * 100.0, 1e-4 );
+			continue;
+		}
+
+		damping = fmax( damping * 0.1, double( solverSettings.damping ) );
+	}
+
+	result.residual = CalcResidual( component );
+	return result;
+}
+
+// The sum of the squared edge length errors of a component.
+double KinematicGraph::CalcConstraintMerit( const Component& component ) const
+{
+	double merit = 0.0;
+
+	int edgeCount = ( int )component.edgeArray.size();
+	for( int i = 0; i < edgeCount; i++ )
+	{
+		int edge = component.edgeArray[i];
+		double error = CalcEdgeLength( edge ) - edgeLengthArray[ edge ];
+		merit += error * error;
+	}
+
+	return merit;
+}
+
+// Fill in the Jacobian of the edge length constraints along with the
+// constraint errors, and return the largest of those errors.  The row of
+// an edge holds the unit vector along the edge, positive at its second
+// vertex and negative at its first.
+float KinematicGraph::AssembleJacobian( const Component& component, int columnCount )
+{
+	float maxError = 0.f;
+
+	jacobian.Reset( columnCount );
+	constraintErrorArray.clear();
+
+	int edgeCount = ( int )component.edgeArray.size();
+	for( int i = 0; i < edgeCount; i++ )
+	{
+		int edge = component.edgeArray[i];
+		int vertexA = edgeVertexArray[ 2 * edge ];
+		int vertexB = edgeVertexArray[ 2 * edge + 1 ];
+
+		Vector vectorAB = vertexLocationArray[ vertexB ] - vertexLocationArray[ vertexA ];
+		double length = norm( vectorAB );
+		double error = length - edgeLengthArray[ edge ];
+		if( fabs( error ) > maxError )
+			maxError = float( fabs( error ) );
+
+		int columnA = jacobianColumnArray[ vertexA ];
+		int columnB = jacobianColumnArray[ vertexB ];
+		if( columnA < 0 && columnB < 0 )
+			continue;
+
+		// Coincident ends have no direction between them, so the row
+		// separates them along e1, as Reach does.
+		Vector direction;
+		if( length < epsilon )
+			direction = Vector( 1, 0, 0 );
+		else
+			direction = vectorAB * ( 1.0 / length );
+
+		jacobian.BeginRow();
+		if( columnA >= 0 )
+		{
+			for( int k = 0; k < DIMENSION; k++ )
+				jacobian.AddEntry( columnA + k, -direction[k] );
+		}
+		if( columnB >= 0 )
+		{
+			for( int k = 0; k < DIMENSION; k++ )
+				jacobian.AddEntry( columnB + k, direction[k] );
+		}
+
+		constraintErrorArray.push_back( error );
+	}
+
+	return maxError;
+}
+
+float KinematicGraph::CalcResidual( const Component& component ) const
+{
+	float maxError = 0.f;
+
+	int stationCount = ( int )component.stationArray.size();
+	for( int i = 0; i < stationCount; i++ )
+	{
+		int vertex = component.stationArray[i];
+		float error = norm( vertexStationArray[ vertex ] - vertexLocationArray[ vertex ] );
+		if( error > maxError )
+			maxError = error;
+	}
+
+	int edgeCount = ( int )component.edgeArray.size();
+	for( int i = 0; i < edgeCount; i++ )
+	{
+		int edge = component.edgeArray[i];
+		float error = fabs( CalcEdgeLength( edge ) - edgeLengthArray[ edge ] );
+		if( error > maxError )
+			maxError = error;
+	}
+
+	return maxError;
+}
+
+// Propagate a move rigidly through the graph, visiting each vertex at most
+// once.  This returns the number of vertices moved, which is charged
+// against the budget; the propagation is cut short if the budget runs out.
+// A vertex is stamped with the current key when it is queued, so checking
+// whether a neighbor has been visited or queued already takes constant time.
+int KinematicGraph::MoveVertexUnconstrained( int vertex, const Vector& delta, SolveBudget& budget )
+{
+	NewKey();
+
+	Move move;
+	move.vertex = vertex;
+	move.delta = delta;
+
+	moveQueue.Clear();
+	moveQueue.Push( move );
+	vertexKeyArray[ vertex ] = key;
+
+	int moveCount = 0;
+
+	while( !moveQueue.IsEmpty() )
+	{
+		// The move budget is checked on every move, the clock only every so often.
+		if( budget.movesLeft <= 0 || ( ( moveCount & 0xFF ) == 0 && budget.Exhausted() ) )
+			break;
+
+		move = moveQueue.Pop();
+
+		int vertex = move.vertex;
+
+		assert( vertexKeyArray[ vertex ] == key );
+
+		vertexLocationArray[ vertex ] = vertexLocationArray[ vertex ] + move.delta;
+		moveCount++;
+		budget.movesLeft--;
+
+		for( int i = adjacencyOffsetArray[ vertex ]; i < adjacencyOffsetArray[ vertex + 1 ]; i++ )
+		{
+			int edge = adjacencyEdgeArray[i];
+
+			int otherVertex = FollowEdge( edge, vertex );
+			if( vertexKeyArray[ otherVertex ] != key )
+			{
+				Vector deltaDir = unit( vertexLocationArray[ otherVertex ] - vertexLocationArray[ vertex ] );
+				float currentLength = CalcEdgeLength( edge );
+				float error = edgeLengthArray[ edge ] - currentLength;
+				if( fabs( error ) > epsilon )
+				{
+					move.vertex = otherVertex;
+					move.delta = deltaDir * error;
+					moveQueue.Push( move );
+					vertexKeyArray[ otherVertex ] = key;
+				}
+			}
+		}
+	}
+
+	return moveCount;
+}
+
+// Start a new generation of vertex stamps.  Before the key would overflow,
+// every stamp is cleared so that no old stamp can match a new key.
+void KinematicGraph::NewKey( void )
+{
+	if( key == INT_MAX )
+	{
+		std::fill( vertexKeyArray.begin(), vertexKeyArray.end(), 0 );
+		key = 0;
+	}
+
+	key++;
+}
+
+void KinematicGraph::MoveQueue::Push( const Move& move )
+{
+	int capacity = ( int )moveArray.size();
+	if( count == capacity )
+	{
+		// Unroll the ring into a buffer twice the size.
+		std::vector< Move > newMoveArray( capacity > 0 ? 2 * capacity : 64 );
+		for( int i = 0; i < count; i++ )
+			newMoveArray[i] = moveArray[ ( head + i ) & ( capacity - 1 ) ];
+
+		moveArray.swap( newMoveArray );
+		capacity = ( int )moveArray.size();
+		head = 0;
+	}
+
+	moveArray[ ( head + count ) & ( capacity - 1 ) ] = move;
+	count++;
+}
+
+KinematicGraph::Move KinematicGraph::MoveQueue::Pop( void )
+{
+	assert( count > 0 );
+
+	Move move = moveArray[ head ];
+	head = ( head + 1 ) & ( ( int )moveArray.size() - 1 );
+	count--;
+	return move;
+}
+
+KinematicGraph::Handle* KinematicGraph::HandleTable::Find( int id )
+{
+	int page = id >> PAGE_SHIFT;
+	if( id <= 0 || page >= ( int )pageArray.size() || pageArray[ page ].empty() )
+		return nullptr;
+
+	Handle* handle = &pageArray[ page ][ id & ( PAGE_SIZE - 1 ) ];
+	if( handle->slot < 0 )
+		return nullptr;
+
+	return handle;
+}
+
+const KinematicGraph::Handle* KinematicGraph::HandleTable::Find( int id ) const
+{
+	return const_cast< HandleTable* >( this )->Find( id );
+}
+
+void KinematicGraph::HandleTable::Insert( int id, const Handle& handle )
+{
+	assert( id > 0 && handle.slot >= 0 );
+
+	int page = id >> PAGE_SHIFT;
+	if( page >= ( int )pageArray.size() )
+	{
+		pageArray.resize( page + 1 );
+		pageCountArray.resize( page + 1, 0 );
+	}
+
+	if( pageArray[ page ].empty() )
+	{
+		Handle emptyHandle;
+		emptyHandle.type = TYPE_VERTEX;
+		emptyHandle.slot = -1;
+
+		if( !sparePageArray.empty() )
+		{
+			pageArray[ page ].swap( sparePageArray.back() );
+			sparePageArray.pop_back();
+		}
+
+		pageArray[ page ].assign( PAGE_SIZE, emptyHandle );
+	}
+
+	Handle& entry = pageArray[ page ][ id & ( PAGE_SIZE - 1 ) ];
+	assert( entry.slot < 0 );
+	entry = handle;
+	pageCountArray[ page ]++;
+}
+
+void KinematicGraph::HandleTable::Erase( int id )
+{
+	Handle* handle = Find( id );
+	if( !handle )
+		return;
+
+	handle->slot = -1;
+
+	int page = id >> PAGE_SHIFT;
+	if( --pageCountArray[ page ] == 0 )
+	{
+		sparePageArray.push_back( std::vector< Handle >() );
+		sparePageArray.back().swap( pageArray[ page ] );
+	}
+}
+
+void KinematicGraph::HandleTable::Clear( void )
+{
+	for( int page = 0; page < ( int )pageArray.size(); page++ )
+	{
+		if( pageArray[ page ].empty() )
+			continue;
+
+		sparePageArray.push_back( std::vector< Handle >() );
+		sparePageArray.back().swap( pageArray[ page ] );
+	}
+
+	pageArray.clear();
+	pageCountArray.clear();
+}
+
+// KinematicGraph.cpp
@@ -3,16 +3,165 @@
 #pragma once
 
 #include "C3GA/c3ga.h"
-#include <wx/glcanvas.h>
-#include <list>
+#include "SparseMatrix.h"
+#include "ThreadPool.h"
+#include "EdgeKernel.h"
+#include "GraphVector.h"
+#include "NodeArena.h"
+#include <vector>
+#include <chrono>
+#include <float.h>
 #include <map>
 
+// The precision in which the graph stores vertex locations and runs its
+// solvers.  Single precision halves the memory traffic of the solvers and
+// doubles the width of their SIMD edge kernel; the interface is double
+// precision either way.
+#if defined( KINEMATIC_GRAPH_FLOAT )
+typedef float KinematicGraphReal;
+#else
+typedef double KinematicGraphReal;
+#endif
+
+// The dimension of the space the graph lives in.  Planar rigs can be built
+// in 2D, which stores a third less per vertex and drops the e3 terms from
+// the solvers; e3 coordinates passed in are then ignored and read back as zero.
+#if defined( KINEMATIC_GRAPH_2D )
+#	define KINEMATIC_GRAPH_DIMENSION 2
+#else
+#	define KINEMATIC_GRAPH_DIMENSION 3
+#endif
+
+class SolveRecorder;
+class PickGrid;
+
 class KinematicGraph
 {
-	friend class Element;
+	friend class KinematicGraphRenderer;
+	friend class GraphFile;
+	friend class GraphTextFile;
+	friend class SolveRecorder;
+	friend class PickGrid;
+	friend class DragSolver;
 
 public:
 
+	enum SolverType
+	{
+		// Propagate the move rigidly, then repeatedly correct the first
+		// violated constraint found until none remain (or the budget runs out).
+		SOLVER_PROPAGATE,
+
+		// Project every violated constraint in each sweep, either in place
+		// (Gauss-Seidel) or from the positions at the start of the sweep
+		// with corrections averaged per vertex (Jacobi).
+		SOLVER_GAUSS_SEIDEL,
+		SOLVER_JACOBI,
+
+		// Treat the edge lengths as a nonlinear system and take minimum-norm
+		// Gauss-Newton steps, each solving the normal equations of the sparse
+		// constraint Jacobian by conjugate gradient.  Stations are held exactly.
+		SOLVER_GAUSS_NEWTON,
+
+		// Project the stations, then each color class of a coloring of the
+		// edges in which no two edges of a class share a vertex.  The edges of
+		// a class are independent, so each class is split across a thread pool.
+		// The result does not depend on the number of threads.
+		SOLVER_PARALLEL,
+
+		// Move the vertex alone, then check only the constraints of vertices
+		// that have moved.  Each correction queues the edges and station of
+		// the vertices it moves, and the solve ends once the queue drains, so
+		// its work follows the region disturbed rather than the component.
+		SOLVER_WORKLIST,
+	};
+
+	// Ways to speed up the convergence of the sweeping solvers (Gauss-Seidel,
+	// Jacobi and parallel); the other solvers ignore them.  What depends on
+	// the rate at which the sweeps converge is tuned to the rate each solve
+	// observes, starting from the settings if they give it.
+	enum AccelerationType
+	{
+		ACCELERATION_NONE,
+
+		// Successive over-relaxation: scale every edge correction by a factor
+		// between one and two, raised towards the optimum for the rate of
+		// convergence observed and halved towards one whenever the error grows.
+		ACCELERATION_SOR,
+
+		// Chebyshev semi-iteration: extrapolate the result of each sweep from
+		// the locations before the last one, by weights that follow the
+		// Chebyshev recurrence for the sweeps' rate of convergence.  The
+		// recurrence starts over, with a smaller rate, whenever the error
+		// grows, and is given up if that does not help.
+		ACCELERATION_CHEBYSHEV,
+
+		// Anderson mixing: replace the result of each sweep by the combination
+		// of the results of the last few whose changes cancel out best, in the
+		// least squares sense.  The history is dropped whenever the error grows.
+		ACCELERATION_ANDERSON,
+	};
+
+	enum { MAX_ANDERSON_DEPTH = 8 };
+
+	// A component that is a tree with no more stations than this is solved
+	// by forward and backward reaching (FABRIK), whichever solver is chosen,
+	// unless the settings turn that off.  Reaching keeps every edge at its
+	// length exactly, and each of its iterations is a pass over the paths
+	// joining the dragged vertex and the stations.  A stationary vertex is
+	// never dragged this way.
+	enum { MAX_TREE_STATIONS = 2 };
+
+	// Every solve is bounded by the iteration cap and the move budget, so it
+	// always returns in a deterministic amount of work; a positive time
+	// limit adds a wall-clock bound on top of those.
+	struct SolverSettings
+	{
+		SolverType solverType;
+		int maxIterations;
+		int maxMoves;
+		double maxSeconds;
+		float tolerance;
+		int stallIterations;		// Give up after this many iterations without...
+		float stallRatio;			// ...reducing the error by at least this fraction.
+		float divergenceRatio;		// Error growth past the first iteration's error that counts as divergence.
+		int linearIterations;		// Conjugate gradient iterations allowed per Gauss-Newton step.
+		float damping;				// Levenberg-Marquardt damping of the Gauss-Newton normal equations.
+		int threadCount;			// Threads used by the parallel solver, or zero for one per core.
+		AccelerationType accelerationType;
+		float relaxation;			// Over-relaxation factor of SOR, or zero to tune it.
+		float spectralRadius;		// Rate of convergence Chebyshev assumes of the sweeps, or zero to measure it.
+		int andersonDepth;			// Sweeps combined by Anderson mixing, up to MAX_ANDERSON_DEPTH.
+		bool treeReaching;			// Whether trees are solved by reaching.
+	};
+
+	enum SolveStatus
+	{
+		SOLVE_CONVERGED,
+		SOLVE_STALLED,
+		SOLVE_DIVERGED,
+	};
+
+	struct SolveResult
+	{
+		SolveStatus status;
+		int iterations;
+		int moveCount;		// The number of vertex moves applied.
+		float residual;		// The largest constraint error left after the solve.
+
+		// How fast the solve converged: the geometric mean of the ratios of
+		// successive iterations' errors, the over-relaxation factor or Chebyshev
+		// weight in use at the end (one without either), and how many times the
+		// acceleration backed off because the error grew.
+		float convergenceRate;
+		float relaxation;
+		int restartCount;
+
+		// Whether the component was a tree solved by reaching, in which case
+		// the chosen solver did not run.
+		bool reachedTree;
+	};
+
 	KinematicGraph( void );
 	~KinematicGraph( void );
 
@@ -22,89 +171,373 @@ public:
 	bool DisconnectVertices( int idA, int idB );
 	void Clear( void );
 
-	void Render( GLenum renderMode );
-	
+	// Build a whole rig in one call, which is much faster than inserting
+	// it an element at a time.  A vertex is inserted at each location and
+	// its id stored in the id array, then each pair of indices into the
+	// location array found in the edge array is connected.  Pairs that
+	// repeat an earlier pair, join a vertex to itself or are out of range
+	// are skipped.  Returns the number of edges inserted.
+	int InsertGraph( const std::vector< c3ga::vectorE3GA >& locationArray, const std::vector< int >& edgeArray, std::vector< int >& idArray );
+
+	// Make room for this many more vertices and edges.
+	void Reserve( int vertexCount, int edgeCount );
+
+	// Renumber the vertices and edges 1, 2, 3... keeping the order of their
+	// ids, so that after many removals the ids handed out next stay small
+	// and the id table compact.  The old ids are stored in order in the
+	// array, so the new id of an element is one more than the index of its
+	// old id there, which can be found by binary search.  The selection is
+	// renumbered too; any other ids held must be.
+	void CompactIds( std::vector< int >& oldIdArray );
+
+	// The number of ids handed out that no longer name an element.
+	int GetDeadIdCount( void ) const { return newId - 1 - ( int )( vertexIdArray.size() + edgeIdArray.size() ); }
+
 	void SetSelectedId( int id ) { selectedId = id; }
 	int GetSelectedId( void ) { return selectedId; }
 
-	void MoveVertex( int id, const c3ga::vectorE3GA& delta );
+	void SetSolverSettings( const SolverSettings& solverSettings );
+	const SolverSettings& GetSolverSettings( void ) const { return solverSettings; }
+
+	SolveResult MoveVertex( int id, const c3ga::vectorE3GA& delta );
 	bool GetVertexLocation( int id, c3ga::vectorE3GA& location );
 	bool SetVertexStationary( int id, bool stationary );
 	bool GetVertexStationary( int id );
 
+	// Return the id of the vertex nearest the point in the e1-e2 plane within
+	// the radius, or failing that, of the edge whose middle third is nearest,
+	// or zero.  This uses a spatial index built at the first pick and kept
+	// current from then on.
+	int PickElement( const c3ga::vectorE3GA& point, double radius );
+
+	// Log every change made through this interface to the recorder, which
+	// starts over from the graph as it is now; null stops recording.  The
+	// graph does not own the recorder.
+	void SetRecorder( SolveRecorder* recorder );
+	SolveRecorder* GetRecorder( void ) { return recorder; }
+
 private:
 
 	float epsilon;
 
-	class Element;
-	class Edge;
-	class Vertex;
+	// Vertices and edges are stored in parallel arrays (structure-of-arrays)
+	// indexed by a dense slot number.  Slots move around as elements are
+	// removed, so the public API only ever deals in ids, which are mapped
+	// to a slot through the handle table.
+	enum ElementType
+	{
+		TYPE_EDGE,
+		TYPE_VERTEX,
+	};
 
-	typedef std::list< Element* > ElementList;
-	typedef std::list< Edge* > EdgeList;
-	typedef std::list< Vertex* > VertexList;
-	typedef std::map< int, Element* > ElementMap;
+	struct Handle
+	{
+		ElementType type;
+		int slot;
+	};
 
-	class Element
+	// The handles indexed by id, for lookups in constant time.  Ids are
+	// handed out in increasing order, so the table is a directory of pages
+	// of consecutive ids.  A page is only allocated while it holds a live
+	// id, so the table takes room for the pages in use rather than for every
+	// id ever handed out; emptied pages are kept for reuse.
+	class HandleTable
 	{
 	public:
-		int id;
-		KinematicGraph* kinematicGraph;
-		c3ga::vectorE3GA color;
-		Element( int id, KinematicGraph* kinematicGraph );
-		virtual ~Element( void );
-		virtual int ReturnType( void ) const = 0;
-		virtual void Render( GLenum renderMode );
+
+		Handle* Find( int id );
+		const Handle* Find( int id ) const;
+
+		// The id must not be in the table already.
+		void Insert( int id, const Handle& handle );
+		void Erase( int id );
+		void Clear( void );
+
+	private:
+
+		enum { PAGE_SHIFT = 10, PAGE_SIZE = 1 << PAGE_SHIFT };
+
+		// Handles with a negative slot are unused.
+		std::vector< std::vector< Handle > > pageArray;
+		std::vector< int > pageCountArray;
+		std::vector< std::vector< Handle > > sparePageArray;
 	};
 
-	class Edge : public Element
+	// Every edge is entered here twice, under (idA,idB) and (idB,idA), so
+	// that the neighbors of a vertex form a contiguous range of the map.
+	typedef std::pair< int, int > VertexIdPair;
+	typedef std::map< VertexIdPair, int, std::less< VertexIdPair >, NodeAllocator< std::pair< const VertexIdPair, int > > > NeighborMap;
+
+	enum { DIMENSION = KINEMATIC_GRAPH_DIMENSION };
+
+	typedef KinematicGraphReal Real;
+	typedef GraphVector< Real, DIMENSION > Vector;
+
+	struct Move
 	{
-	public:
-		float length;
-		Vertex* vertex[2];
-		Edge( int id, KinematicGraph* kinematicGraph );
-		virtual ~Edge( void );
-		static int Type( void ) { return 0; }
-		virtual int ReturnType( void ) const override { return Type(); }
-		virtual void Render( GLenum renderMode ) override;
-		Vertex* Follow( Vertex* vertex );
-		float CalcLength( void );
+		int vertex;
+		Vector delta;
 	};
 
-	class Vertex : public Element
+	// A first-in first-out queue of moves kept in a ring buffer whose size
+	// is a power of two.  The buffer only ever grows, so once it is large
+	// enough, queueing a move does not allocate.
+	class MoveQueue
 	{
 	public:
-		c3ga::vectorE3GA location;
-		c3ga::vectorE3GA station;
-		bool stationary;
-		EdgeList edgeList;
-		int key;
-		Vertex( int id, KinematicGraph* kinematicGraph );
-		virtual ~Vertex( void );
-		static int Type( void ) { return 1; }
-		virtual int ReturnType( void ) const override { return Type(); }
-		virtual void Render( GLenum renderMode ) override;
-		Edge* Follow( Vertex* vertex, EdgeList::iterator* foundIter = nullptr );
+
+		MoveQueue( void ) : head(0), count(0) {}
+
+		bool IsEmpty( void ) const { return count == 0; }
+		void Clear( void ) { head = 0; count = 0; }
+		void Push( const Move& move );
+		Move Pop( void );
+
+	private:
+
+		std::vector< Move > moveArray;
+		int head;
+		int count;
 	};
 
-	struct Move
+	// Vertices joined by edges form a connected component, and a solve only
+	// ever touches the component of the vertex being moved.  Components are
+	// merged as soon as an edge joins them.  Removing an edge may split one,
+	// but finding out needs a search, so that is left until the next solve.
+	struct Component
+	{
+		std::vector< int > vertexArray;		// Vertex slots, in no particular order.
+		std::vector< int > edgeArray;		// Edge slots, in no particular order.
+		bool splitPending;
+
+		// The edge slots grouped by color for the parallel solver, in the
+		// same layout as the adjacency.
+		std::vector< int > colorOffsetArray;
+		std::vector< int > colorEdgeArray;
+		bool coloringDirty;
+
+		// The slots of the stationary vertices, in the order of the vertex
+		// array, so that the station sweeps skip the free vertices.
+		std::vector< int > stationArray;
+		bool stationsDirty;
+	};
+
+	typedef std::chrono::steady_clock SolveClock;
+
+	// The checks of a timed budget are counted, and the first one to find
+	// the deadline passed is noted, so that a recorded solve can be replayed
+	// to stop at the same check; a replayed budget has a deadline check
+	// instead of a clock deadline.
+	struct SolveBudget
+	{
+		int movesLeft;
+		bool timed;
+		SolveClock::time_point deadline;
+		int deadlineCheck;
+		mutable int checkCount;
+		mutable int passedCheck;
+
+		bool Exhausted( void ) const;
+	};
+
+	struct SolveProgress
 	{
-		Vertex* vertex;
-		c3ga::vectorE3GA delta;
+		float scale;
+		float bestError;
+		float divergenceLimit;
+		int stallCount;
+		float firstError;
+		int errorCount;
+
+		SolveProgress( void ) : scale(0.f), bestError( FLT_MAX ), divergenceLimit( FLT_MAX ), stallCount(0), firstError(0.f), errorCount(0) {}
 	};
 
-	typedef std::list< Move > MoveList;
+	// The number of sweeps over which the acceleration judges progress, and
+	// the state it carries from one sweep of a solve to the next.
+	enum { ACCELERATION_WINDOW = 8 };
+
+	struct SolveAcceleration
+	{
+		float spectralRadius;		// Zero until known, negative once Chebyshev has given up.
+		float baseRadius;			// The spectral radius measured without acceleration.
+		float ceiling;				// The factor or radius at which the error last grew, or zero.
+		float lastError;
+		float windowError;			// The error at the start of the window...
+		int windowEnd;				// ...and the sweep that ends it.
+		bool windowSettling;		// Whether the window follows a change of the acceleration, so is not judged.
+		int chebyshevStep;
+		int historyCount;			// Anderson columns in use...
+		int historyNext;			// ...and the one to overwrite next.
+		bool historyPrimed;			// Whether the last sweep's result is kept to difference against.
+	};
 
-	void MoveVertexUnconstrained( Vertex* vertex, const c3ga::vectorE3GA& delta );
-	bool FoundOnMoveList( const MoveList& moveList, Vertex* vertex );
+	SolveResult MoveVertex( int id, const c3ga::vectorE3GA& delta, SolveBudget& budget );
+	bool CheckProgress( SolveResult& result, SolveProgress& progress, float error, const SolveBudget& budget ) const;
+	SolveResult SolvePropagate( int vertex, const Vector& delta, SolveBudget& budget );
+	SolveResult SolveIterative( int vertex, const Vector& delta, SolveBudget& budget );
+	float ProjectConstraintsGaussSeidel( const Component& component, int& moveCount );
+	float ProjectConstraintsJacobi( const Component& component, int& moveCount );
+	float ProjectConstraintsColored( const Component& component, int& moveCount );
+	void BeginAcceleration( SolveAcceleration& acceleration );
+	void SaveSweepStart( const Component& component );
+	void AccelerateSweep( const Component& component, SolveAcceleration& acceleration, SolveResult& result, SolveProgress& progress, float error, int& moveCount );
+	void ExtrapolateChebyshev( const Component& component, float weight, int& moveCount );
+	void MixAnderson( const Component& component, SolveAcceleration& acceleration, int& moveCount );
+	SolveResult SolveWorklist( int vertex, const Vector& delta, SolveBudget& budget );
+	bool CanReachTree( const Component& component, int vertex ) const;
+	SolveResult SolveTree( int vertex, const Vector& delta, SolveBudget& budget );
+	float ReachSkeleton( int vertex, const Vector* target, int& moveCount );
+	Vector Reach( const Vector& anchor, const Vector& location, float length ) const;
+	void ProjectQueuedConstraint( int constraint, float& maxError, int& moveCount );
+	void QueueConstraints( int vertex, int skipConstraint );
+	void ProjectStation( int vertex, float& maxError, int& moveCount );
+	float CalcEdgeCorrection( int edge, Vector& correction ) const;
+	void ProjectEdge( int edge, float& maxError, int& moveCount );
+	void ProjectEdgeBatch( const int* edgeList, int first, int count, float& maxError, int& moveCount );
+	void FillEdgeKernelInput( EdgeKernel::Input< Real >& input ) const;
+	void UpdateColoring( Component& component );
+	void UpdateStations( Component& component );
+	void UpdateThreadPool( void );
+	SolveResult SolveGaussNewton( int vertex, const Vector& delta, SolveBudget& budget );
+	float AssembleJacobian( const Component& component, int columnCount );
+	double CalcConstraintMerit( const Component& component ) const;
+	float CalcResidual( const Component& component ) const;
+	int MoveVertexUnconstrained( int vertex, const Vector& delta, SolveBudget& budget );
+	void NewKey( void );
+
+	Handle* FindHandle( int id, ElementType type );
+	int FindVertex( int id );
+	int FindEdge( int id );
+	int FollowEdge( int edge, int vertex ) const;
+	float CalcEdgeLength( int edge ) const;
+	bool RemoveEdgeBetween( int idA, int idB );
+	void RemoveEdge( int edge );
+	void UpdateAdjacency( void );
+
+	int NewComponent( void );
+	void FreeComponent( int component );
+	int MergeComponents( int componentA, int componentB );
+	void AddVertexToComponent( int vertex, int component );
+	void AddEdgeToComponent( int edge, int component );
+	void RemoveVertexFromComponent( int vertex );
+	void RemoveEdgeFromComponent( int edge );
+	void UpdateComponents( void );
+
+	SolverSettings solverSettings;
 
 	int newId;
 	int selectedId;
-	int key;
+	int key;					// Generation stamp of the current propagation; see vertexKeyArray.
+	MoveQueue moveQueue;
+	MoveQueue solveQueue;		// Pending corrections of the propagation solver.
+
+	NodeArena nodeArena;		// Must outlive the map.
+	HandleTable handleTable;
+	NeighborMap neighborMap;
+
+	// Vertex storage, indexed by vertex slot.
+	std::vector< int > vertexIdArray;
+	std::vector< Vector > vertexLocationArray;
+	std::vector< Vector > vertexStationArray;
+	std::vector< char > vertexStationaryArray;
+	std::vector< int > vertexKeyArray;
+
+	// Edge storage, indexed by edge slot.  Edge i connects vertex slots
+	// edgeVertexArray[2i] and edgeVertexArray[2i+1].
+	std::vector< int > edgeIdArray;
+	std::vector< int > edgeVertexArray;
+	std::vector< float > edgeLengthArray;
+
+	// Compressed sparse row adjacency, rebuilt lazily after any change of
+	// topology.  The edges incident to vertex slot i are found in
+	// adjacencyEdgeArray[ adjacencyOffsetArray[i] ] through
+	// adjacencyEdgeArray[ adjacencyOffsetArray[i+1] - 1 ].
+	std::vector< int > adjacencyOffsetArray;
+	std::vector< int > adjacencyEdgeArray;
+	bool adjacencyDirty;
+
+	// The component of each vertex slot, and where the vertex appears in
+	// that component's vertex array.  An edge belongs to the component of
+	// its vertices, and the position of each edge slot in that component's
+	// edge array is kept likewise.  Freed components are reused.
+	std::vector< int > vertexComponentArray;
+	std::vector< int > vertexComponentIndexArray;
+	std::vector< int > edgeComponentIndexArray;
+	std::vector< Component > componentArray;
+	std::vector< int > freeComponentArray;
+	std::vector< int > splitComponentArray;
+
+	SolveRecorder* recorder;
+	PickGrid* pickGrid;
+
+	// What the renderer has to bring its buffers up to date with since it
+	// last drew the graph: the range of vertex slots solves may have moved,
+	// and whether anything else it draws has changed.  The renderer resets
+	// them.
+	int movedVertexBegin;
+	int movedVertexEnd;
+	bool drawingDirty;
+
+	ThreadPool* threadPool;
+	std::vector< float > chunkErrorArray;
+	std::vector< int > chunkMoveCountArray;
+
+	// Scratch space for coloring a component's edges: the color of each
+	// edge slot, or -1 while it has none; the last edge each color was
+	// ruled out for; and where the next edge of each color goes.
+	std::vector< int > edgeColorSlotArray;
+	std::vector< int > colorForbiddenArray;
+	std::vector< int > colorInsertArray;
+
+	// Scratch space for the Jacobi sweep, indexed by vertex slot.
+	std::vector< Vector > jacobiDeltaArray;
+	std::vector< int > jacobiCountArray;
+
+	// Scratch space for the acceleration: the factor edge corrections are
+	// scaled by during a sweep, one unless over-relaxing; the locations at
+	// the start of the sweep, of the sweep before and of the window, indexed
+	// by vertex slot; and for Anderson mixing, the last sweep's result and
+	// the change it made (its residual), packed in the order of the
+	// component's vertex array, their differences over the last few sweeps,
+	// one column after another, and the Gram matrix of the residual ones.
+	float sweepRelaxation;
+	std::vector< Vector > sweepStartArray;
+	std::vector< Vector > chebyshevPreviousArray;
+	std::vector< Vector > windowLocationArray;
+	std::vector< double > andersonResultArray;
+	std::vector< double > andersonResidualArray;
+	std::vector< double > andersonResultDeltaArray;
+	std::vector< double > andersonResidualDeltaArray;
+	double andersonGram[ MAX_ANDERSON_DEPTH ][ MAX_ANDERSON_DEPTH ];
+
+	// Scratch space for the worklist solver: the constraints to check in
+	// this round and the next, each an edge slot or, for the station of
+	// vertex slot v, -1 - v; whether each constraint is queued, indexed by
+	// edge and vertex slot and all clear between solves.
+	std::vector< int > worklistArray;
+	std::vector< int > nextWorklistArray;
+	std::vector< char > edgeQueuedArray;
+	std::vector< char > stationQueuedArray;
 
-	ElementMap elementMap;
+	// Scratch space for reaching: the vertex slots of the tree in order out
+	// from its root, and of the skeleton of paths to the pinned vertices in
+	// the same order; and indexed by vertex slot, the edge to each vertex's
+	// parent and the sum and number of the places its children pull it to.
+	std::vector< int > treeOrderArray;
+	std::vector< int > treeSkeletonArray;
+	std::vector< int > treeParentEdgeArray;
+	std::vector< Vector > treePullArray;
+	std::vector< int > treePullCountArray;
 
-	template< typename ElementType > ElementType* FindElement( int id, ElementMap::iterator* foundIter = nullptr );
+	// Scratch space for the Gauss-Newton solver.  Each free vertex owns DIMENSION
+	// columns of the Jacobian, starting at its entry in the column array
+	// (which is -1 for stationary vertices); each edge with a free end owns a row.
+	SparseMatrix jacobian;
+	std::vector< int > jacobianColumnArray;
+	std::vector< double > constraintErrorArray;
+	std::vector< double > multiplierArray;
+	std::vector< double > stepArray;
+	std::vector< Vector > baseLocationArray;
 };
 
 // KinematicGraph.h
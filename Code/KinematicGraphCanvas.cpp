@@ -3,6 +3,8 @@
 #include "KinematicGraphCanvas.h"
 #include "KinematicGraphApp.h"
 #include "KinematicGraph.h"
+#include "KinematicGraphRenderer.h"
+#include "DragSolver.h"
 #include <gl/GLU.h>
 
 int KinematicGraphCanvas::attributeList[] = { WX_GL_RGBA, WX_GL_DOUBLEBUFFER, 0 };
@@ -13,8 +15,6 @@ int KinematicGraphCanvas::attributeList[] = { WX_GL_RGBA, WX_GL_DOUBLEBUFFER, 0
 
 KinematicGraphCanvas::KinematicGraphCanvas( wxWindow* parent ) : wxGLCanvas( parent, wxID_ANY, attributeList, wxDefaultPosition, wxDefaultSize, wxWANTS_CHARS )
 {
-	dragging = false;
-
 	window.xMin = -5.f;
 	window.xMax = 5.f;
 	window.yMin = -5.f;
@@ -23,6 +23,11 @@ KinematicGraphCanvas::KinematicGraphCanvas( wxWindow* parent ) : wxGLCanvas( par
 	mouseLocation.set( c3ga::vectorE3GA::coord_e1_e2_e3, 0.f, 0.f, 0.f );
 
 	context = nullptr;
+	renderer = new KinematicGraphRenderer();
+
+	// The solver thread asks for a redraw through the event queue.
+	dragSolver = new DragSolver();
+	dragSolver->SetPublishCallback( [this]{ wxQueueEvent( this, new wxThreadEvent() ); } );
 
 	Bind( wxEVT_PAINT, &KinematicGraphCanvas::OnPaint, this );
 	Bind( wxEVT_SIZE, &KinematicGraphCanvas::OnSize, this );
@@ -31,16 +36,36 @@ KinematicGraphCanvas::KinematicGraphCanvas( wxWindow* parent ) : wxGLCanvas( par
 	Bind( wxEVT_MOTION, &KinematicGraphCanvas::OnMouseMotion, this );
 	Bind( wxEVT_RIGHT_DOWN, &KinematicGraphCanvas::OnMouseRightDown, this );
 	Bind( wxEVT_CHAR_HOOK, &KinematicGraphCanvas::OnCharHook, this );
+	Bind( wxEVT_THREAD, &KinematicGraphCanvas::OnSolvePublished, this );
 }
 
 /*virtual*/ KinematicGraphCanvas::~KinematicGraphCanvas( void )
 {
+	delete dragSolver;
+
+	// The renderer frees its buffers in our context.
+	if( context )
+		SetCurrent( *context );
+
+	delete renderer;
 	delete context;
 }
 
 void KinematicGraphCanvas::OnPaint( wxPaintEvent& event )
 {
-	Render( GL_RENDER );	
+	Render();
+}
+
+void KinematicGraphCanvas::OnSolvePublished( wxThreadEvent& event )
+{
+	Refresh();
+}
+
+// Anything that touches the graph other than drawing it has to take it
+// back from the solver thread first.
+void KinematicGraphCanvas::StopDragging( void )
+{
+	dragSolver->Stop();
 }
 
 void KinematicGraphCanvas::OnCharHook( wxKeyEvent& event )
@@ -49,6 +74,8 @@ void KinematicGraphCanvas::OnCharHook( wxKeyEvent& event )
 	if( !kinematicGraph )
 		return;
 
+	StopDragging();
+
 	wxChar key = event.GetKeyCode();
 	switch( key )
 	{
@@ -64,7 +91,7 @@ void KinematicGraphCanvas::OnCharHook( wxKeyEvent& event )
 		case 'E':
 		{
 			wxPoint mousePos = event.GetPosition();
-			int id = Render( GL_SELECT, &mousePos );
+			int id = Pick( mousePos );
 			kinematicGraph->ConnectVertices( kinematicGraph->GetSelectedId(), id );
 			kinematicGraph->SetSelectedId( id );
 			Refresh();
@@ -73,7 +100,7 @@ void KinematicGraphCanvas::OnCharHook( wxKeyEvent& event )
 		case 'S':
 		{
 			wxPoint mousePos = event.GetPosition();
-			int id = Render( GL_SELECT, &mousePos );
+			int id = Pick( mousePos );
 			kinematicGraph->SetSelectedId( id );
 			Refresh();
 			break;
@@ -86,8 +113,10 @@ void KinematicGraphCanvas::OnMouseRightDown( wxMouseEvent& event )
 	KinematicGraph* kinematicGraph = wxGetApp().GetKinematicGraph();
 	if( kinematicGraph )
 	{
+		StopDragging();
+
 		wxPoint mousePos = event.GetPosition();
-		int id = Render( GL_SELECT, &mousePos );
+		int id = Pick( mousePos );
 		kinematicGraph->SetVertexStationary( id, !kinematicGraph->GetVertexStationary( id ) );
 		Refresh();
 	}
@@ -98,11 +127,16 @@ void KinematicGraphCanvas::OnMouseLeftDown( wxMouseEvent& event )
 	KinematicGraph* kinematicGraph = wxGetApp().GetKinematicGraph();
 	if( kinematicGraph )
 	{
+		StopDragging();
+
 		wxPoint mousePos = event.GetPosition();
-		int id = Render( GL_SELECT, &mousePos );
+		int id = Pick( mousePos );
 		kinematicGraph->SetSelectedId( id );
-		dragging = true;
-		Refresh();
+
+		// Bring the drawing up to date while the graph is still ours.
+		Render();
+
+		dragSolver->Start( kinematicGraph, id );
 	}
 }
 
@@ -111,8 +145,9 @@ void KinematicGraphCanvas::OnMouseLeftUp( wxMouseEvent& event )
 	KinematicGraph* kinematicGraph = wxGetApp().GetKinematicGraph();
 	if( kinematicGraph )
 	{
+		StopDragging();
+
 		kinematicGraph->SetSelectedId(0);
-		dragging = false;
 		Refresh();
 	}
 }
@@ -122,16 +157,8 @@ void KinematicGraphCanvas::OnMouseMotion( wxMouseEvent& event )
 	mouseLocation = LocatePoint( event.GetPosition() );
 
 	KinematicGraph* kinematicGraph = wxGetApp().GetKinematicGraph();
-	if( kinematicGraph && dragging )
-	{
-		c3ga::vectorE3GA vertexLocation;
-		int vertexId = kinematicGraph->GetSelectedId();
-		if( kinematicGraph->GetVertexLocation( vertexId, vertexLocation ) )
-		{
-			c3ga::vectorE3GA delta = mouseLocation - vertexLocation;
-			kinematicGraph->MoveVertex( vertexId, delta );
-		}
-	}
+	if( kinematicGraph && dragSolver->IsDragging() )
+		dragSolver->SetTarget( mouseLocation );
 
 	Refresh();
 }
@@ -184,21 +211,29 @@ c3ga::vectorE3GA KinematicGraphCanvas::LocatePoint( const wxPoint& point )
 	return location;
 }
 
-int KinematicGraphCanvas::Render( GLenum renderMode, const wxPoint* mousePos /*= nullptr*/ )
+// Picking is done against the graph's spatial index rather than by
+// rendering in selection mode, which many drivers emulate in software.
+int KinematicGraphCanvas::Pick( const wxPoint& point )
 {
+	KinematicGraph* kinematicGraph = wxGetApp().GetKinematicGraph();
+	if( !kinematicGraph )
+		return 0;
+
 	BindContext();
 
-	int hitId = 0;
-	int hitBufferSize = 512;
-	unsigned int* hitBuffer = nullptr;
-	if( renderMode == GL_SELECT )
-	{
-		hitBuffer = new unsigned int[ hitBufferSize ];
-		glSelectBuffer( hitBufferSize, hitBuffer );
-		glRenderMode( GL_SELECT );
-		glInitNames();
-		glPushName(0);
-	}
+	Window aspectCorrectedWindow;
+	CalcAspectCorrectedWindow( aspectCorrectedWindow );
+
+	GLint viewport[4];
+	glGetIntegerv( GL_VIEWPORT, viewport );
+
+	double radius = PICK_RADIUS * double( aspectCorrectedWindow.xMax - aspectCorrectedWindow.xMin ) / double( viewport[2] );
+	return kinematicGraph->PickElement( LocatePoint( point ), radius );
+}
+
+void KinematicGraphCanvas::Render( void )
+{
+	BindContext();
 
 	glClearColor( 1.f, 1.f, 1.f, 1.f );
 	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
@@ -206,13 +241,6 @@ int KinematicGraphCanvas::Render( GLenum renderMode, const wxPoint* mousePos /*=
 	glMatrixMode( GL_PROJECTION );
 	glLoadIdentity();
 
-	if( renderMode == GL_SELECT )
-	{
-		GLint viewport[4];
-		glGetIntegerv( GL_VIEWPORT, viewport );
-		gluPickMatrix( GLdouble( mousePos->x ), GLdouble( viewport[3] - mousePos->y - 1 ), 10.0, 10.0, viewport );
-	}
-
 	Window aspectCorrectedWindow;
 	CalcAspectCorrectedWindow( aspectCorrectedWindow );
 	gluOrtho2D( aspectCorrectedWindow.xMin, aspectCorrectedWindow.xMax,
@@ -223,51 +251,19 @@ int KinematicGraphCanvas::Render( GLenum renderMode, const wxPoint* mousePos /*=
 
 	KinematicGraph* kinematicGraph = wxGetApp().GetKinematicGraph();
 	if( kinematicGraph )
-		kinematicGraph->Render( renderMode );
+		renderer->Render( kinematicGraph, dragSolver );
 
-	if( renderMode == GL_RENDER )
-	{
-		glColor3f( 1.f, 0.f, 0.f );
-		glLineWidth( 1.f );
-		glBegin( GL_LINE_LOOP );
-		glVertex3f( mouseLocation.get_e1() + 0.1f, mouseLocation.get_e2(), mouseLocation.get_e3() );
-		glVertex3f( mouseLocation.get_e1(), mouseLocation.get_e2() + 0.1f, mouseLocation.get_e3() );
-		glVertex3f( mouseLocation.get_e1() - 0.1f, mouseLocation.get_e2(), mouseLocation.get_e3() );
-		glVertex3f( mouseLocation.get_e1(), mouseLocation.get_e2() - 0.1f, mouseLocation.get_e3() );
-		glEnd();
-	}
+	glColor3f( 1.f, 0.f, 0.f );
+	glLineWidth( 1.f );
+	glBegin( GL_LINE_LOOP );
+	glVertex3f( mouseLocation.get_e1() + 0.1f, mouseLocation.get_e2(), mouseLocation.get_e3() );
+	glVertex3f( mouseLocation.get_e1(), mouseLocation.get_e2() + 0.1f, mouseLocation.get_e3() );
+	glVertex3f( mouseLocation.get_e1() - 0.1f, mouseLocation.get_e2(), mouseLocation.get_e3() );
+	glVertex3f( mouseLocation.get_e1(), mouseLocation.get_e2() - 0.1f, mouseLocation.get_e3() );
+	glEnd();
 
 	glFlush();
-
-	if( renderMode == GL_RENDER )
-		SwapBuffers();
-	else if( renderMode == GL_SELECT )
-	{
-		int hitCount = glRenderMode( GL_RENDER );
-		float smallestZ = 999.f;
-		unsigned int* hitRecord = hitBuffer;
-		for( int hit = 0; hit < hitCount; hit++ )
-		{
-			unsigned int nameCount = hitRecord[0];
-			wxASSERT( nameCount == 1 );
-			if( nameCount == 1 )
-			{
-				int id = hitRecord[3];
-				float minZ = float( hitRecord[1] ) / float( 0x7FFFFFFF );
-				if( minZ < smallestZ )
-				{
-					smallestZ = minZ;
-					hitId = id;
-				}
-			}
-
-			hitRecord += 3 + nameCount;
-		}
-
-		delete[] hitBuffer;
-	}
-
-	return hitId;
+	SwapBuffers();
 }
 
 void KinematicGraphCanvas::OnSize( wxSizeEvent& event )
@@ -5,6 +5,9 @@
 #include <wx/glcanvas.h>
 #include "C3GA/c3ga.h"
 
+class KinematicGraphRenderer;
+class DragSolver;
+
 class KinematicGraphCanvas : public wxGLCanvas
 {
 public:
@@ -19,11 +22,19 @@ public:
 	void OnMouseMotion( wxMouseEvent& event );
 	void OnMouseRightDown( wxMouseEvent& event );
 	void OnCharHook( wxKeyEvent& event );
+	void OnSolvePublished( wxThreadEvent& event );
+
+	// Wait for the vertex being dragged, if any, to reach the mouse.
+	void StopDragging( void );
 
 private:
 
+	// Elements this many pixels from the mouse are picked.
+	enum { PICK_RADIUS = 5 };
+
 	void BindContext( void );
-	int Render( GLenum renderMode, const wxPoint* mousePos = nullptr );
+	void Render( void );
+	int Pick( const wxPoint& point );
 
 	struct Window
 	{
@@ -36,8 +47,9 @@ private:
 
 	c3ga::vectorE3GA mouseLocation;
 	Window window;
-	bool dragging;
 	wxGLContext* context;
+	KinematicGraphRenderer* renderer;
+	DragSolver* dragSolver;
 	static int attributeList[];
 };
 
@@ -4,7 +4,12 @@
 #include "KinematicGraphCanvas.h"
 #include "KinematicGraph.h"
 #include "KinematicGraphApp.h"
+#include "GraphFile.h"
+#include "GraphTextFile.h"
+#include "SolveRecorder.h"
 #include <wx/menu.h>
+#include <wx/filedlg.h>
+#include <wx/msgdlg.h>
 #include <wx/sizer.h>
 #include <wx/aboutdlg.h>
 
@@ -12,9 +17,19 @@ KinematicGraphFrame::KinematicGraphFrame( wxWindow* parent, const wxPoint& pos,
 {
 	wxMenu* programMenu = new wxMenu();
 	wxMenuItem* clearMenuItem = new wxMenuItem( programMenu, ID_Clear, "Clear", "Clear the graph." );
+	wxMenuItem* openMenuItem = new wxMenuItem( programMenu, ID_Open, "Open...", "Load a graph from a file." );
+	wxMenuItem* saveMenuItem = new wxMenuItem( programMenu, ID_Save, "Save...", "Save the graph to a file." );
+	wxMenuItem* recordMenuItem = new wxMenuItem( programMenu, ID_Record, "Record", "Record changes to the graph so that they can be replayed.", wxITEM_CHECK );
+	wxMenuItem* saveRecordingMenuItem = new wxMenuItem( programMenu, ID_SaveRecording, "Save Recording...", "Save the latest recorded changes to a file." );
 	wxMenuItem* exitMenuItem = new wxMenuItem( programMenu, ID_Exit, "Exit", "Exit this program." );
 	programMenu->Append( clearMenuItem );
 	programMenu->AppendSeparator();
+	programMenu->Append( openMenuItem );
+	programMenu->Append( saveMenuItem );
+	programMenu->AppendSeparator();
+	programMenu->Append( recordMenuItem );
+	programMenu->Append( saveRecordingMenuItem );
+	programMenu->AppendSeparator();
 	programMenu->Append( exitMenuItem );
 
 	wxMenu* helpMenu = new wxMenu();
@@ -27,18 +42,30 @@ KinematicGraphFrame::KinematicGraphFrame( wxWindow* parent, const wxPoint& pos,
 	SetMenuBar( menuBar );
 
 	canvas = new KinematicGraphCanvas( this );
+	recorder = nullptr;
 
 	wxBoxSizer* boxSizer = new wxBoxSizer( wxVERTICAL );
 	boxSizer->Add( canvas, 1, wxALL | wxGROW, 0 );
 	SetSizer( boxSizer );
 
 	Bind( wxEVT_MENU, &KinematicGraphFrame::OnClear, this, ID_Clear );
+	Bind( wxEVT_MENU, &KinematicGraphFrame::OnOpen, this, ID_Open );
+	Bind( wxEVT_MENU, &KinematicGraphFrame::OnSave, this, ID_Save );
+	Bind( wxEVT_MENU, &KinematicGraphFrame::OnRecord, this, ID_Record );
+	Bind( wxEVT_MENU, &KinematicGraphFrame::OnSaveRecording, this, ID_SaveRecording );
 	Bind( wxEVT_MENU, &KinematicGraphFrame::OnExit, this, ID_Exit );
 	Bind( wxEVT_MENU, &KinematicGraphFrame::OnAbout, this, ID_About );
 }
 
 /*virtual*/ KinematicGraphFrame::~KinematicGraphFrame( void )
 {
+	canvas->StopDragging();
+
+	KinematicGraph* kinematicGraph = wxGetApp().GetKinematicGraph();
+	if( kinematicGraph && kinematicGraph->GetRecorder() == recorder )
+		kinematicGraph->SetRecorder( nullptr );
+
+	delete recorder;
 }
 
 void KinematicGraphFrame::OnExit( wxCommandEvent& event )
@@ -48,11 +75,107 @@ void KinematicGraphFrame::OnExit( wxCommandEvent& event )
 
 void KinematicGraphFrame::OnClear( wxCommandEvent& event )
 {
+	canvas->StopDragging();
+
 	KinematicGraph* kinematicGraph = wxGetApp().GetKinematicGraph();
 	kinematicGraph->Clear();
 	Refresh();
 }
 
+// Graphs are saved in the binary format unless given the text extension.
+/*static*/ const char* KinematicGraphFrame::fileWildcard = "Kinematic graph files (*.kgraph)|*.kgraph|Kinematic graph text files (*.kgtxt)|*.kgtxt";
+
+/*static*/ bool KinematicGraphFrame::IsTextPath( const wxString& path )
+{
+	return path.Lower().EndsWith( ".kgtxt" );
+}
+
+void KinematicGraphFrame::OnOpen( wxCommandEvent& event )
+{
+	canvas->StopDragging();
+
+	wxFileDialog fileDialog( this, "Open Graph", wxEmptyString, wxEmptyString, fileWildcard, wxFD_OPEN | wxFD_FILE_MUST_EXIST );
+	if( fileDialog.ShowModal() != wxID_OK )
+		return;
+
+	KinematicGraph* kinematicGraph = wxGetApp().GetKinematicGraph();
+	wxString path = fileDialog.GetPath();
+
+	if( IsTextPath( path ) )
+	{
+		int errorLine = 0;
+		if( !GraphTextFile::Read( *kinematicGraph, path.mb_str(), errorLine ) )
+		{
+			if( errorLine > 0 )
+				wxMessageBox( wxString::Format( "Failed to load \"%s\": error on line %d.", path, errorLine ), "Error", wxOK | wxICON_ERROR, this );
+			else
+				wxMessageBox( "Failed to load \"" + path + "\".", "Error", wxOK | wxICON_ERROR, this );
+		}
+	}
+	else
+	{
+		GraphFile graphFile;
+		if( !graphFile.Open( path.mb_str() ) || !graphFile.Load( *kinematicGraph ) )
+			wxMessageBox( "Failed to load \"" + path + "\".", "Error", wxOK | wxICON_ERROR, this );
+	}
+
+	Refresh();
+}
+
+void KinematicGraphFrame::OnSave( wxCommandEvent& event )
+{
+	canvas->StopDragging();
+
+	wxFileDialog fileDialog( this, "Save Graph", wxEmptyString, wxEmptyString, fileWildcard, wxFD_SAVE | wxFD_OVERWRITE_PROMPT );
+	if( fileDialog.ShowModal() != wxID_OK )
+		return;
+
+	KinematicGraph* kinematicGraph = wxGetApp().GetKinematicGraph();
+	wxString path = fileDialog.GetPath();
+
+	bool saved = IsTextPath( path ) ? GraphTextFile::Write( *kinematicGraph, path.mb_str() ) : GraphFile::Write( *kinematicGraph, path.mb_str() );
+	if( !saved )
+		wxMessageBox( "Failed to save \"" + path + "\".", "Error", wxOK | wxICON_ERROR, this );
+}
+
+// The recorder keeps the latest stretch of changes, so recording can be
+// left on and saved once something worth reproducing has happened.
+void KinematicGraphFrame::OnRecord( wxCommandEvent& event )
+{
+	canvas->StopDragging();
+
+	KinematicGraph* kinematicGraph = wxGetApp().GetKinematicGraph();
+	if( !event.IsChecked() )
+	{
+		kinematicGraph->SetRecorder( nullptr );
+		return;
+	}
+
+	if( !recorder )
+		recorder = new SolveRecorder();
+
+	kinematicGraph->SetRecorder( recorder );
+}
+
+void KinematicGraphFrame::OnSaveRecording( wxCommandEvent& event )
+{
+	canvas->StopDragging();
+
+	if( !recorder || recorder->GetSegmentCount() == 0 )
+	{
+		wxMessageBox( "Nothing has been recorded.", "Error", wxOK | wxICON_ERROR, this );
+		return;
+	}
+
+	wxFileDialog fileDialog( this, "Save Recording", wxEmptyString, wxEmptyString, "Kinematic graph recordings (*.kgrec)|*.kgrec", wxFD_SAVE | wxFD_OVERWRITE_PROMPT );
+	if( fileDialog.ShowModal() != wxID_OK )
+		return;
+
+	wxString path = fileDialog.GetPath();
+	if( !recorder->Write( path.mb_str() ) )
+		wxMessageBox( "Failed to save \"" + path + "\".", "Error", wxOK | wxICON_ERROR, this );
+}
+
 void KinematicGraphFrame::OnAbout( wxCommandEvent& event )
 {
 	wxAboutDialogInfo aboutDialogInfo;
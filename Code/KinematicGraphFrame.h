@@ -5,6 +5,7 @@
 #include <wx/frame.h>
 
 class KinematicGraphCanvas;
+class SolveRecorder;
 
 class KinematicGraphFrame : public wxFrame
 {
@@ -19,14 +20,26 @@ private:
 	{
 		ID_Exit = wxID_HIGHEST,
 		ID_Clear,
+		ID_Open,
+		ID_Save,
+		ID_Record,
+		ID_SaveRecording,
 		ID_About,
 	};
 
 	void OnExit( wxCommandEvent& event );
 	void OnClear( wxCommandEvent& event );
+	void OnOpen( wxCommandEvent& event );
+	void OnSave( wxCommandEvent& event );
+	void OnRecord( wxCommandEvent& event );
+	void OnSaveRecording( wxCommandEvent& event );
 	void OnAbout( wxCommandEvent& event );
 
+	static bool IsTextPath( const wxString& path );
+	static const char* fileWildcard;
+
 	KinematicGraphCanvas* canvas;
+	SolveRecorder* recorder;
 };
 
 // KinematicGraphFrame.h
\ No newline at end of file
@@ -0,0 +1,255 @@
+// KinematicGraphRenderer.cpp
+
+#include "KinematicGraphRenderer.h"
+#include "KinematicGraph.h"
+#include "DragSolver.h"
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+
+#if defined( _WIN32 )
+#	define GetProcAddressGL( name ) wglGetProcAddress( name )
+#else
+#	include <GL/glx.h>
+#	define GetProcAddressGL( name ) glXGetProcAddressARB( ( const GLubyte* )( name ) )
+#endif
+
+// Buffer objects are core in OpenGL 1.5, which the system headers may predate.
+#if !defined( GL_ARRAY_BUFFER )
+#	define GL_ARRAY_BUFFER				0x8892
+#	define GL_ELEMENT_ARRAY_BUFFER		0x8893
+#	define GL_STATIC_DRAW				0x88E4
+#endif
+
+KinematicGraphRenderer::KinematicGraphRenderer( void )
+{
+	functionsLoaded = false;
+	glGenBuffersProc = nullptr;
+	glDeleteBuffersProc = nullptr;
+	glBindBufferProc = nullptr;
+	glBufferDataProc = nullptr;
+	glBufferSubDataProc = nullptr;
+
+	vertexBuffer = 0;
+	edgeBuffer = 0;
+	ringBuffer = 0;
+
+	float radius = 0.15f;
+	for( int i = 0; i < RING_SEGMENTS; i++ )
+	{
+		float angle = float(i) / float( RING_SEGMENTS ) * 2.f * M_PI;
+		ringOffsetArray[ 2 * i ] = radius * cos( angle );
+		ringOffsetArray[ 2 * i + 1 ] = radius * sin( angle );
+	}
+}
+
+// The buffers belong to the canvas's context, which must be current here
+// if they are to be freed before it is.
+KinematicGraphRenderer::~KinematicGraphRenderer( void )
+{
+	if( vertexBuffer )
+	{
+		GLuint bufferArray[3] = { vertexBuffer, edgeBuffer, ringBuffer };
+		glDeleteBuffersProc( 3, bufferArray );
+	}
+}
+
+void KinematicGraphRenderer::LoadBufferFunctions( void )
+{
+	functionsLoaded = true;
+
+	glGenBuffersProc = ( GenBuffersProc )GetProcAddressGL( "glGenBuffers" );
+	glDeleteBuffersProc = ( DeleteBuffersProc )GetProcAddressGL( "glDeleteBuffers" );
+	glBindBufferProc = ( BindBufferProc )GetProcAddressGL( "glBindBuffer" );
+	glBufferDataProc = ( BufferDataProc )GetProcAddressGL( "glBufferData" );
+	glBufferSubDataProc = ( BufferSubDataProc )GetProcAddressGL( "glBufferSubData" );
+
+	// Looking a function up can succeed on a context too old to provide it.
+	const char* version = ( const char* )glGetString( GL_VERSION );
+	int majorVersion = 0, minorVersion = 0;
+	if( version )
+		sscanf( version, "%d.%d", &majorVersion, &minorVersion );
+
+	if( majorVersion * 10 + minorVersion < 15 || !glGenBuffersProc || !glDeleteBuffersProc || !glBindBufferProc || !glBufferDataProc || !glBufferSubDataProc )
+		return;
+
+	GLuint bufferArray[3];
+	glGenBuffersProc( 3, bufferArray );
+	vertexBuffer = bufferArray[0];
+	edgeBuffer = bufferArray[1];
+	ringBuffer = bufferArray[2];
+}
+
+void KinematicGraphRenderer::RebuildArrays( const KinematicGraph* kinematicGraph )
+{
+	int vertexCount = ( int )kinematicGraph->vertexIdArray.size();
+	vertexArray.resize( 2 * vertexCount );
+	for( int vertex = 0; vertex < vertexCount; vertex++ )
+	{
+		const KinematicGraph::Vector& location = kinematicGraph->vertexLocationArray[ vertex ];
+		vertexArray[ 2 * vertex ] = float( location.get_e1() );
+		vertexArray[ 2 * vertex + 1 ] = float( location.get_e2() );
+	}
+
+	edgeArray.assign( kinematicGraph->edgeVertexArray.begin(), kinematicGraph->edgeVertexArray.end() );
+
+	// Stations stay put during solves, so their rings are only laid out here.
+	ringArray.clear();
+	for( int vertex = 0; vertex < vertexCount; vertex++ )
+	{
+		if( !kinematicGraph->vertexStationaryArray[ vertex ] )
+			continue;
+
+		const KinematicGraph::Vector& station = kinematicGraph->vertexStationArray[ vertex ];
+		float centerX = float( station.get_e1() );
+		float centerY = float( station.get_e2() );
+		for( int i = 0; i < RING_SEGMENTS; i++ )
+		{
+			int j = ( i + 1 ) % RING_SEGMENTS;
+			ringArray.push_back( centerX + ringOffsetArray[ 2 * i ] );
+			ringArray.push_back( centerY + ringOffsetArray[ 2 * i + 1 ] );
+			ringArray.push_back( centerX + ringOffsetArray[ 2 * j ] );
+			ringArray.push_back( centerY + ringOffsetArray[ 2 * j + 1 ] );
+		}
+	}
+}
+
+void KinematicGraphRenderer::UploadArray( GLenum target, GLuint buffer, const void* data, size_t size )
+{
+	if( !buffer )
+		return;
+
+	glBindBufferProc( target, buffer );
+	glBufferDataProc( target, ptrdiff_t( size ), size ? data : nullptr, GL_STATIC_DRAW );
+	glBindBufferProc( target, 0 );
+}
+
+void KinematicGraphRenderer::UpdateBuffers( KinematicGraph* kinematicGraph )
+{
+	if( !functionsLoaded )
+		LoadBufferFunctions();
+
+	if( kinematicGraph->drawingDirty )
+	{
+		RebuildArrays( kinematicGraph );
+
+		UploadArray( GL_ARRAY_BUFFER, vertexBuffer, vertexArray.data(), vertexArray.size() * sizeof( float ) );
+		UploadArray( GL_ELEMENT_ARRAY_BUFFER, edgeBuffer, edgeArray.data(), edgeArray.size() * sizeof( GLuint ) );
+		UploadArray( GL_ARRAY_BUFFER, ringBuffer, ringArray.data(), ringArray.size() * sizeof( float ) );
+	}
+	else if( kinematicGraph->movedVertexBegin < kinematicGraph->movedVertexEnd )
+	{
+		int begin = kinematicGraph->movedVertexBegin;
+		int end = std::min( kinematicGraph->movedVertexEnd, ( int )kinematicGraph->vertexIdArray.size() );
+		for( int vertex = begin; vertex < end; vertex++ )
+		{
+			const KinematicGraph::Vector& location = kinematicGraph->vertexLocationArray[ vertex ];
+			vertexArray[ 2 * vertex ] = float( location.get_e1() );
+			vertexArray[ 2 * vertex + 1 ] = float( location.get_e2() );
+		}
+
+		UpdateVertexBuffer( begin, end );
+	}
+
+	kinematicGraph->drawingDirty = false;
+	kinematicGraph->movedVertexBegin = 0;
+	kinematicGraph->movedVertexEnd = 0;
+}
+
+void KinematicGraphRenderer::UpdateVertexBuffer( int firstVertex, int endVertex )
+{
+	if( !vertexBuffer || firstVertex >= endVertex )
+		return;
+
+	glBindBufferProc( GL_ARRAY_BUFFER, vertexBuffer );
+	glBufferSubDataProc( GL_ARRAY_BUFFER, ptrdiff_t( 2 * firstVertex * sizeof( float ) ), ptrdiff_t( 2 * ( endVertex - firstVertex ) * sizeof( float ) ), &vertexArray[ 2 * firstVertex ] );
+	glBindBufferProc( GL_ARRAY_BUFFER, 0 );
+}
+
+// Bind the buffer if there is one and return what the array pointer
+// functions expect: an offset into the buffer, or else the client copy.
+const void* KinematicGraphRenderer::BindArray( GLenum target, GLuint buffer, const void* data )
+{
+	if( !buffer )
+		return data;
+
+	glBindBufferProc( target, buffer );
+	return nullptr;
+}
+
+void KinematicGraphRenderer::Render( KinematicGraph* kinematicGraph, DragSolver* dragSolver )
+{
+	// The solver thread is moving the vertices, so the graph's own arrays
+	// are left alone until the drag stops.  Nothing else changes meanwhile.
+	if( dragSolver && dragSolver->IsDragging() )
+	{
+		int firstVertex = 0, endVertex = 0;
+		if( dragSolver->TakeSnapshot( vertexArray, firstVertex, endVertex ) )
+			UpdateVertexBuffer( firstVertex, endVertex );
+	}
+	else
+		UpdateBuffers( kinematicGraph );
+
+	int vertexCount = ( int )vertexArray.size() / 2;
+	int edgeCount = ( int )edgeArray.size() / 2;
+	int ringVertexCount = ( int )ringArray.size() / 2;
+
+	// Solves leave the handle table alone, so it can be read during a drag.
+	int selectedVertex = kinematicGraph->FindVertex( kinematicGraph->selectedId );
+	int selectedEdge = kinematicGraph->FindEdge( kinematicGraph->selectedId );
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+
+	const float* vertexPointer = ( const float* )BindArray( GL_ARRAY_BUFFER, vertexBuffer, vertexArray.data() );
+	glVertexPointer( 2, GL_FLOAT, 0, vertexPointer );
+
+	// Draw all edges first.
+	if( edgeCount > 0 )
+	{
+		const GLuint* edgePointer = ( const GLuint* )BindArray( GL_ELEMENT_ARRAY_BUFFER, edgeBuffer, edgeArray.data() );
+
+		glLineWidth( 2.f );
+		glColor3f( 0.f, 0.f, 0.f );
+		glDrawElements( GL_LINES, 2 * edgeCount, GL_UNSIGNED_INT, edgePointer );
+
+		if( selectedEdge >= 0 )
+		{
+			glColor3f( 1.f, 0.f, 0.f );
+			glDrawElements( GL_LINES, 2, GL_UNSIGNED_INT, edgePointer + 2 * selectedEdge );
+		}
+
+		if( edgeBuffer )
+			glBindBufferProc( GL_ELEMENT_ARRAY_BUFFER, 0 );
+	}
+
+	// Draw all vertices last.
+	if( vertexCount > 0 )
+	{
+		glPointSize( 10.f );
+		glColor3f( 0.f, 0.f, 0.f );
+		glDrawArrays( GL_POINTS, 0, vertexCount );
+
+		if( selectedVertex >= 0 )
+		{
+			glColor3f( 1.f, 0.f, 0.f );
+			glDrawArrays( GL_POINTS, selectedVertex, 1 );
+		}
+	}
+
+	if( ringVertexCount > 0 )
+	{
+		const float* ringPointer = ( const float* )BindArray( GL_ARRAY_BUFFER, ringBuffer, ringArray.data() );
+		glVertexPointer( 2, GL_FLOAT, 0, ringPointer );
+
+		glLineWidth( 1.5f );
+		glColor3f( 1.f, 0.f, 0.f );
+		glDrawArrays( GL_LINES, 0, ringVertexCount );
+	}
+
+	if( vertexBuffer )
+		glBindBufferProc( GL_ARRAY_BUFFER, 0 );
+
+	glDisableClientState( GL_VERTEX_ARRAY );
+}
+
+// KinematicGraphRenderer.cpp
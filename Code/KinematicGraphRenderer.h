@@ -0,0 +1,72 @@
+// KinematicGraphRenderer.h
+
+#pragma once
+
+#include <wx/glcanvas.h>
+#include "C3GA/c3ga.h"
+#include <stddef.h>
+#include <vector>
+
+class KinematicGraph;
+class DragSolver;
+
+// This adapter draws a kinematic graph with OpenGL so that the graph
+// itself need not know anything about wxWidgets or OpenGL.
+//
+// The drawing is retained: vertex locations, edge vertex pairs and the
+// rings marking stations are kept in buffer objects, and the whole graph is
+// drawn in three calls, plus one for a selected element.  After a solve
+// only the range of vertex slots it may have moved is uploaded again; any
+// other change to the graph rebuilds the buffers.  Where buffer objects are
+// not available, the same arrays are drawn from client memory.  While a
+// drag solver has the graph, the vertex locations come from its snapshots.
+class KinematicGraphRenderer
+{
+public:
+
+	KinematicGraphRenderer( void );
+	~KinematicGraphRenderer( void );
+
+	// The graph is told that its changes have been drawn.  The canvas's
+	// context must be current.
+	void Render( KinematicGraph* kinematicGraph, DragSolver* dragSolver );
+
+private:
+
+	enum { RING_SEGMENTS = 16 };
+
+	typedef void ( APIENTRY* GenBuffersProc )( GLsizei count, GLuint* buffers );
+	typedef void ( APIENTRY* DeleteBuffersProc )( GLsizei count, const GLuint* buffers );
+	typedef void ( APIENTRY* BindBufferProc )( GLenum target, GLuint buffer );
+	typedef void ( APIENTRY* BufferDataProc )( GLenum target, ptrdiff_t size, const void* data, GLenum usage );
+	typedef void ( APIENTRY* BufferSubDataProc )( GLenum target, ptrdiff_t offset, ptrdiff_t size, const void* data );
+
+	void LoadBufferFunctions( void );
+	void UpdateBuffers( KinematicGraph* kinematicGraph );
+	void UpdateVertexBuffer( int firstVertex, int endVertex );
+	void RebuildArrays( const KinematicGraph* kinematicGraph );
+	void UploadArray( GLenum target, GLuint buffer, const void* data, size_t size );
+	const void* BindArray( GLenum target, GLuint buffer, const void* data );
+
+	bool functionsLoaded;
+	GenBuffersProc glGenBuffersProc;
+	DeleteBuffersProc glDeleteBuffersProc;
+	BindBufferProc glBindBufferProc;
+	BufferDataProc glBufferDataProc;
+	BufferSubDataProc glBufferSubDataProc;
+
+	// The buffers are zero when drawing from client memory.
+	GLuint vertexBuffer;
+	GLuint edgeBuffer;
+	GLuint ringBuffer;
+
+	// Client copies of the buffers: the e1-e2 location of each vertex slot,
+	// the vertex slots of each edge slot, and line segments around each station.
+	std::vector< float > vertexArray;
+	std::vector< GLuint > edgeArray;
+	std::vector< float > ringArray;
+
+	float ringOffsetArray[ 2 * RING_SEGMENTS ];
+};
+
+// KinematicGraphRenderer.h
@@ -0,0 +1,63 @@
+// NodeArena.cpp
+
+#include "NodeArena.h"
+#include <new>
+
+NodeArena::NodeArena( void )
+{
+	slabOffset = SLAB_SIZE;
+	for( int i = 0; i < MAX_BLOCK_SIZE / ALIGNMENT; i++ )
+		freeListArray[i] = nullptr;
+}
+
+NodeArena::~NodeArena( void )
+{
+	for( int i = 0; i < ( int )slabArray.size(); i++ )
+		::operator delete( slabArray[i] );
+}
+
+void* NodeArena::Allocate( size_t size )
+{
+	if( size == 0 || size > MAX_BLOCK_SIZE )
+		return ::operator new( size );
+
+	int sizeClass = CalcSizeClass( size );
+	FreeBlock* freeBlock = freeListArray[ sizeClass ];
+	if( freeBlock )
+	{
+		freeListArray[ sizeClass ] = freeBlock->next;
+		return freeBlock;
+	}
+
+	// Block sizes are multiples of ALIGNMENT, so blocks carved from a slab
+	// are aligned as well as the slab itself, up to ALIGNMENT.
+	size_t blockSize = size_t( sizeClass + 1 ) * ALIGNMENT;
+	if( slabOffset + blockSize > SLAB_SIZE )
+	{
+		slabArray.push_back( static_cast< char* >( ::operator new( SLAB_SIZE ) ) );
+		slabOffset = 0;
+	}
+
+	void* block = slabArray.back() + slabOffset;
+	slabOffset += blockSize;
+	return block;
+}
+
+void NodeArena::Free( void* block, size_t size )
+{
+	if( !block )
+		return;
+
+	if( size == 0 || size > MAX_BLOCK_SIZE )
+	{
+		::operator delete( block );
+		return;
+	}
+
+	int sizeClass = CalcSizeClass( size );
+	FreeBlock* freeBlock = static_cast< FreeBlock* >( block );
+	freeBlock->next = freeListArray[ sizeClass ];
+	freeListArray[ sizeClass ] = freeBlock;
+}
+
+// NodeArena.cpp
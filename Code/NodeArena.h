@@ -0,0 +1,78 @@
+// NodeArena.h
+
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+
+// Hands out small blocks carved from large slabs, keeping a free list per
+// block size so that freed blocks are reused before the slabs grow.  The
+// slabs go back to the heap only when the arena is destroyed, so a
+// container that repeatedly fills up and empties stops allocating once it
+// has reached its largest size.  Blocks larger than MAX_BLOCK_SIZE come
+// straight from the heap.  Not thread-safe.
+class NodeArena
+{
+public:
+
+	enum
+	{
+		ALIGNMENT = 16,
+		MAX_BLOCK_SIZE = 256,
+		SLAB_SIZE = 64 * 1024,
+	};
+
+	NodeArena( void );
+	~NodeArena( void );
+
+	void* Allocate( size_t size );
+	void Free( void* block, size_t size );
+
+	size_t GetSlabBytes( void ) const { return slabArray.size() * SLAB_SIZE; }
+
+private:
+
+	NodeArena( const NodeArena& );
+	NodeArena& operator=( const NodeArena& );
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	static int CalcSizeClass( size_t size ) { return int( ( size + ALIGNMENT - 1 ) / ALIGNMENT ) - 1; }
+
+	std::vector< char* > slabArray;
+	size_t slabOffset;
+	FreeBlock* freeListArray[ MAX_BLOCK_SIZE / ALIGNMENT ];
+};
+
+// A standard allocator drawing from a node arena, for node-based containers
+// such as std::map.  Copies (including rebound ones) share the arena.
+template< typename T >
+class NodeAllocator
+{
+public:
+
+	typedef T value_type;
+
+	NodeAllocator( NodeArena* nodeArena ) : nodeArena( nodeArena ) {}
+
+	template< typename U >
+	NodeAllocator( const NodeAllocator< U >& allocator ) : nodeArena( allocator.nodeArena ) {}
+
+	T* allocate( size_t count ) { return static_cast< T* >( nodeArena->Allocate( count * sizeof( T ) ) ); }
+	void deallocate( T* block, size_t count ) { nodeArena->Free( block, count * sizeof( T ) ); }
+
+	template< typename U >
+	struct rebind { typedef NodeAllocator< U > other; };
+
+	template< typename U >
+	bool operator==( const NodeAllocator< U >& allocator ) const { return nodeArena == allocator.nodeArena; }
+	template< typename U >
+	bool operator!=( const NodeAllocator< U >& allocator ) const { return nodeArena != allocator.nodeArena; }
+
+	NodeArena* nodeArena;
+};
+
+// NodeArena.h
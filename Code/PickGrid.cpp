@@ -0,0 +1,441 @@
+// PickGrid.cpp
+
+#include "PickGrid.h"
+#include "KinematicGraph.h"
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+
+PickGrid::PickGrid( void )
+{
+	stale = true;
+	builtElementCount = 0;
+	cellSize = 1.0;
+	inverseCellSize = 1.0;
+	tableShift = 64;
+}
+
+PickGrid::~PickGrid( void )
+{
+}
+
+// Cell coordinates are clamped well inside the range of an int, which also
+// puts a vertex at an infinite or undefined location somewhere harmless.
+int PickGrid::CalcCellCoordinate( double coordinate ) const
+{
+	double cell = floor( coordinate * inverseCellSize );
+	if( !( cell > -1e9 ) )
+		cell = -1e9;
+	else if( cell > 1e9 )
+		cell = 1e9;
+
+	return int( cell );
+}
+
+unsigned long long PickGrid::CalcCellKey( int cellX, int cellY ) const
+{
+	return ( ( unsigned long long )( unsigned int )cellX << 32 ) | ( unsigned int )cellY;
+}
+
+int PickGrid::FindCell( unsigned long long key ) const
+{
+	int mask = ( int )tableArray.size() - 1;
+	int slot = int( ( key * 0x9E3779B97F4A7C15ULL ) >> tableShift );
+	while( true )
+	{
+		int cell = tableArray[ slot ];
+		if( cell < 0 || cellArray[ cell ].key == key )
+			return cell;
+
+		slot = ( slot + 1 ) & mask;
+	}
+}
+
+// Cells are never taken out of the table, but the grid is rebuilt before
+// empty ones can pile up.  The table is kept at most half full.
+int PickGrid::InsertCell( unsigned long long key )
+{
+	if( 2 * cellArray.size() >= tableArray.size() )
+		GrowTable();
+
+	int mask = ( int )tableArray.size() - 1;
+	int slot = int( ( key * 0x9E3779B97F4A7C15ULL ) >> tableShift );
+	while( tableArray[ slot ] >= 0 )
+	{
+		if( cellArray[ tableArray[ slot ] ].key == key )
+			return tableArray[ slot ];
+
+		slot = ( slot + 1 ) & mask;
+	}
+
+	Cell cell;
+	cell.key = key;
+	cell.vertexHead = -1;
+	cell.edgeHead = -1;
+	tableArray[ slot ] = ( int )cellArray.size();
+	cellArray.push_back( cell );
+	return tableArray[ slot ];
+}
+
+void PickGrid::GrowTable( void )
+{
+	int tableSize = std::max( 64, 2 * ( int )tableArray.size() );
+	tableArray.assign( tableSize, -1 );
+
+	tableShift = 64;
+	while( ( 1 << ( 64 - tableShift ) ) < tableSize )
+		tableShift--;
+
+	int mask = tableSize - 1;
+	for( int cell = LONG_EDGE_CELL + 1; cell < ( int )cellArray.size(); cell++ )
+	{
+		int slot = int( ( cellArray[ cell ].key * 0x9E3779B97F4A7C15ULL ) >> tableShift );
+		while( tableArray[ slot ] >= 0 )
+			slot = ( slot + 1 ) & mask;
+		tableArray[ slot ] = cell;
+	}
+}
+
+void PickGrid::LinkElement( std::vector< Link >& linkArray, int Cell::*head, int element, int cell )
+{
+	Link& link = linkArray[ element ];
+	link.cell = cell;
+	link.prev = -1;
+	link.next = cellArray[ cell ].*head;
+	if( link.next >= 0 )
+		linkArray[ link.next ].prev = element;
+	cellArray[ cell ].*head = element;
+}
+
+void PickGrid::UnlinkElement( std::vector< Link >& linkArray, int Cell::*head, int element )
+{
+	Link& link = linkArray[ element ];
+	if( link.prev >= 0 )
+		linkArray[ link.prev ].next = link.next;
+	else
+		cellArray[ link.cell ].*head = link.next;
+
+	if( link.next >= 0 )
+		linkArray[ link.next ].prev = link.prev;
+
+	link.cell = -1;
+}
+
+void PickGrid::MoveElement( std::vector< Link >& linkArray, int Cell::*head, int element, int lastElement )
+{
+	UnlinkElement( linkArray, head, element );
+	if( element != lastElement )
+	{
+		int cell = linkArray[ lastElement ].cell;
+		UnlinkElement( linkArray, head, lastElement );
+		LinkElement( linkArray, head, element, cell );
+	}
+
+	linkArray.pop_back();
+}
+
+void PickGrid::PlaceVertex( const KinematicGraph& kinematicGraph, int vertex )
+{
+	const KinematicGraph::Vector& location = kinematicGraph.vertexLocationArray[ vertex ];
+	unsigned long long key = CalcCellKey( CalcCellCoordinate( location.get_e1() ), CalcCellCoordinate( location.get_e2() ) );
+
+	int cell = vertexLinkArray[ vertex ].cell;
+	if( cell >= 0 && cellArray[ cell ].key == key )
+		return;
+
+	if( cell >= 0 )
+		UnlinkElement( vertexLinkArray, &Cell::vertexHead, vertex );
+	LinkElement( vertexLinkArray, &Cell::vertexHead, vertex, InsertCell( key ) );
+}
+
+void PickGrid::PlaceEdge( const KinematicGraph& kinematicGraph, int edge )
+{
+	const int* edgeVertex = &kinematicGraph.edgeVertexArray[ 2 * edge ];
+	const KinematicGraph::Vector& locationA = kinematicGraph.vertexLocationArray[ edgeVertex[0] ];
+	const KinematicGraph::Vector& locationB = kinematicGraph.vertexLocationArray[ edgeVertex[1] ];
+
+	double deltaX = double( locationB.get_e1() ) - double( locationA.get_e1() );
+	double deltaY = double( locationB.get_e2() ) - double( locationA.get_e2() );
+
+	int newCell = LONG_EDGE_CELL;
+	bool isLong = !( deltaX * deltaX + deltaY * deltaY <= LONG_EDGE_CELLS * LONG_EDGE_CELLS * cellSize * cellSize );
+	unsigned long long key = 0;
+	if( !isLong )
+	{
+		double midX = 0.5 * ( double( locationA.get_e1() ) + double( locationB.get_e1() ) );
+		double midY = 0.5 * ( double( locationA.get_e2() ) + double( locationB.get_e2() ) );
+		key = CalcCellKey( CalcCellCoordinate( midX ), CalcCellCoordinate( midY ) );
+	}
+
+	int cell = edgeLinkArray[ edge ].cell;
+	if( cell >= 0 && ( isLong ? cell == LONG_EDGE_CELL : ( cell != LONG_EDGE_CELL && cellArray[ cell ].key == key ) ) )
+		return;
+
+	if( !isLong )
+		newCell = InsertCell( key );
+
+	if( cell >= 0 )
+		UnlinkElement( edgeLinkArray, &Cell::edgeHead, edge );
+	LinkElement( edgeLinkArray, &Cell::edgeHead, edge, newCell );
+}
+
+// The cell size is the median length of the edges in the plane, so that a
+// pick looks through a handful of cells whatever a few stray edges measure,
+// or for a graph without edges, the spacing the vertices would have if
+// spread evenly over their bounds.
+void PickGrid::Rebuild( const KinematicGraph& kinematicGraph )
+{
+	int vertexCount = ( int )kinematicGraph.vertexIdArray.size();
+	int edgeCount = ( int )kinematicGraph.edgeIdArray.size();
+
+	std::vector< double > lengthArray( edgeCount );
+	for( int edge = 0; edge < edgeCount; edge++ )
+	{
+		const int* edgeVertex = &kinematicGraph.edgeVertexArray[ 2 * edge ];
+		const KinematicGraph::Vector& locationA = kinematicGraph.vertexLocationArray[ edgeVertex[0] ];
+		const KinematicGraph::Vector& locationB = kinematicGraph.vertexLocationArray[ edgeVertex[1] ];
+		lengthArray[ edge ] = hypot( double( locationB.get_e1() ) - double( locationA.get_e1() ), double( locationB.get_e2() ) - double( locationA.get_e2() ) );
+		if( !( lengthArray[ edge ] < 1e300 ) )
+			lengthArray[ edge ] = 1e300;
+	}
+
+	cellSize = 0.0;
+	if( edgeCount > 0 )
+	{
+		std::nth_element( lengthArray.begin(), lengthArray.begin() + edgeCount / 2, lengthArray.end() );
+		cellSize = lengthArray[ edgeCount / 2 ];
+	}
+
+	if( !( cellSize > 0.0 ) && vertexCount > 0 )
+	{
+		double minX = 1e300, maxX = -1e300, minY = 1e300, maxY = -1e300;
+		for( int vertex = 0; vertex < vertexCount; vertex++ )
+		{
+			const KinematicGraph::Vector& location = kinematicGraph.vertexLocationArray[ vertex ];
+			minX = std::min( minX, double( location.get_e1() ) );
+			maxX = std::max( maxX, double( location.get_e1() ) );
+			minY = std::min( minY, double( location.get_e2() ) );
+			maxY = std::max( maxY, double( location.get_e2() ) );
+		}
+
+		cellSize = sqrt( ( maxX - minX ) * ( maxY - minY ) / vertexCount );
+		if( !( cellSize > 0.0 ) )
+			cellSize = std::max( maxX - minX, maxY - minY ) / vertexCount;
+	}
+
+	if( !( cellSize > 1e-12 && cellSize < 1e12 ) )
+		cellSize = 1.0;
+	inverseCellSize = 1.0 / cellSize;
+
+	Cell longEdgeCell;
+	longEdgeCell.key = 0;
+	longEdgeCell.vertexHead = -1;
+	longEdgeCell.edgeHead = -1;
+	cellArray.clear();
+	cellArray.push_back( longEdgeCell );
+
+	tableArray.clear();
+	while( tableArray.size() < 2 * size_t( vertexCount + edgeCount ) )
+		GrowTable();
+	if( tableArray.size() == 0 )
+		GrowTable();
+
+	Link unlinked;
+	unlinked.cell = -1;
+	unlinked.prev = -1;
+	unlinked.next = -1;
+	vertexLinkArray.assign( vertexCount, unlinked );
+	edgeLinkArray.assign( edgeCount, unlinked );
+
+	for( int vertex = 0; vertex < vertexCount; vertex++ )
+		PlaceVertex( kinematicGraph, vertex );
+	for( int edge = 0; edge < edgeCount; edge++ )
+		PlaceEdge( kinematicGraph, edge );
+
+	builtElementCount = vertexCount + edgeCount;
+	stale = false;
+}
+
+void PickGrid::InsertVertex( const KinematicGraph& kinematicGraph, int vertex )
+{
+	if( stale )
+		return;
+
+	assert( vertex == ( int )vertexLinkArray.size() );
+
+	Link unlinked;
+	unlinked.cell = -1;
+	unlinked.prev = -1;
+	unlinked.next = -1;
+	vertexLinkArray.push_back( unlinked );
+	PlaceVertex( kinematicGraph, vertex );
+}
+
+void PickGrid::InsertEdge( const KinematicGraph& kinematicGraph, int edge )
+{
+	if( stale )
+		return;
+
+	assert( edge == ( int )edgeLinkArray.size() );
+
+	Link unlinked;
+	unlinked.cell = -1;
+	unlinked.prev = -1;
+	unlinked.next = -1;
+	edgeLinkArray.push_back( unlinked );
+	PlaceEdge( kinematicGraph, edge );
+}
+
+// Inserting more than the grid holds already would leave its cell size
+// fitted to the wrong graph, so that is left to a rebuild instead.
+void PickGrid::InsertElements( const KinematicGraph& kinematicGraph, int firstVertex, int firstEdge )
+{
+	if( stale )
+		return;
+
+	int vertexCount = ( int )kinematicGraph.vertexIdArray.size();
+	int edgeCount = ( int )kinematicGraph.edgeIdArray.size();
+	if( ( vertexCount - firstVertex ) + ( edgeCount - firstEdge ) > firstVertex + firstEdge )
+	{
+		stale = true;
+		return;
+	}
+
+	for( int vertex = firstVertex; vertex < vertexCount; vertex++ )
+		InsertVertex( kinematicGraph, vertex );
+	for( int edge = firstEdge; edge < edgeCount; edge++ )
+		InsertEdge( kinematicGraph, edge );
+}
+
+void PickGrid::RemoveVertex( int vertex, int lastVertex )
+{
+	if( stale )
+		return;
+
+	MoveElement( vertexLinkArray, &Cell::vertexHead, vertex, lastVertex );
+}
+
+void PickGrid::RemoveEdge( int edge, int lastEdge )
+{
+	if( stale )
+		return;
+
+	MoveElement( edgeLinkArray, &Cell::edgeHead, edge, lastEdge );
+}
+
+void PickGrid::UpdateComponent( const KinematicGraph& kinematicGraph, int component )
+{
+	if( stale )
+		return;
+
+	const KinematicGraph::Component& updateComponent = kinematicGraph.componentArray[ component ];
+	for( int i = 0; i < ( int )updateComponent.vertexArray.size(); i++ )
+		PlaceVertex( kinematicGraph, updateComponent.vertexArray[i] );
+	for( int i = 0; i < ( int )updateComponent.edgeArray.size(); i++ )
+		PlaceEdge( kinematicGraph, updateComponent.edgeArray[i] );
+}
+
+// Gather the cells overlapping a square about the point, or every cell
+// but the long edge list if there are fewer of those.
+void PickGrid::GatherCells( double x, double y, double reach )
+{
+	gatherCellArray.clear();
+
+	int minX = CalcCellCoordinate( x - reach );
+	int maxX = CalcCellCoordinate( x + reach );
+	int minY = CalcCellCoordinate( y - reach );
+	int maxY = CalcCellCoordinate( y + reach );
+
+	if( double( maxX - minX + 1 ) * double( maxY - minY + 1 ) > double( cellArray.size() ) )
+	{
+		for( int cell = LONG_EDGE_CELL + 1; cell < ( int )cellArray.size(); cell++ )
+			gatherCellArray.push_back( cell );
+		return;
+	}
+
+	for( int cellX = minX; cellX <= maxX; cellX++ )
+	{
+		for( int cellY = minY; cellY <= maxY; cellY++ )
+		{
+			int cell = FindCell( CalcCellKey( cellX, cellY ) );
+			if( cell >= 0 )
+				gatherCellArray.push_back( cell );
+		}
+	}
+}
+
+int PickGrid::Pick( const KinematicGraph& kinematicGraph, double x, double y, double radius )
+{
+	int vertexCount = ( int )kinematicGraph.vertexIdArray.size();
+	int edgeCount = ( int )kinematicGraph.edgeIdArray.size();
+	int elementCount = vertexCount + edgeCount;
+
+	// Rebuilding when the graph has doubled or halved, or the cells have
+	// come to outnumber the elements, costs amortized constant time per change.
+	if( stale || elementCount > 2 * builtElementCount + 64 || 2 * elementCount + 64 < builtElementCount || ( int )cellArray.size() > 4 * elementCount + 64 )
+		Rebuild( kinematicGraph );
+
+	if( !( radius >= 0.0 ) )
+		return 0;
+
+	double bestDistance = radius * radius;
+	int bestVertex = -1;
+	GatherCells( x, y, radius );
+	for( int i = 0; i < ( int )gatherCellArray.size(); i++ )
+	{
+		for( int vertex = cellArray[ gatherCellArray[i] ].vertexHead; vertex >= 0; vertex = vertexLinkArray[ vertex ].next )
+		{
+			const KinematicGraph::Vector& location = kinematicGraph.vertexLocationArray[ vertex ];
+			double deltaX = double( location.get_e1() ) - x;
+			double deltaY = double( location.get_e2() ) - y;
+			double distance = deltaX * deltaX + deltaY * deltaY;
+			if( distance <= bestDistance )
+			{
+				bestDistance = distance;
+				bestVertex = vertex;
+			}
+		}
+	}
+
+	if( bestVertex >= 0 )
+		return kinematicGraph.vertexIdArray[ bestVertex ];
+
+	// The middle third of a short edge is within a cell of its midpoint.
+	int bestEdge = -1;
+	GatherCells( x, y, radius + cellSize );
+	gatherCellArray.push_back( LONG_EDGE_CELL );
+	for( int i = 0; i < ( int )gatherCellArray.size(); i++ )
+	{
+		for( int edge = cellArray[ gatherCellArray[i] ].edgeHead; edge >= 0; edge = edgeLinkArray[ edge ].next )
+		{
+			const int* edgeVertex = &kinematicGraph.edgeVertexArray[ 2 * edge ];
+			const KinematicGraph::Vector& locationA = kinematicGraph.vertexLocationArray[ edgeVertex[0] ];
+			const KinematicGraph::Vector& locationB = kinematicGraph.vertexLocationArray[ edgeVertex[1] ];
+
+			double thirdX = ( double( locationB.get_e1() ) - double( locationA.get_e1() ) ) / 3.0;
+			double thirdY = ( double( locationB.get_e2() ) - double( locationA.get_e2() ) ) / 3.0;
+			double startX = double( locationA.get_e1() ) + thirdX;
+			double startY = double( locationA.get_e2() ) + thirdY;
+
+			double lengthSquared = thirdX * thirdX + thirdY * thirdY;
+			double t = ( lengthSquared > 0.0 ) ? ( ( x - startX ) * thirdX + ( y - startY ) * thirdY ) / lengthSquared : 0.0;
+			t = std::max( 0.0, std::min( 1.0, t ) );
+
+			double deltaX = startX + t * thirdX - x;
+			double deltaY = startY + t * thirdY - y;
+			double distance = deltaX * deltaX + deltaY * deltaY;
+			if( distance <= bestDistance )
+			{
+				bestDistance = distance;
+				bestEdge = edge;
+			}
+		}
+	}
+
+	if( bestEdge >= 0 )
+		return kinematicGraph.edgeIdArray[ bestEdge ];
+
+	return 0;
+}
+
+// PickGrid.cpp
@@ -0,0 +1,99 @@
+// PickGrid.h
+
+#pragma once
+
+#include <vector>
+
+class KinematicGraph;
+
+// A uniform grid over the vertices and edges of a kinematic graph as seen
+// in the e1-e2 plane, for finding the element under the mouse without
+// drawing anything.  The grid is hashed, so only occupied cells take room.
+// Vertices are binned by location and edges by midpoint, except that edges
+// many cells long are kept on a list of their own that every query checks.
+//
+// Each element is threaded onto a doubly linked list of its cell, so the
+// graph keeps the grid current in constant time per element it adds,
+// removes or moves, slot renumbering included.  The grid is rebuilt, with
+// a cell size fitted to the edges, when it is first used, after the graph
+// is cleared, and when the graph has grown or shrunk a lot since.
+class PickGrid
+{
+public:
+
+	PickGrid( void );
+	~PickGrid( void );
+
+	// Leave the grid to be rebuilt at the next pick.  Until then the graph's
+	// changes are ignored.
+	void Invalidate( void ) { stale = true; }
+
+	void InsertVertex( const KinematicGraph& kinematicGraph, int vertex );
+	void InsertEdge( const KinematicGraph& kinematicGraph, int edge );
+	void InsertElements( const KinematicGraph& kinematicGraph, int firstVertex, int firstEdge );
+
+	// The element leaves its slot, and the last element is moved into it.
+	void RemoveVertex( int vertex, int lastVertex );
+	void RemoveEdge( int edge, int lastEdge );
+
+	// Rebin the vertices and edges of a component after a solve moved them.
+	void UpdateComponent( const KinematicGraph& kinematicGraph, int component );
+
+	// Return the id of the vertex nearest the point within the radius, or
+	// failing that, of the edge whose middle third is nearest, or zero.
+	int Pick( const KinematicGraph& kinematicGraph, double x, double y, double radius );
+
+private:
+
+	// Edges longer than this many cells go on the long edge list.  The
+	// middle third of any other edge lies within a cell of its midpoint.
+	enum { LONG_EDGE_CELLS = 6 };
+
+	// Cell zero is the long edge list, which is not in the hash table.
+	enum { LONG_EDGE_CELL = 0 };
+
+	struct Cell
+	{
+		unsigned long long key;
+		int vertexHead;
+		int edgeHead;
+	};
+
+	struct Link
+	{
+		int cell;
+		int prev;
+		int next;
+	};
+
+	void Rebuild( const KinematicGraph& kinematicGraph );
+	int CalcCellCoordinate( double coordinate ) const;
+	unsigned long long CalcCellKey( int cellX, int cellY ) const;
+	int FindCell( unsigned long long key ) const;
+	int InsertCell( unsigned long long key );
+	void GrowTable( void );
+	void GatherCells( double x, double y, double reach );
+
+	void LinkElement( std::vector< Link >& linkArray, int Cell::*head, int element, int cell );
+	void UnlinkElement( std::vector< Link >& linkArray, int Cell::*head, int element );
+	void MoveElement( std::vector< Link >& linkArray, int Cell::*head, int element, int lastElement );
+	void PlaceVertex( const KinematicGraph& kinematicGraph, int vertex );
+	void PlaceEdge( const KinematicGraph& kinematicGraph, int edge );
+
+	bool stale;
+	int builtElementCount;
+	double cellSize;
+	double inverseCellSize;
+
+	std::vector< Cell > cellArray;
+	std::vector< int > tableArray;		// Open addressing hash table of cell indices, -1 where empty.
+	int tableShift;
+
+	// Indexed by vertex and edge slot.
+	std::vector< Link > vertexLinkArray;
+	std::vector< Link > edgeLinkArray;
+
+	std::vector< int > gatherCellArray;
+};
+
+// PickGrid.h
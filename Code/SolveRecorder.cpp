@@ -0,0 +1,1000 @@
+// SolveRecorder.cpp
+
+#include "SolveRecorder.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+
+namespace
+{
+	const char fileMagic[8] = { 'K', 'G', 'R', 'E', 'C', 'O', 'R', 'D' };
+
+	bool IsLittleEndian( void )
+	{
+		unsigned int one = 1;
+		unsigned char firstByte;
+		memcpy( &firstByte, &one, 1 );
+		return firstByte == 1;
+	}
+
+	// Unsigned integers are written seven bits to a byte, low bits first,
+	// with the top bit of each byte but the last set.  Signed integers are
+	// zigzag-mapped first, so that small magnitudes of either sign stay short.
+	void PutUnsigned( std::vector< unsigned char >& byteArray, unsigned long long value )
+	{
+		while( value >= 0x80 )
+		{
+			byteArray.push_back( ( unsigned char )( value | 0x80 ) );
+			value >>= 7;
+		}
+		byteArray.push_back( ( unsigned char )value );
+	}
+
+	void PutSigned( std::vector< unsigned char >& byteArray, long long value )
+	{
+		PutUnsigned( byteArray, ( ( unsigned long long )value << 1 ) ^ ( unsigned long long )( value >> 63 ) );
+	}
+
+	void PutBytes( std::vector< unsigned char >& byteArray, const void* data, size_t size )
+	{
+		const unsigned char* byte = ( const unsigned char* )data;
+		byteArray.insert( byteArray.end(), byte, byte + size );
+	}
+
+	template< typename Type >
+	void PutRaw( std::vector< unsigned char >& byteArray, const Type& value )
+	{
+		PutBytes( byteArray, &value, sizeof( Type ) );
+	}
+
+	template< typename Type >
+	void PutArray( std::vector< unsigned char >& byteArray, const std::vector< Type >& array )
+	{
+		PutUnsigned( byteArray, array.size() );
+		if( array.size() > 0 )
+			PutBytes( byteArray, &array[0], array.size() * sizeof( Type ) );
+	}
+
+	void PutLocation( std::vector< unsigned char >& byteArray, const c3ga::vectorE3GA& location )
+	{
+		PutRaw( byteArray, location.get_e1() );
+		PutRaw( byteArray, location.get_e2() );
+		PutRaw( byteArray, location.get_e3() );
+	}
+
+	// The change of a coordinate as the difference of its bit patterns,
+	// which is small when the coordinate barely moved.  The coordinates are
+	// in the precision of the graph.
+#if defined( KINEMATIC_GRAPH_FLOAT )
+	long long CalcBitDelta( float before, float after )
+	{
+		unsigned int bitsBefore, bitsAfter;
+		memcpy( &bitsBefore, &before, sizeof( float ) );
+		memcpy( &bitsAfter, &after, sizeof( float ) );
+		return ( int )( bitsAfter - bitsBefore );
+	}
+#else
+	long long CalcBitDelta( double before, double after )
+	{
+		unsigned long long bitsBefore, bitsAfter;
+		memcpy( &bitsBefore, &before, sizeof( double ) );
+		memcpy( &bitsAfter, &after, sizeof( double ) );
+		return ( long long )( bitsAfter - bitsBefore );
+	}
+#endif
+}
+
+struct SolveRecorder::ByteReader
+{
+	const unsigned char* cursor;
+	const unsigned char* end;
+	bool failed;
+
+	ByteReader( const unsigned char* data, size_t size ) : cursor( data ), end( data + size ), failed( false ) {}
+
+	bool AtEnd( void ) const { return cursor == end; }
+
+	const unsigned char* GetBytes( size_t size )
+	{
+		if( failed || size > size_t( end - cursor ) )
+		{
+			failed = true;
+			return nullptr;
+		}
+
+		const unsigned char* bytes = cursor;
+		cursor += size;
+		return bytes;
+	}
+
+	int GetByte( void )
+	{
+		const unsigned char* byte = GetBytes(1);
+		return byte ? *byte : -1;
+	}
+
+	unsigned long long GetUnsigned( void )
+	{
+		unsigned long long value = 0;
+		for( int shift = 0; shift < 64; shift += 7 )
+		{
+			int byte = GetByte();
+			if( byte < 0 )
+				return 0;
+
+			value |= ( unsigned long long )( byte & 0x7F ) << shift;
+			if( !( byte & 0x80 ) )
+				return value;
+		}
+
+		failed = true;
+		return 0;
+	}
+
+	long long GetSigned( void )
+	{
+		unsigned long long value = GetUnsigned();
+		return ( long long )( value >> 1 ) ^ -( long long )( value & 1 );
+	}
+
+	int GetInt( void )
+	{
+		long long value = GetSigned();
+		if( value < INT_MIN || value > INT_MAX )
+			failed = true;
+		return int( value );
+	}
+
+	template< typename Type >
+	Type GetRaw( void )
+	{
+		Type value;
+		memset( &value, 0, sizeof( Type ) );
+		const unsigned char* bytes = GetBytes( sizeof( Type ) );
+		if( bytes )
+			memcpy( &value, bytes, sizeof( Type ) );
+		return value;
+	}
+
+	// The count is checked against the bytes left before anything is
+	// allocated, so a corrupt count cannot ask for more memory than the
+	// recording itself takes.
+	template< typename Type >
+	bool GetArray( std::vector< Type >& array )
+	{
+		unsigned long long count = GetUnsigned();
+		if( failed || count > ( unsigned long long )( end - cursor ) / sizeof( Type ) )
+		{
+			failed = true;
+			return false;
+		}
+
+		array.resize( size_t( count ) );
+		if( count > 0 )
+			memcpy( &array[0], GetBytes( size_t( count ) * sizeof( Type ) ), size_t( count ) * sizeof( Type ) );
+		return true;
+	}
+
+	c3ga::vectorE3GA GetLocation( void )
+	{
+		double e1 = GetRaw< double >();
+		double e2 = GetRaw< double >();
+		double e3 = GetRaw< double >();
+		return c3ga::vectorE3GA( c3ga::vectorE3GA::coord_e1_e2_e3, e1, e2, e3 );
+	}
+};
+
+SolveRecorder::SolveRecorder( size_t capacity /*= 64 << 20*/ )
+{
+	this->capacity = capacity;
+	byteCount = 0;
+	moveComponent = -1;
+}
+
+SolveRecorder::~SolveRecorder( void )
+{
+}
+
+void SolveRecorder::Reset( void )
+{
+	segmentQueue.clear();
+	byteCount = 0;
+	moveComponent = -1;
+}
+
+int SolveRecorder::GetFrameCount( void ) const
+{
+	int frameCount = 0;
+	for( int i = 0; i < ( int )segmentQueue.size(); i++ )
+		frameCount += segmentQueue[i].frameCount;
+
+	return frameCount;
+}
+
+void SolveRecorder::Start( const KinematicGraph& kinematicGraph )
+{
+	Reset();
+	StartSegment( kinematicGraph, true );
+}
+
+void SolveRecorder::RecordKeyframe( const KinematicGraph& kinematicGraph )
+{
+	StartSegment( kinematicGraph, true );
+}
+
+// Keyframes are spaced so that the frames between them take at least as
+// much room as a keyframe, and an eighth of the capacity, which bounds the
+// share of the recording spent on keyframes.  The oldest segments are then
+// dropped until the recording fits again, but the two newest are always
+// kept, so that a full segment of history is held even of a large graph.
+void SolveRecorder::StartSegment( const KinematicGraph& kinematicGraph, bool external )
+{
+	Segment segment;
+	segment.keyframe.swap( spareSegment.keyframe );
+	segment.frames.swap( spareSegment.frames );
+	segment.frames.clear();
+	segment.frameCount = 0;
+	segment.external = external;
+	SaveState( kinematicGraph, segment.keyframe );
+
+	byteCount += segment.keyframe.size();
+	segmentQueue.push_back( Segment() );
+	std::swap( segmentQueue.back(), segment );
+
+	while( byteCount > capacity && segmentQueue.size() > 2 )
+	{
+		Segment& oldest = segmentQueue.front();
+		byteCount -= oldest.keyframe.size() + oldest.frames.size();
+		spareSegment.keyframe.swap( oldest.keyframe );
+		spareSegment.frames.swap( oldest.frames );
+		segmentQueue.pop_front();
+	}
+}
+
+// A change made while nothing is recorded cannot be framed, since the state
+// before it is gone; the recording starts over from the state after it.
+SolveRecorder::ByteArray* SolveRecorder::BeginFrame( const KinematicGraph& kinematicGraph, FrameType frameType )
+{
+	if( segmentQueue.size() == 0 )
+	{
+		StartSegment( kinematicGraph, true );
+		return nullptr;
+	}
+
+	ByteArray& frames = segmentQueue.back().frames;
+	byteCount -= frames.size();
+	frames.push_back( ( unsigned char )frameType );
+	outcome.clear();
+	return &frames;
+}
+
+void SolveRecorder::EndFrame( const KinematicGraph& kinematicGraph )
+{
+	Segment& segment = segmentQueue.back();
+	PutUnsigned( segment.frames, outcome.size() );
+	PutBytes( segment.frames, outcome.data(), outcome.size() );
+	segment.frameCount++;
+	byteCount += segment.frames.size();
+
+	if( segment.frames.size() >= std::max( capacity / 8, segment.keyframe.size() ) )
+		StartSegment( kinematicGraph, false );
+}
+
+void SolveRecorder::RecordInsertVertex( const KinematicGraph& kinematicGraph, const c3ga::vectorE3GA& location, int id )
+{
+	ByteArray* frames = BeginFrame( kinematicGraph, FRAME_INSERT_VERTEX );
+	if( !frames )
+		return;
+
+	PutLocation( *frames, location );
+	PutSigned( outcome, id );
+	EndFrame( kinematicGraph );
+}
+
+void SolveRecorder::RecordRemoveVertex( const KinematicGraph& kinematicGraph, int id )
+{
+	ByteArray* frames = BeginFrame( kinematicGraph, FRAME_REMOVE_VERTEX );
+	if( !frames )
+		return;
+
+	PutSigned( *frames, id );
+	EndFrame( kinematicGraph );
+}
+
+void SolveRecorder::RecordConnectVertices( const KinematicGraph& kinematicGraph, int idA, int idB, int id )
+{
+	ByteArray* frames = BeginFrame( kinematicGraph, FRAME_CONNECT_VERTICES );
+	if( !frames )
+		return;
+
+	PutSigned( *frames, idA );
+	PutSigned( *frames, idB );
+	PutSigned( outcome, id );
+	EndFrame( kinematicGraph );
+}
+
+void SolveRecorder::RecordDisconnectVertices( const KinematicGraph& kinematicGraph, int idA, int idB )
+{
+	ByteArray* frames = BeginFrame( kinematicGraph, FRAME_DISCONNECT_VERTICES );
+	if( !frames )
+		return;
+
+	PutSigned( *frames, idA );
+	PutSigned( *frames, idB );
+	EndFrame( kinematicGraph );
+}
+
+void SolveRecorder::RecordClear( const KinematicGraph& kinematicGraph )
+{
+	if( !BeginFrame( kinematicGraph, FRAME_CLEAR ) )
+		return;
+
+	EndFrame( kinematicGraph );
+}
+
+void SolveRecorder::RecordInsertGraph( const KinematicGraph& kinematicGraph, const std::vector< c3ga::vectorE3GA >& locationArray, const std::vector< int >& edgeArray, const std::vector< int >& idArray, int edgeCount )
+{
+	ByteArray* frames = BeginFrame( kinematicGraph, FRAME_INSERT_GRAPH );
+	if( !frames )
+		return;
+
+	PutUnsigned( *frames, locationArray.size() );
+	for( int i = 0; i < ( int )locationArray.size(); i++ )
+		PutLocation( *frames, locationArray[i] );
+
+	PutUnsigned( *frames, edgeArray.size() );
+	for( int i = 0; i < ( int )edgeArray.size(); i++ )
+		PutSigned( *frames, edgeArray[i] );
+
+	PutUnsigned( outcome, edgeCount );
+	PutSigned( outcome, idArray.size() > 0 ? idArray[0] : 0 );
+	EndFrame( kinematicGraph );
+}
+
+void SolveRecorder::RecordSetVertexStationary( const KinematicGraph& kinematicGraph, int id, bool stationary )
+{
+	ByteArray* frames = BeginFrame( kinematicGraph, FRAME_SET_VERTEX_STATIONARY );
+	if( !frames )
+		return;
+
+	PutSigned( *frames, id );
+	frames->push_back( stationary ? 1 : 0 );
+	EndFrame( kinematicGraph );
+}
+
+void SolveRecorder::RecordSetSolverSettings( const KinematicGraph& kinematicGraph )
+{
+	ByteArray* frames = BeginFrame( kinematicGraph, FRAME_SET_SOLVER_SETTINGS );
+	if( !frames )
+		return;
+
+	PutSolverSettings( *frames, kinematicGraph.solverSettings );
+	EndFrame( kinematicGraph );
+}
+
+void SolveRecorder::RecordCompactIds( const KinematicGraph& kinematicGraph )
+{
+	if( !BeginFrame( kinematicGraph, FRAME_COMPACT_IDS ) )
+		return;
+
+	PutSigned( outcome, kinematicGraph.newId );
+	EndFrame( kinematicGraph );
+}
+
+// A solve only moves vertices of the moved vertex's component, so only
+// those are kept to compare against afterwards.
+void SolveRecorder::BeginMoveVertex( const KinematicGraph& kinematicGraph, int vertex )
+{
+	CaptureComponent( kinematicGraph, vertex, moveComponent, moveLocationArray );
+}
+
+void SolveRecorder::RecordMoveVertex( const KinematicGraph& kinematicGraph, int id, const c3ga::vectorE3GA& delta, int passedCheck, const KinematicGraph::SolveResult& result )
+{
+	ByteArray* frames = BeginFrame( kinematicGraph, FRAME_MOVE_VERTEX );
+	if( !frames )
+		return;
+
+	PutSigned( *frames, id );
+	PutLocation( *frames, delta );
+	PutSigned( *frames, passedCheck );
+	PutMoveOutcome( outcome, kinematicGraph, moveComponent, moveLocationArray, result );
+	EndFrame( kinematicGraph );
+}
+
+/*static*/ void SolveRecorder::CaptureComponent( const KinematicGraph& kinematicGraph, int vertex, int& component, std::vector< KinematicGraph::Vector >& locationArray )
+{
+	component = kinematicGraph.vertexComponentArray[ vertex ];
+
+	const std::vector< int >& vertexArray = kinematicGraph.componentArray[ component ].vertexArray;
+	locationArray.resize( vertexArray.size() );
+	for( int i = 0; i < ( int )vertexArray.size(); i++ )
+		locationArray[i] = kinematicGraph.vertexLocationArray[ vertexArray[i] ];
+}
+
+// The vertices that moved are listed by the gap in the component's vertex
+// array since the last one listed, followed by their coordinate changes.
+/*static*/ void SolveRecorder::PutMoveOutcome( ByteArray& outcome, const KinematicGraph& kinematicGraph, int component, const std::vector< KinematicGraph::Vector >& locationArray, const KinematicGraph::SolveResult& result )
+{
+	outcome.push_back( ( unsigned char )result.status );
+	PutUnsigned( outcome, result.iterations );
+	PutUnsigned( outcome, result.moveCount );
+	PutRaw( outcome, result.residual );
+	PutRaw( outcome, result.convergenceRate );
+	PutRaw( outcome, result.relaxation );
+	PutUnsigned( outcome, result.restartCount );
+
+	const std::vector< int >& vertexArray = kinematicGraph.componentArray[ component ].vertexArray;
+	int lastIndex = -1;
+	for( int i = 0; i < ( int )vertexArray.size(); i++ )
+	{
+		const KinematicGraph::Vector& before = locationArray[i];
+		const KinematicGraph::Vector& after = kinematicGraph.vertexLocationArray[ vertexArray[i] ];
+		if( memcmp( &before, &after, sizeof( KinematicGraph::Vector ) ) == 0 )
+			continue;
+
+		PutUnsigned( outcome, i - lastIndex - 1 );
+		lastIndex = i;
+
+		for( int j = 0; j < KinematicGraph::DIMENSION; j++ )
+			PutSigned( outcome, CalcBitDelta( before[j], after[j] ) );
+	}
+}
+
+/*static*/ void SolveRecorder::PutSolverSettings( ByteArray& byteArray, const KinematicGraph::SolverSettings& solverSettings )
+{
+	PutSigned( byteArray, solverSettings.solverType );
+	PutSigned( byteArray, solverSettings.maxIterations );
+	PutSigned( byteArray, solverSettings.maxMoves );
+	PutRaw( byteArray, solverSettings.maxSeconds );
+	PutRaw( byteArray, solverSettings.tolerance );
+	PutSigned( byteArray, solverSettings.stallIterations );
+	PutRaw( byteArray, solverSettings.stallRatio );
+	PutRaw( byteArray, solverSettings.divergenceRatio );
+	PutSigned( byteArray, solverSettings.linearIterations );
+	PutRaw( byteArray, solverSettings.damping );
+	PutSigned( byteArray, solverSettings.threadCount );
+	PutSigned( byteArray, solverSettings.accelerationType );
+	PutRaw( byteArray, solverSettings.relaxation );
+	PutRaw( byteArray, solverSettings.spectralRadius );
+	PutSigned( byteArray, solverSettings.andersonDepth );
+	byteArray.push_back( solverSettings.treeReaching ? 1 : 0 );
+}
+
+/*static*/ bool SolveRecorder::GetSolverSettings( ByteReader& reader, KinematicGraph::SolverSettings& solverSettings )
+{
+	int solverType = reader.GetInt();
+	if( solverType < KinematicGraph::SOLVER_PROPAGATE || solverType > KinematicGraph::SOLVER_WORKLIST )
+		return false;
+
+	solverSettings.solverType = KinematicGraph::SolverType( solverType );
+	solverSettings.maxIterations = reader.GetInt();
+	solverSettings.maxMoves = reader.GetInt();
+	solverSettings.maxSeconds = reader.GetRaw< double >();
+	solverSettings.tolerance = reader.GetRaw< float >();
+	solverSettings.stallIterations = reader.GetInt();
+	solverSettings.stallRatio = reader.GetRaw< float >();
+	solverSettings.divergenceRatio = reader.GetRaw< float >();
+	solverSettings.linearIterations = reader.GetInt();
+	solverSettings.damping = reader.GetRaw< float >();
+	solverSettings.threadCount = reader.GetInt();
+
+	int accelerationType = reader.GetInt();
+	if( accelerationType < KinematicGraph::ACCELERATION_NONE || accelerationType > KinematicGraph::ACCELERATION_ANDERSON )
+		return false;
+
+	solverSettings.accelerationType = KinematicGraph::AccelerationType( accelerationType );
+	solverSettings.relaxation = reader.GetRaw< float >();
+	solverSettings.spectralRadius = reader.GetRaw< float >();
+	solverSettings.andersonDepth = reader.GetInt();
+	solverSettings.treeReaching = reader.GetByte() == 1;
+	return !reader.failed;
+}
+
+// Everything a solve's outcome depends on is saved: besides the elements,
+// the order of each component's vertex and edge arrays, the edge coloring,
+// the component free list and the propagation stamps.  The maps and the
+// adjacency follow from the arrays.
+/*static*/ void SolveRecorder::SaveState( const KinematicGraph& kinematicGraph, ByteArray& byteArray )
+{
+	byteArray.clear();
+
+	PutSigned( byteArray, kinematicGraph.newId );
+	PutSigned( byteArray, kinematicGraph.selectedId );
+	PutSigned( byteArray, kinematicGraph.key );
+	PutSolverSettings( byteArray, kinematicGraph.solverSettings );
+
+	PutArray( byteArray, kinematicGraph.vertexIdArray );
+	PutArray( byteArray, kinematicGraph.vertexLocationArray );
+	PutArray( byteArray, kinematicGraph.vertexStationArray );
+	PutArray( byteArray, kinematicGraph.vertexStationaryArray );
+	PutArray( byteArray, kinematicGraph.vertexKeyArray );
+	PutArray( byteArray, kinematicGraph.vertexComponentArray );
+	PutArray( byteArray, kinematicGraph.vertexComponentIndexArray );
+
+	PutArray( byteArray, kinematicGraph.edgeIdArray );
+	PutArray( byteArray, kinematicGraph.edgeVertexArray );
+	PutArray( byteArray, kinematicGraph.edgeLengthArray );
+	PutArray( byteArray, kinematicGraph.edgeComponentIndexArray );
+
+	PutUnsigned( byteArray, kinematicGraph.componentArray.size() );
+	for( int i = 0; i < ( int )kinematicGraph.componentArray.size(); i++ )
+	{
+		const KinematicGraph::Component& component = kinematicGraph.componentArray[i];
+		PutArray( byteArray, component.vertexArray );
+		PutArray( byteArray, component.edgeArray );
+		byteArray.push_back( component.splitPending ? 1 : 0 );
+		PutArray( byteArray, component.colorOffsetArray );
+		PutArray( byteArray, component.colorEdgeArray );
+		byteArray.push_back( component.coloringDirty ? 1 : 0 );
+	}
+
+	PutArray( byteArray, kinematicGraph.freeComponentArray );
+	PutArray( byteArray, kinematicGraph.splitComponentArray );
+}
+
+/*static*/ bool SolveRecorder::RestoreState( KinematicGraph& kinematicGraph, const ByteArray& byteArray )
+{
+	kinematicGraph.Clear();
+
+	ByteReader reader( byteArray.data(), byteArray.size() );
+
+	kinematicGraph.newId = reader.GetInt();
+	kinematicGraph.selectedId = reader.GetInt();
+	kinematicGraph.key = reader.GetInt();
+	if( !GetSolverSettings( reader, kinematicGraph.solverSettings ) )
+	{
+		kinematicGraph.Clear();
+		return false;
+	}
+
+	reader.GetArray( kinematicGraph.vertexIdArray );
+	reader.GetArray( kinematicGraph.vertexLocationArray );
+	reader.GetArray( kinematicGraph.vertexStationArray );
+	reader.GetArray( kinematicGraph.vertexStationaryArray );
+	reader.GetArray( kinematicGraph.vertexKeyArray );
+	reader.GetArray( kinematicGraph.vertexComponentArray );
+	reader.GetArray( kinematicGraph.vertexComponentIndexArray );
+
+	reader.GetArray( kinematicGraph.edgeIdArray );
+	reader.GetArray( kinematicGraph.edgeVertexArray );
+	reader.GetArray( kinematicGraph.edgeLengthArray );
+	reader.GetArray( kinematicGraph.edgeComponentIndexArray );
+
+	unsigned long long componentCount = reader.GetUnsigned();
+	if( componentCount > byteArray.size() )
+		reader.failed = true;
+
+	// Clearing the graph freed every component, keeping its arrays.
+	kinematicGraph.freeComponentArray.clear();
+	kinematicGraph.componentArray.resize( reader.failed ? 0 : size_t( componentCount ) );
+	for( int i = 0; i < ( int )kinematicGraph.componentArray.size() && !reader.failed; i++ )
+	{
+		KinematicGraph::Component& component = kinematicGraph.componentArray[i];
+		reader.GetArray( component.vertexArray );
+		reader.GetArray( component.edgeArray );
+		component.splitPending = reader.GetByte() == 1;
+		reader.GetArray( component.colorOffsetArray );
+		reader.GetArray( component.colorEdgeArray );
+		component.coloringDirty = reader.GetByte() == 1;
+		component.stationsDirty = true;
+	}
+
+	reader.GetArray( kinematicGraph.freeComponentArray );
+	reader.GetArray( kinematicGraph.splitComponentArray );
+
+	if( reader.failed || !reader.AtEnd() || !CheckState( kinematicGraph ) )
+	{
+		kinematicGraph.Clear();
+		return false;
+	}
+
+	int vertexCount = ( int )kinematicGraph.vertexIdArray.size();
+	int edgeCount = ( int )kinematicGraph.edgeIdArray.size();
+
+	kinematicGraph.adjacencyDirty = true;
+
+	for( int i = 0; i < vertexCount + edgeCount; i++ )
+	{
+		KinematicGraph::Handle handle;
+		handle.type = ( i < vertexCount ) ? KinematicGraph::TYPE_VERTEX : KinematicGraph::TYPE_EDGE;
+		handle.slot = ( i < vertexCount ) ? i : i - vertexCount;
+
+		int id = ( i < vertexCount ) ? kinematicGraph.vertexIdArray[i] : kinematicGraph.edgeIdArray[ handle.slot ];
+		if( id <= 0 || id >= kinematicGraph.newId || kinematicGraph.handleTable.Find( id ) )
+		{
+			kinematicGraph.Clear();
+			return false;
+		}
+
+		kinematicGraph.handleTable.Insert( id, handle );
+	}
+
+	for( int edge = 0; edge < edgeCount; edge++ )
+	{
+		int idA = kinematicGraph.vertexIdArray[ kinematicGraph.edgeVertexArray[ 2 * edge ] ];
+		int idB = kinematicGraph.vertexIdArray[ kinematicGraph.edgeVertexArray[ 2 * edge + 1 ] ];
+		int id = kinematicGraph.edgeIdArray[ edge ];
+		if( idA == idB
+			|| !kinematicGraph.neighborMap.insert( std::pair< KinematicGraph::VertexIdPair, int >( KinematicGraph::VertexIdPair( idA, idB ), id ) ).second
+			|| !kinematicGraph.neighborMap.insert( std::pair< KinematicGraph::VertexIdPair, int >( KinematicGraph::VertexIdPair( idB, idA ), id ) ).second )
+		{
+			kinematicGraph.Clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// A recording read from a file is checked to describe a graph the solvers
+// can run on: every slot in range and the component bookkeeping consistent.
+/*static*/ bool SolveRecorder::CheckState( const KinematicGraph& kinematicGraph )
+{
+	int vertexCount = ( int )kinematicGraph.vertexIdArray.size();
+	int edgeCount = ( int )kinematicGraph.edgeIdArray.size();
+	int componentCount = ( int )kinematicGraph.componentArray.size();
+
+	if( ( int )kinematicGraph.vertexLocationArray.size() != vertexCount
+		|| ( int )kinematicGraph.vertexStationArray.size() != vertexCount
+		|| ( int )kinematicGraph.vertexStationaryArray.size() != vertexCount
+		|| ( int )kinematicGraph.vertexKeyArray.size() != vertexCount
+		|| ( int )kinematicGraph.vertexComponentArray.size() != vertexCount
+		|| ( int )kinematicGraph.vertexComponentIndexArray.size() != vertexCount
+		|| ( int )kinematicGraph.edgeVertexArray.size() != 2 * edgeCount
+		|| ( int )kinematicGraph.edgeLengthArray.size() != edgeCount
+		|| ( int )kinematicGraph.edgeComponentIndexArray.size() != edgeCount )
+		return false;
+
+	for( int i = 0; i < 2 * edgeCount; i++ )
+		if( kinematicGraph.edgeVertexArray[i] < 0 || kinematicGraph.edgeVertexArray[i] >= vertexCount )
+			return false;
+
+	for( int vertex = 0; vertex < vertexCount; vertex++ )
+	{
+		int component = kinematicGraph.vertexComponentArray[ vertex ];
+		if( component < 0 || component >= componentCount )
+			return false;
+
+		const std::vector< int >& vertexArray = kinematicGraph.componentArray[ component ].vertexArray;
+		int index = kinematicGraph.vertexComponentIndexArray[ vertex ];
+		if( index < 0 || index >= ( int )vertexArray.size() || vertexArray[ index ] != vertex )
+			return false;
+	}
+
+	for( int edge = 0; edge < edgeCount; edge++ )
+	{
+		int component = kinematicGraph.vertexComponentArray[ kinematicGraph.edgeVertexArray[ 2 * edge ] ];
+		if( kinematicGraph.vertexComponentArray[ kinematicGraph.edgeVertexArray[ 2 * edge + 1 ] ] != component )
+			return false;
+
+		const std::vector< int >& edgeArray = kinematicGraph.componentArray[ component ].edgeArray;
+		int index = kinematicGraph.edgeComponentIndexArray[ edge ];
+		if( index < 0 || index >= ( int )edgeArray.size() || edgeArray[ index ] != edge )
+			return false;
+	}
+
+	// With every element's entry found above, the component arrays hold
+	// each element exactly once if their sizes add up.
+	int componentVertexCount = 0;
+	int componentEdgeCount = 0;
+	for( int i = 0; i < componentCount; i++ )
+	{
+		const KinematicGraph::Component& component = kinematicGraph.componentArray[i];
+		componentVertexCount += ( int )component.vertexArray.size();
+		componentEdgeCount += ( int )component.edgeArray.size();
+
+		if( component.coloringDirty )
+			continue;
+
+		const std::vector< int >& colorOffsetArray = component.colorOffsetArray;
+		if( colorOffsetArray.size() == 0 || colorOffsetArray[0] != 0 || colorOffsetArray.back() != ( int )component.colorEdgeArray.size() )
+			return false;
+
+		for( int j = 1; j < ( int )colorOffsetArray.size(); j++ )
+			if( colorOffsetArray[j] < colorOffsetArray[ j - 1 ] )
+				return false;
+
+		for( int j = 0; j < ( int )component.colorEdgeArray.size(); j++ )
+			if( component.colorEdgeArray[j] < 0 || component.colorEdgeArray[j] >= edgeCount )
+				return false;
+	}
+
+	if( componentVertexCount != vertexCount || componentEdgeCount != edgeCount )
+		return false;
+
+	for( int i = 0; i < ( int )kinematicGraph.freeComponentArray.size(); i++ )
+	{
+		int component = kinematicGraph.freeComponentArray[i];
+		if( component < 0 || component >= componentCount || kinematicGraph.componentArray[ component ].vertexArray.size() > 0 )
+			return false;
+	}
+
+	for( int i = 0; i < ( int )kinematicGraph.splitComponentArray.size(); i++ )
+		if( kinematicGraph.splitComponentArray[i] < 0 || kinematicGraph.splitComponentArray[i] >= componentCount )
+			return false;
+
+	return true;
+}
+
+bool SolveRecorder::Replay( KinematicGraph& kinematicGraph, int& frameCount ) const
+{
+	frameCount = 0;
+	kinematicGraph.SetRecorder( nullptr );
+
+	ByteArray replayOutcome;
+	ByteArray state;
+	std::vector< KinematicGraph::Vector > locationArray;
+
+	for( int i = 0; i < ( int )segmentQueue.size(); i++ )
+	{
+		const Segment& segment = segmentQueue[i];
+
+		// A keyframe taken between frames must match the replay so far.
+		if( i == 0 || segment.external )
+		{
+			if( !RestoreState( kinematicGraph, segment.keyframe ) )
+				return false;
+		}
+		else
+		{
+			SaveState( kinematicGraph, state );
+			if( state != segment.keyframe )
+				return false;
+		}
+
+		ByteReader reader( segment.frames.data(), segment.frames.size() );
+		for( int j = 0; j < segment.frameCount; j++ )
+		{
+			if( !ReplayFrame( kinematicGraph, reader, replayOutcome, locationArray ) )
+				return false;
+
+			size_t outcomeSize = size_t( reader.GetUnsigned() );
+			const unsigned char* recordedOutcome = reader.GetBytes( outcomeSize );
+			if( !recordedOutcome || outcomeSize != replayOutcome.size() || memcmp( recordedOutcome, replayOutcome.data(), outcomeSize ) != 0 )
+				return false;
+
+			frameCount++;
+		}
+
+		if( !reader.AtEnd() )
+			return false;
+	}
+
+	return true;
+}
+
+// Make the call of the frame at the reader on the graph and write its
+// outcome.  Returns false if the call fails, which it did not when recorded.
+/*static*/ bool SolveRecorder::ReplayFrame( KinematicGraph& kinematicGraph, ByteReader& reader, ByteArray& outcome, std::vector< KinematicGraph::Vector >& locationArray )
+{
+	outcome.clear();
+
+	int frameType = reader.GetByte();
+	switch( frameType )
+	{
+		case FRAME_INSERT_VERTEX:
+		{
+			c3ga::vectorE3GA location = reader.GetLocation();
+			if( reader.failed )
+				return false;
+
+			PutSigned( outcome, kinematicGraph.InsertVertex( location ) );
+			return true;
+		}
+		case FRAME_REMOVE_VERTEX:
+		{
+			int id = reader.GetInt();
+			return !reader.failed && kinematicGraph.RemoveVertex( id );
+		}
+		case FRAME_CONNECT_VERTICES:
+		{
+			int idA = reader.GetInt();
+			int idB = reader.GetInt();
+			if( reader.failed || !kinematicGraph.ConnectVertices( idA, idB ) )
+				return false;
+
+			PutSigned( outcome, kinematicGraph.neighborMap.find( KinematicGraph::VertexIdPair( idA, idB ) )->second );
+			return true;
+		}
+		case FRAME_DISCONNECT_VERTICES:
+		{
+			int idA = reader.GetInt();
+			int idB = reader.GetInt();
+			return !reader.failed && kinematicGraph.DisconnectVertices( idA, idB );
+		}
+		case FRAME_CLEAR:
+		{
+			kinematicGraph.Clear();
+			return true;
+		}
+		case FRAME_INSERT_GRAPH:
+		{
+			unsigned long long vertexCount = reader.GetUnsigned();
+			if( reader.failed || vertexCount > size_t( reader.end - reader.cursor ) / ( 3 * sizeof( double ) ) )
+				return false;
+
+			std::vector< c3ga::vectorE3GA > graphLocationArray( ( size_t )vertexCount );
+			for( int i = 0; i < ( int )vertexCount; i++ )
+				graphLocationArray[i] = reader.GetLocation();
+
+			unsigned long long indexCount = reader.GetUnsigned();
+			if( reader.failed || indexCount > size_t( reader.end - reader.cursor ) )
+				return false;
+
+			std::vector< int > edgeArray( ( size_t )indexCount );
+			for( int i = 0; i < ( int )indexCount; i++ )
+				edgeArray[i] = reader.GetInt();
+
+			if( reader.failed )
+				return false;
+
+			std::vector< int > idArray;
+			int edgeCount = kinematicGraph.InsertGraph( graphLocationArray, edgeArray, idArray );
+			PutUnsigned( outcome, edgeCount );
+			PutSigned( outcome, idArray.size() > 0 ? idArray[0] : 0 );
+			return true;
+		}
+		case FRAME_SET_VERTEX_STATIONARY:
+		{
+			int id = reader.GetInt();
+			int stationary = reader.GetByte();
+			return !reader.failed && kinematicGraph.SetVertexStationary( id, stationary == 1 );
+		}
+		case FRAME_SET_SOLVER_SETTINGS:
+		{
+			KinematicGraph::SolverSettings solverSettings;
+			if( !GetSolverSettings( reader, solverSettings ) )
+				return false;
+
+			kinematicGraph.SetSolverSettings( solverSettings );
+			return true;
+		}
+		case FRAME_MOVE_VERTEX:
+		{
+			int id = reader.GetInt();
+			c3ga::vectorE3GA delta = reader.GetLocation();
+			int passedCheck = reader.GetInt();
+			if( reader.failed )
+				return false;
+
+			int vertex = kinematicGraph.FindVertex( id );
+			if( vertex < 0 )
+				return false;
+
+			// The move splits any components pending a split before solving,
+			// and so does this, so that the component captured is the one solved.
+			kinematicGraph.UpdateComponents();
+
+			int component = -1;
+			CaptureComponent( kinematicGraph, vertex, component, locationArray );
+
+			// The deadline passes at the check it passed at when recorded,
+			// or not at all.
+			KinematicGraph::SolveBudget budget;
+			budget.movesLeft = kinematicGraph.solverSettings.maxMoves;
+			budget.timed = ( passedCheck >= 0 );
+			budget.deadlineCheck = passedCheck;
+			budget.checkCount = 0;
+			budget.passedCheck = -1;
+
+			KinematicGraph::SolveResult result = kinematicGraph.MoveVertex( id, delta, budget );
+			PutMoveOutcome( outcome, kinematicGraph, component, locationArray, result );
+			return true;
+		}
+		case FRAME_COMPACT_IDS:
+		{
+			std::vector< int > oldIdArray;
+			kinematicGraph.CompactIds( oldIdArray );
+			PutSigned( outcome, kinematicGraph.newId );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// The file holds the build it was recorded by, then each segment's sizes
+// followed by its keyframe and frames as they are held in memory.
+bool SolveRecorder::Write( const char* path ) const
+{
+	FILE* file = fopen( path, "wb" );
+	if( !file )
+		return false;
+
+	ByteArray header;
+	PutBytes( header, fileMagic, sizeof( fileMagic ) );
+	PutUnsigned( header, VERSION );
+	PutUnsigned( header, KinematicGraph::DIMENSION );
+	PutUnsigned( header, sizeof( KinematicGraph::Real ) );
+	header.push_back( IsLittleEndian() ? 1 : 0 );
+	PutUnsigned( header, segmentQueue.size() );
+
+	bool success = fwrite( header.data(), 1, header.size(), file ) == header.size();
+	for( int i = 0; i < ( int )segmentQueue.size() && success; i++ )
+	{
+		const Segment& segment = segmentQueue[i];
+
+		header.clear();
+		header.push_back( segment.external ? 1 : 0 );
+		PutUnsigned( header, segment.frameCount );
+		PutUnsigned( header, segment.keyframe.size() );
+		PutUnsigned( header, segment.frames.size() );
+
+		success = fwrite( header.data(), 1, header.size(), file ) == header.size()
+			&& fwrite( segment.keyframe.data(), 1, segment.keyframe.size(), file ) == segment.keyframe.size()
+			&& fwrite( segment.frames.data(), 1, segment.frames.size(), file ) == segment.frames.size();
+	}
+
+	if( fclose( file ) != 0 )
+		success = false;
+
+	if( !success )
+		remove( path );
+
+	return success;
+}
+
+bool SolveRecorder::Read( const char* path )
+{
+	Reset();
+
+	FILE* file = fopen( path, "rb" );
+	if( !file )
+		return false;
+
+	ByteArray byteArray;
+	unsigned char buffer[ 64 * 1024 ];
+	size_t readSize;
+	while( ( readSize = fread( buffer, 1, sizeof( buffer ), file ) ) > 0 )
+		byteArray.insert( byteArray.end(), buffer, buffer + readSize );
+
+	bool success = !ferror( file );
+	fclose( file );
+
+	ByteReader reader( byteArray.data(), byteArray.size() );
+	const unsigned char* magic = reader.GetBytes( sizeof( fileMagic ) );
+	if( !success || !magic || memcmp( magic, fileMagic, sizeof( fileMagic ) ) != 0 )
+		return false;
+
+	if( reader.GetUnsigned() != VERSION
+		|| reader.GetUnsigned() != KinematicGraph::DIMENSION
+		|| reader.GetUnsigned() != sizeof( KinematicGraph::Real )
+		|| reader.GetByte() != ( IsLittleEndian() ? 1 : 0 ) )
+		return false;
+
+	unsigned long long segmentCount = reader.GetUnsigned();
+	for( unsigned long long i = 0; i < segmentCount && !reader.failed; i++ )
+	{
+		Segment segment;
+		segment.external = reader.GetByte() == 1;
+		unsigned long long frameCount = reader.GetUnsigned();
+		segment.frameCount = int( frameCount );
+		size_t keyframeSize = size_t( reader.GetUnsigned() );
+		size_t framesSize = size_t( reader.GetUnsigned() );
+
+		const unsigned char* keyframe = reader.GetBytes( keyframeSize );
+		const unsigned char* frames = reader.GetBytes( framesSize );
+		if( !keyframe || !frames || frameCount > INT_MAX )
+		{
+			Reset();
+			return false;
+		}
+
+		segment.keyframe.assign( keyframe, keyframe + keyframeSize );
+		segment.frames.assign( frames, frames + framesSize );
+		byteCount += keyframeSize + framesSize;
+		segmentQueue.push_back( Segment() );
+		std::swap( segmentQueue.back(), segment );
+	}
+
+	if( reader.failed || !reader.AtEnd() )
+	{
+		Reset();
+		return false;
+	}
+
+	return true;
+}
+
+// SolveRecorder.cpp
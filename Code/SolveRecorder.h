@@ -0,0 +1,130 @@
+// SolveRecorder.h
+
+#pragma once
+
+#include "KinematicGraph.h"
+#include <vector>
+#include <deque>
+
+// Records the changes made to a kinematic graph through its interface so
+// that the session can be replayed exactly, e.g. to reproduce a solve that
+// misbehaved and profile it offline as often as needed.  Attach a recorder
+// with KinematicGraph::SetRecorder.
+//
+// The recording is a ring of segments.  Each starts with a keyframe of the
+// graph's whole internal state, component and coloring layout included,
+// since the solvers' results depend on it, and goes on with a frame for
+// every call made since: its arguments and its outcome.  The outcome of a
+// move is the solve result and the change of each vertex location, every
+// coordinate delta-encoded as the difference of its bit patterns in a
+// variable-length integer.  Once the recording outgrows its capacity the
+// oldest segments are dropped, so it holds the latest stretch of the session.
+//
+// A time-limited solve is recorded with the point at which it found its
+// deadline passed, and replayed to stop at that same point, so those replay
+// exactly too.  A recording can only be replayed by a build of the graph
+// with the same precision, dimension and byte order.
+class SolveRecorder
+{
+public:
+
+	enum { VERSION = 3 };
+
+	// The capacity is in bytes, keyframes included; the two newest segments
+	// are kept whatever their size.
+	SolveRecorder( size_t capacity = 64 << 20 );
+	~SolveRecorder( void );
+
+	// Drop everything recorded.  An attached graph starts a new recording
+	// with its next change.
+	void Reset( void );
+
+	// Start a new segment from the graph as it is now.  Call this after
+	// changing the graph other than through its interface.
+	void RecordKeyframe( const KinematicGraph& kinematicGraph );
+
+	int GetSegmentCount( void ) const { return ( int )segmentQueue.size(); }
+	int GetFrameCount( void ) const;
+	size_t GetByteCount( void ) const { return byteCount; }
+
+	// Put the graph into the state of the oldest keyframe held, detaching
+	// any recorder from it, and make every recorded call on it again.  Each
+	// outcome, and each later keyframe, is checked against the recording.
+	// Returns false at the first difference, with the frame count set to
+	// the number of frames that replayed exactly.
+	bool Replay( KinematicGraph& kinematicGraph, int& frameCount ) const;
+
+	bool Write( const char* path ) const;
+
+	// Replace the recording with that of the file.
+	bool Read( const char* path );
+
+private:
+
+	friend class KinematicGraph;
+
+	enum FrameType
+	{
+		FRAME_INSERT_VERTEX,
+		FRAME_REMOVE_VERTEX,
+		FRAME_CONNECT_VERTICES,
+		FRAME_DISCONNECT_VERTICES,
+		FRAME_CLEAR,
+		FRAME_INSERT_GRAPH,
+		FRAME_SET_VERTEX_STATIONARY,
+		FRAME_SET_SOLVER_SETTINGS,
+		FRAME_MOVE_VERTEX,
+		FRAME_COMPACT_IDS,
+	};
+
+	struct Segment
+	{
+		std::vector< unsigned char > keyframe;
+		std::vector< unsigned char > frames;
+		int frameCount;
+		bool external;		// The keyframe follows a change that no frame records.
+	};
+
+	struct ByteReader;
+	typedef std::vector< unsigned char > ByteArray;
+
+	// Only calls that changed the graph are recorded, after the fact.
+	void Start( const KinematicGraph& kinematicGraph );
+	void RecordInsertVertex( const KinematicGraph& kinematicGraph, const c3ga::vectorE3GA& location, int id );
+	void RecordRemoveVertex( const KinematicGraph& kinematicGraph, int id );
+	void RecordConnectVertices( const KinematicGraph& kinematicGraph, int idA, int idB, int id );
+	void RecordDisconnectVertices( const KinematicGraph& kinematicGraph, int idA, int idB );
+	void RecordClear( const KinematicGraph& kinematicGraph );
+	void RecordInsertGraph( const KinematicGraph& kinematicGraph, const std::vector< c3ga::vectorE3GA >& locationArray, const std::vector< int >& edgeArray, const std::vector< int >& idArray, int edgeCount );
+	void RecordSetVertexStationary( const KinematicGraph& kinematicGraph, int id, bool stationary );
+	void RecordSetSolverSettings( const KinematicGraph& kinematicGraph );
+	void RecordCompactIds( const KinematicGraph& kinematicGraph );
+	void BeginMoveVertex( const KinematicGraph& kinematicGraph, int vertex );
+	void RecordMoveVertex( const KinematicGraph& kinematicGraph, int id, const c3ga::vectorE3GA& delta, int passedCheck, const KinematicGraph::SolveResult& result );
+
+	ByteArray* BeginFrame( const KinematicGraph& kinematicGraph, FrameType frameType );
+	void EndFrame( const KinematicGraph& kinematicGraph );
+	void StartSegment( const KinematicGraph& kinematicGraph, bool external );
+
+	static bool ReplayFrame( KinematicGraph& kinematicGraph, ByteReader& reader, ByteArray& outcome, std::vector< KinematicGraph::Vector >& locationArray );
+	static void CaptureComponent( const KinematicGraph& kinematicGraph, int vertex, int& component, std::vector< KinematicGraph::Vector >& locationArray );
+	static void PutMoveOutcome( ByteArray& outcome, const KinematicGraph& kinematicGraph, int component, const std::vector< KinematicGraph::Vector >& locationArray, const KinematicGraph::SolveResult& result );
+	static void PutSolverSettings( ByteArray& byteArray, const KinematicGraph::SolverSettings& solverSettings );
+	static bool GetSolverSettings( ByteReader& reader, KinematicGraph::SolverSettings& solverSettings );
+	static void SaveState( const KinematicGraph& kinematicGraph, ByteArray& byteArray );
+	static bool RestoreState( KinematicGraph& kinematicGraph, const ByteArray& byteArray );
+	static bool CheckState( const KinematicGraph& kinematicGraph );
+
+	size_t capacity;
+	size_t byteCount;
+	std::deque< Segment > segmentQueue;
+	Segment spareSegment;				// The buffers of the last segment dropped, for reuse.
+	ByteArray outcome;
+
+	// The move being recorded: its component and the vertex locations in
+	// that component from before the solve.
+	int moveComponent;
+	std::vector< KinematicGraph::Vector > moveLocationArray;
+};
+
+// SolveRecorder.h
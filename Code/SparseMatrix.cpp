@@ -0,0 +1,131 @@
+// SparseMatrix.cpp
+
+#include "SparseMatrix.h"
+#include <math.h>
+
+SparseMatrix::SparseMatrix( void )
+{
+	Reset(0);
+}
+
+SparseMatrix::~SparseMatrix( void )
+{
+}
+
+void SparseMatrix::Reset( int columnCount )
+{
+	this->columnCount = columnCount;
+
+	rowOffsetArray.clear();
+	rowOffsetArray.push_back(0);
+	columnArray.clear();
+	valueArray.clear();
+}
+
+int SparseMatrix::BeginRow( void )
+{
+	rowOffsetArray.push_back( rowOffsetArray.back() );
+	return GetRowCount() - 1;
+}
+
+void SparseMatrix::AddEntry( int column, double value )
+{
+	columnArray.push_back( column );
+	valueArray.push_back( value );
+	rowOffsetArray.back()++;
+}
+
+void SparseMatrix::Multiply( const std::vector< double >& x, std::vector< double >& y ) const
+{
+	int rowCount = GetRowCount();
+	y.resize( rowCount );
+
+	for( int row = 0; row < rowCount; row++ )
+	{
+		double sum = 0.0;
+		for( int i = rowOffsetArray[ row ]; i < rowOffsetArray[ row + 1 ]; i++ )
+			sum += valueArray[i] * x[ columnArray[i] ];
+		y[ row ] = sum;
+	}
+}
+
+void SparseMatrix::MultiplyTranspose( const std::vector< double >& x, std::vector< double >& y ) const
+{
+	int rowCount = GetRowCount();
+	y.assign( columnCount, 0.0 );
+
+	for( int row = 0; row < rowCount; row++ )
+		for( int i = rowOffsetArray[ row ]; i < rowOffsetArray[ row + 1 ]; i++ )
+			y[ columnArray[i] ] += valueArray[i] * x[ row ];
+}
+
+int SparseMatrix::SolveNormalEquations( const std::vector< double >& b, std::vector< double >& x, double damping, int maxIterations, double tolerance ) const
+{
+	int rowCount = GetRowCount();
+	x.assign( rowCount, 0.0 );
+
+	// The diagonal of A A^T is the squared norm of each row of A.
+	inverseDiagonalArray.resize( rowCount );
+	for( int row = 0; row < rowCount; row++ )
+	{
+		double diagonal = damping;
+		for( int i = rowOffsetArray[ row ]; i < rowOffsetArray[ row + 1 ]; i++ )
+			diagonal += valueArray[i] * valueArray[i];
+		inverseDiagonalArray[ row ] = ( diagonal > 0.0 ) ? ( 1.0 / diagonal ) : 0.0;
+	}
+
+	residualArray = b;
+	preconditionedArray.resize( rowCount );
+	for( int row = 0; row < rowCount; row++ )
+		preconditionedArray[ row ] = inverseDiagonalArray[ row ] * residualArray[ row ];
+	directionArray = preconditionedArray;
+
+	double residualDot = 0.0;
+	double normSquared = 0.0;
+	for( int row = 0; row < rowCount; row++ )
+	{
+		residualDot += residualArray[ row ] * preconditionedArray[ row ];
+		normSquared += residualArray[ row ] * residualArray[ row ];
+	}
+
+	double toleranceSquared = tolerance * tolerance;
+	int iteration = 0;
+	while( iteration < maxIterations && normSquared > toleranceSquared )
+	{
+		iteration++;
+
+		MultiplyTranspose( directionArray, transposeProductArray );
+		Multiply( transposeProductArray, productArray );
+
+		double curvature = 0.0;
+		for( int row = 0; row < rowCount; row++ )
+		{
+			productArray[ row ] += damping * directionArray[ row ];
+			curvature += directionArray[ row ] * productArray[ row ];
+		}
+
+		if( curvature <= 0.0 )
+			break;
+
+		double alpha = residualDot / curvature;
+		double newResidualDot = 0.0;
+		normSquared = 0.0;
+		for( int row = 0; row < rowCount; row++ )
+		{
+			x[ row ] += alpha * directionArray[ row ];
+			residualArray[ row ] -= alpha * productArray[ row ];
+			preconditionedArray[ row ] = inverseDiagonalArray[ row ] * residualArray[ row ];
+			newResidualDot += residualArray[ row ] * preconditionedArray[ row ];
+			normSquared += residualArray[ row ] * residualArray[ row ];
+		}
+
+		double beta = newResidualDot / residualDot;
+		residualDot = newResidualDot;
+		for( int row = 0; row < rowCount; row++ )
+			directionArray[ row ] = preconditionedArray[ row ] + beta * directionArray[ row ];
+	}
+
+	return iteration;
+}
+
+// SparseMatrix.cpp
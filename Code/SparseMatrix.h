@@ -0,0 +1,50 @@
+// SparseMatrix.h
+
+#pragma once
+
+#include <vector>
+
+// A matrix in compressed sparse row form.  Rows are built one at a time,
+// front to back, which is how constraint Jacobians are naturally assembled.
+class SparseMatrix
+{
+public:
+
+	SparseMatrix( void );
+	~SparseMatrix( void );
+
+	void Reset( int columnCount );
+	int BeginRow( void );
+	void AddEntry( int column, double value );
+
+	int GetRowCount( void ) const { return ( int )rowOffsetArray.size() - 1; }
+	int GetColumnCount( void ) const { return columnCount; }
+
+	// y = A x
+	void Multiply( const std::vector< double >& x, std::vector< double >& y ) const;
+
+	// y = A^T x
+	void MultiplyTranspose( const std::vector< double >& x, std::vector< double >& y ) const;
+
+	// Solve ( A A^T + damping I ) x = b using the conjugate gradient method
+	// with a Jacobi preconditioner, starting from x = 0.  The matrix A A^T is
+	// never formed.  Returns the number of iterations taken.
+	int SolveNormalEquations( const std::vector< double >& b, std::vector< double >& x, double damping, int maxIterations, double tolerance ) const;
+
+private:
+
+	int columnCount;
+	std::vector< int > rowOffsetArray;
+	std::vector< int > columnArray;
+	std::vector< double > valueArray;
+
+	// Scratch space for the solver.
+	mutable std::vector< double > residualArray;
+	mutable std::vector< double > directionArray;
+	mutable std::vector< double > preconditionedArray;
+	mutable std::vector< double > productArray;
+	mutable std::vector< double > transposeProductArray;
+	mutable std::vector< double > inverseDiagonalArray;
+};
+
+// SparseMatrix.h
@@ -0,0 +1,115 @@
+// ThreadPool.cpp
+
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool( int threadCount )
+{
+	job = nullptr;
+	generation = 0;
+	activeWorkers = 0;
+	quit = false;
+
+	// The thread calling ParallelFor makes up the difference.
+	for( int i = 1; i < threadCount; i++ )
+		threadArray.push_back( std::thread( &ThreadPool::WorkerThread, this ) );
+}
+
+ThreadPool::~ThreadPool( void )
+{
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		quit = true;
+	}
+
+	wakeCondition.notify_all();
+
+	for( int i = 0; i < ( int )threadArray.size(); i++ )
+		threadArray[i].join();
+}
+
+/*static*/ int ThreadPool::CalcChunkCount( int count, int grainSize )
+{
+	if( count <= 0 )
+		return 0;
+
+	if( grainSize < 1 )
+		grainSize = 1;
+
+	return ( count + grainSize - 1 ) / grainSize;
+}
+
+void ThreadPool::ParallelFor( int count, int grainSize, const Task& task )
+{
+	Job job;
+	job.task = &task;
+	job.count = count;
+	job.grainSize = ( grainSize < 1 ) ? 1 : grainSize;
+	job.chunkCount = CalcChunkCount( count, job.grainSize );
+	job.nextChunk = 0;
+
+	if( job.chunkCount <= 1 || threadArray.size() == 0 )
+	{
+		RunChunks( job );
+		return;
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		job.generation = ++generation;
+		this->job = &job;
+	}
+
+	wakeCondition.notify_all();
+
+	RunChunks( job );
+
+	// Every chunk has been claimed by now, so once no worker is still busy
+	// with this job it is done, and no worker can pick it up afterwards.
+	std::unique_lock< std::mutex > lock( mutex );
+	doneCondition.wait( lock, [this]{ return activeWorkers == 0; } );
+	this->job = nullptr;
+}
+
+/*static*/ void ThreadPool::RunChunks( Job& job )
+{
+	while( true )
+	{
+		int chunk = job.nextChunk++;
+		if( chunk >= job.chunkCount )
+			break;
+
+		int begin = chunk * job.grainSize;
+		int end = begin + job.grainSize;
+		if( end > job.count )
+			end = job.count;
+
+		( *job.task )( begin, end, chunk );
+	}
+}
+
+void ThreadPool::WorkerThread( void )
+{
+	unsigned int seenGeneration = 0;
+
+	while( true )
+	{
+		std::unique_lock< std::mutex > lock( mutex );
+		wakeCondition.wait( lock, [&]{ return quit || ( job && job->generation != seenGeneration ); } );
+		if( quit )
+			break;
+
+		Job* currentJob = job;
+		seenGeneration = currentJob->generation;
+		activeWorkers++;
+		lock.unlock();
+
+		RunChunks( *currentJob );
+
+		lock.lock();
+		activeWorkers--;
+		lock.unlock();
+		doneCondition.notify_all();
+	}
+}
+
+// ThreadPool.cpp
@@ -0,0 +1,58 @@
+// ThreadPool.h
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// A fixed set of worker threads that split loops between them.  The work
+// is cut into chunks whose boundaries depend only on the loop length and
+// grain size, never on the thread count, so callers that reduce results
+// per chunk get the same answer however many threads are running.
+class ThreadPool
+{
+public:
+
+	typedef std::function< void( int begin, int end, int chunk ) > Task;
+
+	ThreadPool( int threadCount );
+	~ThreadPool( void );
+
+	int GetThreadCount( void ) const { return ( int )threadArray.size() + 1; }
+
+	static int CalcChunkCount( int count, int grainSize );
+
+	// Run the task over [0,count) and wait for it to finish.  The calling
+	// thread counts as one of the threads and does its share of the chunks.
+	void ParallelFor( int count, int grainSize, const Task& task );
+
+private:
+
+	struct Job
+	{
+		const Task* task;
+		int count;
+		int grainSize;
+		int chunkCount;
+		unsigned int generation;
+		std::atomic< int > nextChunk;
+	};
+
+	void WorkerThread( void );
+	static void RunChunks( Job& job );
+
+	std::vector< std::thread > threadArray;
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+	Job* job;
+	unsigned int generation;
+	int activeWorkers;
+	bool quit;
+};
+
+// ThreadPool.h